@@ -0,0 +1,134 @@
+#include "CalibrationStore.h"
+#include <EEPROM.h>
+
+CalibrationStore::CalibrationStore(int address, byte recordSize, byte slotCount, byte version)
+{
+    _address = address;
+    _recordSize = recordSize;
+    _slotCount = slotCount ? slotCount : 1;
+    _version = version;
+    _valid = false;
+    _newestSlot = 0;
+    _sequence = 0;
+}
+
+bool CalibrationStore::load(void *record)
+{
+    _valid = false;
+    for (byte slot = 0; slot < _slotCount; slot++)
+    {
+        unsigned int sequence;
+        if (!readSlot(slot, sequence))
+            continue;
+
+        if (!_valid || (int)(sequence - _sequence) > 0) //newer, survives the counter wrapping
+        {
+            _valid = true;
+            _newestSlot = slot;
+            _sequence = sequence;
+        }
+    }
+
+    if (!_valid)
+        return false;
+
+    int address = slotAddress(_newestSlot) + 3;
+    for (byte i = 0; i < _recordSize; i++)
+        ((byte *)record)[i] = EEPROM.read(address + i);
+    return true;
+}
+
+bool CalibrationStore::save(const void *record)
+{
+    const byte *data = (const byte *)record;
+    if (_valid && matchesSlot(_newestSlot, data))
+        return false;
+
+    byte slot = _valid ? (_newestSlot + 1) % _slotCount : 0;
+    unsigned int sequence = _sequence + 1;
+    int address = slotAddress(slot);
+
+    //invalidate first so a reset partway through can't leave a good crc over mixed data
+    EEPROM.update(address, ~_version);
+
+    byte crc = crc8(0, _version);
+    EEPROM.update(address + 1, sequence & 0xFF);
+    crc = crc8(crc, sequence & 0xFF);
+    EEPROM.update(address + 2, sequence >> 8);
+    crc = crc8(crc, sequence >> 8);
+    for (byte i = 0; i < _recordSize; i++)
+    {
+        EEPROM.update(address + 3 + i, data[i]);
+        crc = crc8(crc, data[i]);
+    }
+    EEPROM.update(address + 3 + _recordSize, crc);
+    EEPROM.update(address, _version);
+
+    _valid = true;
+    _newestSlot = slot;
+    _sequence = sequence;
+    return true;
+}
+
+void CalibrationStore::erase()
+{
+    for (byte slot = 0; slot < _slotCount; slot++)
+        EEPROM.update(slotAddress(slot), ~_version);
+    _valid = false;
+}
+
+bool CalibrationStore::isValid()
+{
+    return _valid;
+}
+
+unsigned int CalibrationStore::getSequence()
+{
+    return _sequence;
+}
+
+int CalibrationStore::getSize()
+{
+    return (_recordSize + 4) * _slotCount;
+}
+
+byte CalibrationStore::crc8(byte crc, byte data)
+{
+    crc ^= data;
+    for (byte i = 0; i < 8; i++)
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    return crc;
+}
+
+int CalibrationStore::slotAddress(byte slot)
+{
+    return _address + slot * (_recordSize + 4);
+}
+
+bool CalibrationStore::readSlot(byte slot, unsigned int &sequence)
+{
+    int address = slotAddress(slot);
+    byte b = EEPROM.read(address);
+    if (b != _version)
+        return false;
+
+    byte crc = crc8(0, b);
+    for (int i = 1; i < 3 + _recordSize; i++)
+        crc = crc8(crc, EEPROM.read(address + i));
+    if (crc != EEPROM.read(address + 3 + _recordSize))
+        return false;
+
+    sequence = EEPROM.read(address + 1) | (EEPROM.read(address + 2) << 8);
+    return true;
+}
+
+bool CalibrationStore::matchesSlot(byte slot, const byte *record)
+{
+    int address = slotAddress(slot) + 3;
+    for (byte i = 0; i < _recordSize; i++)
+    {
+        if (EEPROM.read(address + i) != record[i])
+            return false;
+    }
+    return true;
+}
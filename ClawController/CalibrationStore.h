@@ -0,0 +1,42 @@
+#ifndef CalibrationStore_h
+#define CalibrationStore_h
+
+#include "Arduino.h"
+
+/**
+ * Keeps a calibration record in EEPROM across resets.
+ *
+ * The record is written round robin over slotCount slots so no single cell takes every write.
+ * Slot: version, seq low, seq high, record[recordSize], crc8 of everything before it
+ *
+ * load() takes the slot with the newest seq that has our version and a good crc, so a write cut off
+ * by a reset leaves the previous copy in charge. save() skips the write when nothing changed and
+ * only rewrites bytes that differ. Call load() once at boot before save().
+ */
+class CalibrationStore
+{
+  public:
+    CalibrationStore(int address, byte recordSize, byte slotCount, byte version);
+    bool load(void *record); //copy the newest good record out, false if there isn't one
+    bool save(const void *record); //write record to the next slot, false if it matches the newest copy
+    void erase(); //forget every copy, load() fails until the next save()
+    bool isValid(); //a good record is stored
+    unsigned int getSequence(); //bumped on every save
+    int getSize(); //EEPROM bytes used by every slot together
+
+  private:
+    int _address;
+    byte _recordSize;
+    byte _slotCount;
+    byte _version;
+    bool _valid;
+    byte _newestSlot;
+    unsigned int _sequence;
+
+    static byte crc8(byte crc, byte data);
+    int slotAddress(byte slot);
+    bool readSlot(byte slot, unsigned int &sequence); //true if the slot holds a good record
+    bool matchesSlot(byte slot, const byte *record);
+};
+
+#endif
@@ -3,6 +3,10 @@
 #include <EthernetClient.h>
 #include <EthernetServer.h>
 #include <SoftwareSerial.h>
+#include "SerialLink.h"
+#include "LoopProfiler.h"
+#include "SensorClassifier.h"
+#include "CalibrationStore.h"
 
 SoftwareSerial conveyorController(6, 5);
 HardwareSerial &ledController = Serial3;
@@ -67,6 +71,7 @@ const int LIMITOFF = HIGH;
 
 */
 const int _memHomeLocation = 0;//where are we storing the home location
+const int _memCalibration = 16; //first of the calibration slots, see CalibrationStore
 
 bool _doWiggle = false; //whether we wiggle when performing drop
 int _wiggleTime = 80; //amount of time to move each direction during the wiggle
@@ -89,6 +94,7 @@ const int EVENT_RETURNED_HOME = 106; //over win chute
 const int EVENT_RETURNED_CENTER = 107; //back in center
 const int EVENT_SCORE_SENSOR = 108; //plinko sensor
 const int EVENT_CONVEYOR2_TRIPPED = 109; //response when tripped
+const int EVENT_POSITION_REACHED = 110; //goto finished
 
 
 const int EVENT_LIMIT_LEFT = 200; //hit a limit
@@ -122,21 +128,17 @@ const int EVENT_INFO = 900; //Event to show when we want to pass info back
 
 */
 const byte STATE_RUNNING = 0;
-const byte STATE_CHECK_HOMING_L = 1;
-const byte STATE_CHECK_HOMING_B = 2;
+const byte STATE_CHECK_HOMING_LB = 1; //running left and backward together, timing each
 const byte STATE_CHECK_CENTERING = 3;
 const byte STATE_CHECK_DROP_TENSION = 4;
 const byte STATE_CHECK_DROP_RECOIL = 5;
-const byte STATE_CHECK_RUNCHUTE_LEFT = 6;
-const byte STATE_CHECK_RUNCHUTE_BACK = 7;
-const byte STATE_CHECK_RUNCHUTE_RIGHT = 8;
-const byte STATE_CHECK_RUNCHUTE_FORWARD = 9;
+const byte STATE_CHECK_RUNCHUTE = 6; //running both horizontal axes to the home corner
 const byte STATE_CLAW_STARTUP = 10;
 const byte STATE_CHECK_STARTUP_RECOIL = 11;
-const byte STATE_CHECK_STARTUP_RIGHT = 12;
-const byte STATE_CHECK_STARTUP_FORWARD = 13;
+const byte STATE_CHECK_STARTUP_RF = 12; //running right and forward together
 const byte STATE_CHECK_HOMING = 14;
 const byte STATE_FAILSAFE = 15;
+const byte STATE_CHECK_STARTUP_WARM = 16; //running to the home corner to check the stored calibration
 
 /*
 
@@ -165,25 +167,41 @@ byte _homeLocation = HOME_LOCATION_FL; //Set home locaton front left - default
 
 
 //Storing times
-unsigned long _timestampConveyorSensorTripped = 0; //what time the sensor last saw movement
-unsigned long _timestampConveyor2SensorTripped = 0; //what time the sensor last saw movement
+SensorClassifier<2> _conveyorSensors; //one per belt, hold-off of _conveyorSensorTripDelay
 unsigned long _timestampGameResetTrippedTime = 0; //Time the reset button was pressed
-unsigned long _timestampRunLeft = 0; //When did we start running right to left
-unsigned long _timestampRunBackward = 0; //When did we start running back to front
+unsigned long _timestampAxesStart = 0; //When the axes in _pendingAxes started toward their limits
 unsigned long _timestampConveyorBeltStart = 0; //when the conveyor belt started running
 unsigned long _timestampRunCenter = 0; //timestamp set when we start running gantry to the center
 unsigned long _timestampConveyorBeltStart2 = 0; //second conveyor start
 unsigned long _timestampConveyorFlipperStart = 0; //when did flipper start movement
 
-unsigned long _timestampMotorMoveUp = 0; //motor movement failsafe stamp
-unsigned long _timestampMotorMoveDown = 0; //motor movement failsafe stamp
-unsigned long _timestampMotorMoveLeft = 0; //motor movement failsafe stamp
-unsigned long _timestampMotorMoveRight = 0; //motor movement failsafe stamp
-unsigned long _timestampMotorMoveForward = 0; //motor movement failsafe stamp
-unsigned long _timestampMotorMoveBackward = 0; //motor movement failsafe stamp
 unsigned long _timestampMotorMoveFlipper = 0; //motor movement failsafe stamp
 unsigned long _timestampClawClosed = 0;
 unsigned long _timestampBeltRun = 0;
+int _limitSettleTime = 200; //keep the up/down motor running this long past the limit so it's all the way there
+
+//timed steps run in order from loop(), each one waits on the one before it instead of calling delay()
+const byte _taskQueueSize = 16;
+struct ScheduledTask
+{
+    void (*action)(); //what to run
+    unsigned int wait; //ms after the previous step before this one runs
+};
+ScheduledTask _taskQueue[_taskQueueSize];
+byte _taskQueueHead = 0;
+byte _taskQueueCount = 0;
+unsigned long _timestampLastTask = 0; //when the previous step ran
+
+//player moves that came in while a step was pending, run in order once the steps are done like they did after delay()
+const byte _deferredMoveSize = 8;
+struct DeferredMove
+{
+    byte direction;
+    int duration;
+};
+DeferredMove _deferredMoves[_deferredMoveSize];
+byte _deferredMoveHead = 0;
+byte _deferredMoveCount = 0;
 
 
 
@@ -196,18 +214,113 @@ int _runToCenterDurationDepth = 0;
 int _runToCenterDurationWidth = 0;
 bool _enableReturnToChute = true; //after drop, return to chute?
 
-//boot state of the motor, only set in stopMotor* and runMotor* functions
-bool _isMotorRunningUp = false;
-bool _isMotorRunningDown = false;
-bool _isMotorRunningLeft = false;
-bool _isMotorRunningRight = false;
-bool _isMotorRunningForward = false;
-bool _isMotorRunningBackward = false;
 bool _isClawClosed = false;
-bool _moveFromJoystickBackward = false;
-bool _moveFromJoystickForward = false;
-bool _moveFromJoystickLeft = false;
-bool _moveFromJoystickRight = false;
+
+/*
+
+  AXES - one entry per gantry direction, everything that differs between them is data here
+
+*/
+const byte AXIS_LEFT = 0;
+const byte AXIS_RIGHT = 1;
+const byte AXIS_FORWARD = 2;
+const byte AXIS_BACKWARD = 3;
+const byte AXIS_DOWN = 4;
+const byte AXIS_UP = 5;
+const byte AXIS_COUNT = 6;
+
+struct Axis
+{
+    byte motorPin; //relay driving this direction
+    byte limitPin; //limit switch at the end of this direction
+    byte limitLevel; //pin level when the limit is hit
+    byte stickPin; //joystick input for this direction, 0 if none
+    byte opposite; //axis driving the same motor the other way
+    bool settles; //keep running _limitSettleTime past the limit so it's all the way there
+    int limitEvent; //sent when the limit is hit
+    int failsafeEvent; //sent when the motor runs too long without hitting the limit
+    const char *name; //debug output
+
+    //set at runtime
+    byte limitPort; //index into _inputSnapshot
+    byte limitMask;
+    byte stickPort;
+    byte stickMask;
+    bool running; //boot state of the motor, only set in runAxis and stopAxis
+    bool fromJoystick; //the joystick started this move
+    unsigned long timestampMove; //motor movement failsafe stamp
+    unsigned long timestampLimit; //when the limit or failsafe tripped, 0 until it does
+    int remoteDuration; //how long a remote move runs, negative runs until a stop command
+    unsigned long remoteStartTime; //when the remote move started, 0 if there isn't one
+    unsigned long timespanToLimit; //how long this axis took to reach its limit in the last runAxesToLimits
+};
+
+byte _pendingAxes = 0; //bit per axis still running to its limit for runAxesToLimits
+
+/*
+
+  POSITION - dead reckoning of the gantry from motor on-time, re-zeroed at every limit
+
+*/
+const byte POS_X = 0; //left limit is 0, right limit is the width
+const byte POS_Y = 1; //backward (front of machine) limit is 0, forward (back of machine) limit is the depth
+const byte POS_COUNT = 2;
+const int POS_SCALE = 1000; //goto and pos work in thousandths of the span
+
+struct GantryPosition
+{
+    byte lowAxis; //runs toward 0
+    byte highAxis; //runs toward the span
+    int lowSpeed; //percent of homing speed running toward 0, homing runs this way
+    int highSpeed; //percent of homing speed running toward the span
+    long position; //hundredths of a ms of travel at homing speed from the low limit
+    bool known; //a limit has been seen since boot
+    long target; //where goto is headed, -1 when it isn't
+};
+
+GantryPosition _positions[POS_COUNT] = {
+    { AXIS_LEFT, AXIS_RIGHT, 100, 100, 0, false, -1 },
+    { AXIS_BACKWARD, AXIS_FORWARD, 100, 100, 0, false, -1 }
+};
+unsigned long _timestampPositionUpdate = 0;
+bool _gotoActive = false; //send EVENT_POSITION_REACHED when both targets are done
+
+/*
+
+  CALIBRATION - travel times and centering kept in EEPROM so a reset doesn't need a full homing sweep
+
+*/
+struct ClawCalibration
+{
+    int timespanRunWidth;
+    int timespanRunDepth;
+    int runToCenterDurationWidth;
+    int runToCenterDurationDepth;
+    int positionSpeeds[POS_COUNT][2]; //lowSpeed, highSpeed
+    bool warmBoot; //trust this at boot after one run to the home corner
+};
+
+const byte CALIBRATION_VERSION = 1; //bump when ClawCalibration changes
+CalibrationStore _calibration(_memCalibration, sizeof(ClawCalibration), 8, CALIBRATION_VERSION);
+bool _warmBoot = true; //use the stored calibration at boot
+bool _warmBootPending = false; //startupMachine() should try the stored calibration
+
+Axis _axes[AXIS_COUNT] = {
+    { _PINMoveLeft, _PINLimitLeft, LIMITON, _PINStickMoveLeft, AXIS_RIGHT, false, EVENT_LIMIT_LEFT, EVENT_FAILSAFE_LEFT, "L" },
+    { _PINMoveRight, _PINLimitRight, LIMITON, _PINStickMoveRight, AXIS_LEFT, false, EVENT_LIMIT_RIGHT, EVENT_FAILSAFE_RIGHT, "R" },
+    { _PINMoveForward, _PINLimitForward, LIMITON, _PINStickMoveForward, AXIS_BACKWARD, false, EVENT_LIMIT_FORWARD, EVENT_FAILSAFE_FORWARD, "F" },
+    { _PINMoveBackward, _PINLimitBackward, LIMITON, _PINStickMoveBackward, AXIS_FORWARD, false, EVENT_LIMIT_BACKWARD, EVENT_FAILSAFE_BACKWARD, "B" },
+    { _PINMoveDown, _PINLimitDown, LIMITOFF, 0, AXIS_UP, true, EVENT_LIMIT_DOWN, EVENT_FAILSAFE_DOWN, "D" },
+    { _PINMoveUp, _PINLimitUp, LIMITON, 0, AXIS_DOWN, true, EVENT_LIMIT_UP, EVENT_FAILSAFE_UP, "U" }
+};
+
+//every input register we read, sampled once per loop so each port costs one read
+const byte _maxInputPorts = 6;
+volatile uint8_t *_inputPorts[_maxInputPorts];
+byte _inputSnapshot[_maxInputPorts];
+byte _inputPortCount = 0;
+byte _stickDropPort = 0;
+byte _stickDropMask = 0;
 
 int _conveyorSensorTripped = HIGH; //used to determine if trip is on a high or low
 int _failsafeMotorLimit = 15000; //second limit for how long a motor can move before it should hit a limit
@@ -225,25 +338,13 @@ int _failsafeCurrentResets = 0; //how many times we've hit a failsave and not re
 */
 
 //How long should we run in this direction
-int _clawRemoteMoveDurationForward = 0;
-int _clawRemoteMoveDurationBackward = 0;
-int _clawRemoteMoveDurationLeft = 0;
-int _clawRemoteMoveDurationRight = 0;
 int _clawRemoteMoveDurationDrop = 0;
-int _clawRemoteMoveDurationDown = 0;
-int _clawRemoteMoveDurationUp = 0;
 int _conveyorMoveDuration = 0;
 int _conveyorMoveDuration2 = 0;
 
 
 //When did the move begin
-unsigned long _clawRemoteMoveStartTimeForward = 0;
-unsigned long _clawRemoteMoveStartTimeBackward = 0;
-unsigned long _clawRemoteMoveStartTimeLeft = 0;
-unsigned long _clawRemoteMoveStartTimeRight = 0;
 unsigned long _clawRemoteMoveStartTimeDrop = 0;
-unsigned long _clawRemoteMoveStartTimeDown = 0;
-unsigned long _clawRemoteMoveStartTimeUp = 0;
 
 //used for looking at a readable string when passing commands to moveFromRemote()
 const byte CLAW_FORWARD = 1;
@@ -255,6 +356,57 @@ const byte CLAW_RECOIL = 6; //recoil command, used as a one shot recoil
 const byte CLAW_UP = 7; //pull claw up, used for small movements
 const byte CLAW_DOWN = 8; //pull claw down, used for small movements
 
+/*
+
+  BINARY PROTOCOL - optional framing on the telnet port, a frame starts with BIN_FRAME_START instead of a text sequence number
+  frame: START, length, seq hi, seq lo, [opcode, int16 args...]..., crc8 of length through the last command
+  ack:   START, 4, seq hi, seq lo, status, commands run, crc8
+
+*/
+const byte BIN_FRAME_START = 0x02;
+const byte BIN_MAX_ARGS = 2; //most arguments any binary command takes
+
+const byte BIN_CMD_PING = 0x00; //no args, the ack is the pong
+const byte BIN_CMD_MOVE = 0x01; //direction (CLAW_*), duration
+const byte BIN_CMD_STOP = 0x02; //stop all movement
+const byte BIN_CMD_CLAW = 0x03; //1 close, 0 open
+const byte BIN_CMD_BELT = 0x04; //run time
+const byte BIN_CMD_BELT2 = 0x05; //run time
+const byte BIN_CMD_FLIP = 0x06; //flipper direction
+const byte BIN_CMD_LIGHT = 0x07; //1 on, 0 off
+
+const byte BIN_ACK_OK = 0;
+const byte BIN_ACK_BAD_CRC = 1;
+const byte BIN_ACK_BAD_COMMAND = 2; //unknown opcode or truncated arguments, nothing in the frame was run
+
+struct BinaryCommand
+{
+    byte argCount; //number of int16 arguments following the opcode
+    void (*handler)(int args[]);
+};
+
+void binaryPing(int args[]);
+void binaryMove(int args[]);
+void binaryStop(int args[]);
+void binaryClaw(int args[]);
+void binaryBelt(int args[]);
+void binaryBelt2(int args[]);
+void binaryFlip(int args[]);
+void binaryLight(int args[]);
+
+//indexed by opcode
+const BinaryCommand _binaryCommands[] = {
+    { 0, binaryPing },
+    { 2, binaryMove },
+    { 0, binaryStop },
+    { 1, binaryClaw },
+    { 1, binaryBelt },
+    { 1, binaryBelt2 },
+    { 1, binaryFlip },
+    { 1, binaryLight }
+};
+const byte _binaryCommandCount = sizeof(_binaryCommands) / sizeof(_binaryCommands[0]);
+
 const byte FLIPPER_STOPPED = 0;
 const byte FLIPPER_FORWARD = 1;
 const byte FLIPPER_BACKWARD = 2;
@@ -280,17 +432,8 @@ bool _autoDropTargeting = false; //If in targeting mode, setting this TRUE cause
 bool _allowTargetingMoves = true; //When in tatrgeting mode, allow the player to move anywhere in the play area during their turn
 
 
-const char RTS = '{'; //request to send data
-const char CS = '}'; //complete send data
-const char CTS = '!'; //clear to send data
-
-char _lastPlinkoMessage[40]; //plinko message
-unsigned long _waitForAckTimestamp = 0; //time we sent last plinko message
-byte _waitForAckCount = 0; //retry counter
-
-char _lastLedMessage[40]; //led message
-unsigned long _waitForLedAckTimestamp = 0; //time we sent last led message
-byte _waitForLedAckCount = 0; //retry counter
+SerialLink _ledLink(ledController); //framed link to the led controller
+SerialLink _plinkoLink(plinkoController); //framed link to the plinko controller
 
 bool _hasQueuedCommand = false;
 bool _needsSecondaryInit = true; //true if we need to set GPIO during very first loop() rather than setup()
@@ -317,16 +460,60 @@ EthernetClient _clients[_clientCount]; //list of connections
 //MISC for handling commands
 // buffers for receiving and sending data
 const byte _numChars = 64;
-char _incomingCommand[_numChars]; // an array to store the received data
-char _sPlinkoIncomingCommand[_numChars]; // an array to store the received data
-char _sLedIncomingCommand[_numChars]; // an array to store the received data
 char _commandDelimiter = '\n';
 
+//receive state for each telnet connection, index matches _clients
+struct TelnetConnection
+{
+    char incomingCommand[_numChars]; //command being received
+    byte idx; //cursor into incomingCommand
+    bool inBinaryFrame; //receiving a binary frame instead of a text line
+    byte binaryLength; //length byte of the binary frame, 0 until it arrives
+    unsigned long eventCursor; //sequence of the next queued event to send this client
+    unsigned int eventsDropped; //events overwritten before this client could take them
+};
+TelnetConnection _connections[_clientCount];
+const byte _telnetClientByteBudget = 32; //most bytes read from one client per loop
+const byte _telnetLoopByteBudget = 64; //most bytes read from all clients per loop
+byte _nextClientToService = 0; //round robin starting point
+
+//outgoing events, queued by broadcastToClients and written to each client from loop()
+const byte _eventQueueSize = 12;
+const byte _eventLineChars = 72; //"event:0 data\r\n"
+struct QueuedEvent
+{
+    int event; //event id, used to coalesce repeated status events
+    byte length; //bytes in line
+    char line[_eventLineChars]; //formatted line as it goes on the wire
+};
+QueuedEvent _eventQueue[_eventQueueSize];
+unsigned long _eventQueueNext = 0; //sequence of the next event queued, stored at sequence % _eventQueueSize
+unsigned long _serialEventCursor = 0; //next event to echo to serial in debug mode
+unsigned int _eventsCoalesced = 0; //status events skipped because an identical one was still waiting
+const byte _eventLoopByteBudget = 128; //most event bytes written per loop
+byte _nextClientToDrain = 0; //round robin starting point
+
+//loop() stages timed by the profiler, see the perf command
+const byte PERF_TELNET = 0;
+const byte PERF_LED = 1;
+const byte PERF_PLINKO = 2;
+const byte PERF_CONVEYOR = 3;
+const byte PERF_MOVEMENTS = 4;
+const byte PERF_INPUT = 5;
+const byte PERF_FLIPPER = 6;
+const byte PERF_LIMITS = 7;
+const byte PERF_STATES = 8;
+const byte PERF_EVENTS = 9;
+const char *const _perfStageNames[] = { "telnet", "led", "plinko", "conveyor", "movements", "input", "flipper", "limits", "states", "events" };
+LoopProfiler _profiler(_perfStageNames, 10);
+
 
 void setup() {
     Serial.begin(115200);
     ledController.begin(115200);
     plinkoController.begin(250000);
+    _ledLink.setReceiveHandler(handleLedMessage);
+    _plinkoLink.setReceiveHandler(handlePlinkoMessage);
 
     initGeneral();
     initEthernet();
@@ -342,25 +529,45 @@ void loop() {
         initMovement();
         initLights();
         initConveyor();
+        _warmBootPending = loadCalibration() && _warmBoot;
         startupMachine();
         _needsSecondaryInit = false;
     }
 
+    _profiler.beginLoop();
+
+    sampleInputs();
     handleTelnetConnectors();
+    _profiler.mark(PERF_TELNET);
     handleLedSerialCommands();
+    _profiler.mark(PERF_LED);
     handlePlinkoSerialCommands();
+    _profiler.mark(PERF_PLINKO);
     checkConveyorSensor();
     checkBeltRuntime();
     checkBelt2Runtime();
+    _profiler.mark(PERF_CONVEYOR);
     
+    updatePositions();
     checkMovements();
+    _profiler.mark(PERF_MOVEMENTS);
     checkGameReset();
     handleJoystick();
+    _profiler.mark(PERF_INPUT);
     handleFlipper();
+    _profiler.mark(PERF_FLIPPER);
 
     checkLimits();
+    _profiler.mark(PERF_LIMITS);
+    runTasks();
+    runDeferredMoves();
     checkStates();
-    
+    _profiler.mark(PERF_STATES);
+
+    sendQueuedEvents();
+    _profiler.mark(PERF_EVENTS);
+
+    _profiler.endLoop();
 }
 
 
@@ -383,44 +590,32 @@ void initGeneral()
 
 void initMovement()
 {
-    //Drive relays for each direction
-    pinMode(_PINMoveLeft, OUTPUT);
-    pinMode(_PINMoveRight, OUTPUT);
-    pinMode(_PINMoveForward, OUTPUT);
-    pinMode(_PINMoveBackward, OUTPUT);
-    pinMode(_PINMoveDown, OUTPUT);
-    pinMode(_PINMoveUp, OUTPUT);
+    //Drive relays, limit switch inputs and console controls for each direction
+    for (byte i=0; i < AXIS_COUNT; i++)
+    {
+        Axis &axis = _axes[i];
+        pinMode(axis.motorPin, OUTPUT);
+        digitalWrite(axis.motorPin, RELAYPINOFF); //force low
+        pinMode(axis.limitPin, INPUT_PULLUP);
+        axis.limitPort = registerInput(axis.limitPin, axis.limitMask);
+        if (axis.stickPin)
+        {
+            pinMode(axis.stickPin, INPUT_PULLUP);
+            axis.stickPort = registerInput(axis.stickPin, axis.stickMask);
+        }
+    }
     pinMode(_PINClawSolenoid, OUTPUT);
     pinMode(_PINClawPower, OUTPUT);
 
     analogWrite(_PINClawPower, 20);
 
 
-    //Limit switch inputs
-    pinMode(_PINLimitLeft, INPUT_PULLUP);
-    pinMode(_PINLimitRight, INPUT_PULLUP);
-    pinMode(_PINLimitForward, INPUT_PULLUP);
-    pinMode(_PINLimitBackward, INPUT_PULLUP);
-    pinMode(_PINLimitDown, INPUT_PULLUP);
-    pinMode(_PINLimitUp, INPUT_PULLUP);
-
-    //force low
-    digitalWrite(_PINMoveLeft, RELAYPINOFF);
-    digitalWrite(_PINMoveRight, RELAYPINOFF);
-    digitalWrite(_PINMoveForward, RELAYPINOFF);
-    digitalWrite(_PINMoveBackward, RELAYPINOFF);
-    digitalWrite(_PINMoveDown, RELAYPINOFF);
-    digitalWrite(_PINMoveUp, RELAYPINOFF);
     digitalWrite(_PINClawSolenoid, RELAYPINOFF);
 
-    //Setup console controls
-    pinMode(_PINStickMoveLeft, INPUT_PULLUP);
-    pinMode(_PINStickMoveRight, INPUT_PULLUP);
-    pinMode(_PINStickMoveForward, INPUT_PULLUP);
-    pinMode(_PINStickMoveBackward, INPUT_PULLUP);
     pinMode(_PINStickMoveDown, INPUT_PULLUP);
-    
+    _stickDropPort = registerInput(_PINStickMoveDown, _stickDropMask);
 
+    sampleInputs(); //startup checks limits before the first loop samples them
 }
 
 
@@ -440,6 +635,8 @@ void initConveyor()
 
     pinMode(_PINConveyorSensor, INPUT_PULLUP);
     pinMode(_PINConveyorSensor2, INPUT_PULLUP);
+    _conveyorSensors.setSensor(0, EVENT_CONVEYOR_TRIPPED, 0, _conveyorSensorTripDelay);
+    _conveyorSensors.setSensor(1, EVENT_CONVEYOR2_TRIPPED, 0, _conveyorSensorTripDelay);
 
     digitalWrite(_PINConveyorBelt, RELAYPINOFF); //relay
 }
@@ -447,68 +644,36 @@ void initConveyor()
 void handleJoystick()
 {
     //ignore console when 
-    if (_currentState != STATE_RUNNING)
+    if (_currentState != STATE_RUNNING || isTaskPending())
         return;
 
-    int val = digitalRead(_PINStickMoveDown);
-    if (val == LOW)
+    if (!(_inputSnapshot[_stickDropPort] & _stickDropMask)) //pressed pulls the pin low
     {
         if ((_gameMode == GAMEMODE_CLAW) || 
             (_gameMode == GAMEMODE_TARGET && !_isClawClosed)) //when in target mode we're only allowed to drop if the claw isnt closed
             dropClawProcedure();
         else if (_gameMode == GAMEMODE_TARGET && _isClawClosed)
-        {
-            openClaw();
-            delay(1000);
-            if (_doWiggle)
-                    wiggleClaw();
-            delay(1000);
-            returnToWinChute();
-        }
+            releaseAndReturn(1000);
         return;
     }
     
     if (_gameMode == GAMEMODE_TARGET && !_isClawClosed) //don't allow joystick to move when it's over the chute, we need to drop & grab stuff first
         return;
 
-    val = digitalRead(_PINStickMoveBackward);
-    if (val == LOW)
-    {
-        _moveFromJoystickBackward = true;
-        runMotorBackward(false);
-    } else if (_moveFromJoystickBackward) {
-        _moveFromJoystickBackward = false;
-        stopMotorBackward();
-    }
-
-    val = digitalRead(_PINStickMoveForward);
-    if (val == LOW)
-    {
-        _moveFromJoystickForward = true;
-        runMotorForward(false);
-    } else if (_moveFromJoystickForward) {
-        _moveFromJoystickForward = false;
-        stopMotorForward();
-    }
-
-    val = digitalRead(_PINStickMoveLeft);
-    if (val == LOW)
+    for (byte i=0; i < AXIS_COUNT; i++)
     {
-        _moveFromJoystickLeft = true;
-        runMotorLeft(false);
-    } else if (_moveFromJoystickLeft) {
-        _moveFromJoystickLeft = false;
-        stopMotorLeft();
-    }
+        Axis &axis = _axes[i];
+        if (!axis.stickPin)
+            continue;
 
-    val = digitalRead(_PINStickMoveRight);
-    if (val == LOW)
-    {
-        _moveFromJoystickRight = true;
-        runMotorRight(false);
-    } else if (_moveFromJoystickRight) {
-        _moveFromJoystickRight = false;
-        stopMotorRight();
+        if (!(_inputSnapshot[axis.stickPort] & axis.stickMask)) //pressed pulls the pin low
+        {
+            axis.fromJoystick = true;
+            runAxis(i, false);
+        } else if (axis.fromJoystick) {
+            axis.fromJoystick = false;
+            stopAxis(i);
+        }
     }
 
 }
@@ -518,97 +683,38 @@ void checkLimits()
     static unsigned long curTime = 0;
     curTime = millis();
 
-    if (_isMotorRunningUp && (isLimitUp() || curTime - _timestampMotorMoveUp > _failsafeMotorLimit))
+    for (byte i=0; i < AXIS_COUNT; i++)
     {
-        debugLine("H L U");
-        //up and down events require a bit of extra pause when the limit sensor is hit just to make sure it's all the way there
-        delay(200); //brief rest for the claw
-
-
-        if (curTime - _timestampMotorMoveUp > _failsafeMotorLimit)
-        {
-            stopMotorUp(); //failsafe kills motor regardless of override
-            changeState(STATE_FAILSAFE);
-            sendEvent(EVENT_FAILSAFE_UP);
-            return; //if we hit a failsafe, don't send anymore notifications
-        }
-        else if (!_recoilLimitOverride) //motor override not in effect
+        Axis &axis = _axes[i];
+        if (!axis.running)
         {
-            stopMotorUp();
-            sendEvent(EVENT_LIMIT_UP);
+            axis.timestampLimit = 0;
+            continue;
         }
-    }
 
-    if (_isMotorRunningDown && (isLimitDown() || curTime - _timestampMotorMoveDown > _failsafeMotorLimit))
-    {
-        debugLine("H L D");
-        //up and down events require a bit of extra pause when the limit sensor is hit just to make sure it's all the way there
-        delay(200); //brief rest for the claw
-        stopMotorDown();
-        if (curTime - _timestampMotorMoveDown > _failsafeMotorLimit)
-        {
-            changeState(STATE_FAILSAFE);
-            sendEvent(EVENT_FAILSAFE_DOWN);
-            return; //if we hit a failsafe, don't send anymore notifications
-        }
-        else
-            sendEvent(EVENT_LIMIT_DOWN);
-    }
+        bool failsafe = curTime - axis.timestampMove > _failsafeMotorLimit;
+        if (!axis.timestampLimit && (isAxisLimit(i) || failsafe))
+            axis.timestampLimit = curTime;
 
-    if (_isMotorRunningLeft && (isLimitLeft() || curTime - _timestampMotorMoveLeft > _failsafeMotorLimit))
-    {
-        debugLine("H L L");
-        stopMotorLeft();
-        if (curTime - _timestampMotorMoveLeft > _failsafeMotorLimit)
-        {
-            changeState(STATE_FAILSAFE);
-            sendEvent(EVENT_FAILSAFE_LEFT);
-            return; //if we hit a failsafe, don't send anymore notifications
-        }
-        else
-            sendEvent(EVENT_LIMIT_LEFT);
-    }
+        //up and down events require a bit of extra pause when the limit sensor is hit just to make sure it's all the way there
+        if (!axis.timestampLimit || (axis.settles && curTime - axis.timestampLimit < _limitSettleTime))
+            continue;
 
-    if (_isMotorRunningRight && (isLimitRight() || curTime - _timestampMotorMoveRight > _failsafeMotorLimit))
-    {
-        debugLine("H L R");
-        stopMotorRight();
-        if (curTime - _timestampMotorMoveRight > _failsafeMotorLimit)
-        {
-            changeState(STATE_FAILSAFE);
-            sendEvent(EVENT_FAILSAFE_RIGHT);
-            return; //if we hit a failsafe, don't send anymore notifications
-        }
-        else
-            sendEvent(EVENT_LIMIT_RIGHT);
-    }
+        debugString("H L ");
+        debugLine((char*)axis.name);
 
-    if (_isMotorRunningForward && (isLimitForward() || curTime - _timestampMotorMoveForward > _failsafeMotorLimit))
-    {
-        debugLine("H L F");
-        stopMotorForward();
-        if (curTime - _timestampMotorMoveForward > _failsafeMotorLimit)
+        if (failsafe)
         {
+            stopAxis(i); //failsafe kills motor regardless of override
             changeState(STATE_FAILSAFE);
-            sendEvent(EVENT_FAILSAFE_FORWARD);
+            sendEvent(axis.failsafeEvent);
             return; //if we hit a failsafe, don't send anymore notifications
         }
-        else
-            sendEvent(EVENT_LIMIT_FORWARD);
-    }
-
-    if (_isMotorRunningBackward && (isLimitBackward() || curTime - _timestampMotorMoveBackward > _failsafeMotorLimit))
-    {
-        debugLine("H L B");
-        stopMotorBackward();
-        if (curTime - _timestampMotorMoveBackward > _failsafeMotorLimit)
+        else if (i != AXIS_UP || !_recoilLimitOverride) //recoil override keeps tension on the claw
         {
-            changeState(STATE_FAILSAFE);
-            sendEvent(EVENT_FAILSAFE_BACKWARD);
-            return; //if we hit a failsafe, don't send anymore notifications
+            stopAxis(i);
+            sendEvent(axis.limitEvent);
         }
-        else
-            sendEvent(EVENT_LIMIT_BACKWARD);
     }
 
     if (_isClawClosed && (curTime - _timestampClawClosed > _failsafeClawOpened))
@@ -618,99 +724,54 @@ void checkLimits()
         if (_gameMode == GAMEMODE_CLAW)
             sendEvent(EVENT_FAILSAFE_CLAW);
         else if (_gameMode == GAMEMODE_TARGET)
-        {
-            delay(250);
-            returnToWinChute();
-        }
+            addTask(returnToWinChute, 250);
         return;
     }
 }
 
 void checkStates()
 {
-    switch (_currentState)
+    //a sequence is waiting on a timed step, leave the state alone until it's done
+    if (isTaskPending())
+        return;
+
+    //claw slipped down on the way to the chute, stop and recoil before going on
+    if (_currentState == STATE_CHECK_RUNCHUTE && !isAxisLimit(AXIS_UP))
     {
-        case  STATE_CHECK_RUNCHUTE_LEFT:
-            if (!isLimitUp())
-            {
-                stopMotorLeft();
-                changeState(STATE_CHECK_DROP_RECOIL);
-            }
-        case STATE_CHECK_RUNCHUTE_RIGHT:
-            if (!isLimitUp())
-            {
-                stopMotorRight();
-                changeState(STATE_CHECK_DROP_RECOIL);
-            }
-            break;
+        stopPendingAxes();
+        changeState(STATE_CHECK_DROP_RECOIL);
     }
 
     //Now check the current state and perform an action
     switch (_currentState)
     {
         case STATE_CHECK_STARTUP_RECOIL:
-            if (isLimitUp())
+            if (isAxisSettled(AXIS_UP))
             {
-                stopMotorUp();
+                stopAxis(AXIS_UP);
                 startupMachine();
                 debugLine(_currentState);
             }
-            else if (!_isMotorRunningUp) //a scenario where the motor was stopped but it's not at the limit
+            else if (!_axes[AXIS_UP].running) //a scenario where the motor was stopped but it's not at the limit
             {
-                runMotorUp(false);
+                runAxis(AXIS_UP, false);
             }
             break;
-        case STATE_CHECK_STARTUP_RIGHT:
-            if (isLimitRight())
+        case STATE_CHECK_STARTUP_WARM:
+        case STATE_CHECK_STARTUP_RF:
+            if (checkAxesAtLimits())
             {
-                stopMotorRight();
                 startupMachine();
                 debugLine(_currentState);
             }
-            else if (!_isMotorRunningRight) //a scenario where the motor was stopped but it's not at the limit
-            {
-                runMotorRight(false);
-            }
 
             break;
 
-        case STATE_CHECK_STARTUP_FORWARD:
-            if (isLimitForward())
-            {
-                stopMotorForward();
-                startupMachine();
-                debugLine(_currentState);
-            }
-            else if (!_isMotorRunningForward) //a scenario where the motor was stopped but it's not at the limit
+        case STATE_CHECK_HOMING_LB:
+            if (checkAxesAtLimits())
             {
-                runMotorForward(false);
-            }
-
-            break;
-
-        case STATE_CHECK_HOMING_L:
-            if (isLimitLeft())
-            {
-                stopMotorLeft();
                 performHoming();
                 debugLine(_currentState);
-            } else if (!_isMotorRunningLeft) //a scenario where the motor was stopped but it's not at the limit
-            {
-                runMotorLeft(false);
-            }
-
-            break;
-
-        case STATE_CHECK_HOMING_B:
-            if (isLimitBackward())
-            {
-                stopMotorBackward();
-                performHoming();
-                debugLine(_currentState);
-            }
-            else if (!_isMotorRunningBackward) //a scenario where the motor was stopped but it's not at the limit
-            {
-                runMotorBackward(false);
             }
 
             break;
@@ -725,16 +786,16 @@ void checkStates()
                 
                         if (diffTime > _runToCenterDurationWidth)
                         {
-                            stopMotorRight();
-                            stopMotorLeft();
+                            stopAxis(AXIS_RIGHT);
+                            stopAxis(AXIS_LEFT);
                             isWidthReached = true;
                         }
                         break;
                     case GAMEMODE_TARGET:
                         if (diffTime > _runToCenterDurationWidth + 250)
                         {
-                            stopMotorRight();
-                            stopMotorLeft();
+                            stopAxis(AXIS_RIGHT);
+                            stopAxis(AXIS_LEFT);
                             isWidthReached = true;
                         }
                         break;
@@ -742,8 +803,8 @@ void checkStates()
 
                 if (diffTime > _runToCenterDurationDepth)
                 {
-                    stopMotorForward();
-                    stopMotorBackward();
+                    stopAxis(AXIS_FORWARD);
+                    stopAxis(AXIS_BACKWARD);
                     if (isWidthReached)
                     {
                         _failsafeCurrentResets = 0; //reset the failsafe counter because we properly reset
@@ -755,87 +816,42 @@ void checkStates()
             }
             break;
         case STATE_CHECK_DROP_TENSION:
-            if (isLimitDown())
+            if (isAxisSettled(AXIS_DOWN))
             {
-                stopMotorDown();
-                delay(300); //brief rest for the claw
-                dropClawProcedure();
+                stopAxis(AXIS_DOWN);
+                addTask(dropClawProcedure, 300); //brief rest for the claw
             }
-            else if (!_isMotorRunningDown) //a scenario where the motor was stopped but it's not at the limit
+            else if (!_axes[AXIS_DOWN].running) //a scenario where the motor was stopped but it's not at the limit
             {
-                runMotorDown(false);
+                runAxis(AXIS_DOWN, false);
             }
 
             break;
         case STATE_CHECK_DROP_RECOIL:
-            if (isLimitUp())
+            if (isAxisSettled(AXIS_UP))
             {
-                stopMotorUp();
+                stopAxis(AXIS_UP);
                 dropClawProcedure();
             }
-            else if (!_isMotorRunningUp) //a scenario where the motor was stopped but it's not at the limit
-            {
-                runMotorUp(false);
-            }
-
-            break;
-        case STATE_CHECK_RUNCHUTE_LEFT:
-            if (isLimitLeft())
-            {
-                stopMotorLeft();
-                delay(300); //brief rest for the claw
-                returnToWinChute();
-            }
-            else if (!_isMotorRunningLeft) //a scenario where the motor was stopped but it's not at the limit
+            else if (!_axes[AXIS_UP].running) //a scenario where the motor was stopped but it's not at the limit
             {
-                runMotorLeft(false);
+                runAxis(AXIS_UP, false);
             }
 
             break;
-        case STATE_CHECK_RUNCHUTE_RIGHT:
-            if (isLimitRight())
-            {
-                stopMotorRight();
-                delay(300); //brief rest for the claw
-                returnToWinChute();
-            }
-            else if (!_isMotorRunningRight) //a scenario where the motor was stopped but it's not at the limit
-            {
-                runMotorRight(false);
-            }
-            break;
-        case STATE_CHECK_RUNCHUTE_FORWARD:
-            if (isLimitForward())
-            {
-                stopMotorForward();
-                delay(300); //brief rest for the claw
-                returnToWinChute();
-            }
-            else if (!_isMotorRunningForward) //a scenario where the motor was stopped but it's not at the limit
-            {
-                runMotorForward(false);
-            }
+        case STATE_CHECK_RUNCHUTE:
+            if (checkAxesAtLimits())
+                addTask(returnToWinChute, 300); //brief rest for the claw
 
             break;
-        case STATE_CHECK_RUNCHUTE_BACK:
-            if (isLimitBackward())
-            {
-                stopMotorBackward();
-                delay(300); //brief rest for the claw
-                returnToWinChute();
-            }
-            else if (!_isMotorRunningBackward) //a scenario where the motor was stopped but it's not at the limit
-            {
-                runMotorBackward(false);
-            }
-            break;
 
     }
 }
 
 /**
  *
- * Kicks off startup procedure, recoils claw, runs to the back right corner of the machine then performHoming()
+ * Kicks off startup procedure, recoils claw, runs right and forward together to the back right corner of the machine then performHoming()
+ * With a stored calibration it runs to the home corner instead and centers from there if the run fits the stored travel times
  *
  */
 void startupMachine()
@@ -844,26 +860,40 @@ void startupMachine()
     _homeLocation = HOME_LOCATION_FL;
 
     
-    if (!isLimitUp())
+    if (!isAxisLimit(AXIS_UP))
     {
         
         changeState(STATE_CHECK_STARTUP_RECOIL);
-        runMotorUp(false);
+        runAxis(AXIS_UP, false);
         return;
     }
 
-    if (!isLimitRight())
+    if (_warmBootPending)
     {
-        changeState(STATE_CHECK_STARTUP_RIGHT);
-        runMotorRight(false);
-        return;
+        if (_currentState != STATE_CHECK_STARTUP_WARM)
+        {
+            changeState(STATE_CHECK_STARTUP_WARM);
+            if (runAxesToLimits((1 << AXIS_LEFT) | (1 << AXIS_BACKWARD)))
+                return;
+        }
+
+        _warmBootPending = false;
+
+        //from anywhere the home corner can't be further away than a full sweep, if it was the machine changed
+        if (_axes[AXIS_LEFT].timespanToLimit <= _timespanRunWidth + _timespanRunWidth / 4 &&
+            _axes[AXIS_BACKWARD].timespanToLimit <= _timespanRunDepth + _timespanRunDepth / 4)
+        {
+            debugLine("W B");
+            returnCenterFromChute();
+            return;
+        }
     }
 
-    if (!isLimitForward())
+    if (_currentState != STATE_CHECK_STARTUP_RF)
     {
-        changeState(STATE_CHECK_STARTUP_FORWARD);
-        runMotorForward(false);
-        return;
+        changeState(STATE_CHECK_STARTUP_RF);
+        if (runAxesToLimits((1 << AXIS_RIGHT) | (1 << AXIS_FORWARD)))
+            return;
     }
 
     changeState(STATE_CHECK_HOMING);
@@ -873,45 +903,28 @@ void startupMachine()
 
 /**
  *
- * Starting from the back right side of the machine, run to the left, time it, run to the front, time it, divide the time by two, save it, then returnCenterFromChute()
+ * Starting from the back right side of the machine, run left and to the front together timing each, divide the times by two, save them, then returnCenterFromChute()
  *
  */
 void performHoming()
 {
-    static unsigned long curTime = 0;
-    curTime = millis();
-
     if (_currentState == STATE_CHECK_HOMING)
     {
-        _timestampRunLeft = curTime;
-        changeState(STATE_CHECK_HOMING_L);
-        if (!isLimitLeft())
-        {
-            runMotorLeft(false);
-            return;
-        }
-    }
-
-    if (_currentState == STATE_CHECK_HOMING_L)
-    {
-        _timespanRunWidth = curTime - _timestampRunLeft; //possibly re-use timestamprunleft if memory required
-        _timestampRunBackward = curTime;
-        changeState(STATE_CHECK_HOMING_B);
-        if (!isLimitBackward())
-        {
-            runMotorBackward(false);
+        changeState(STATE_CHECK_HOMING_LB);
+        if (runAxesToLimits((1 << AXIS_LEFT) | (1 << AXIS_BACKWARD)))
             return;
-        }
     }
 
-    if (_currentState == STATE_CHECK_HOMING_B)
+    if (_currentState == STATE_CHECK_HOMING_LB)
     {
-        _timespanRunDepth = curTime - _timestampRunBackward; //possibly re-use _timestampRunBackward if memory required
+        _timespanRunWidth = _axes[AXIS_LEFT].timespanToLimit;
+        _timespanRunDepth = _axes[AXIS_BACKWARD].timespanToLimit;
 
         _halfTimespanRunWidth = _timespanRunWidth / 2;
         _halfTimespanRunDepth = _timespanRunDepth / 2;
         _runToCenterDurationDepth = _halfTimespanRunDepth;
         _runToCenterDurationWidth = _halfTimespanRunWidth;
+        saveCalibration();
         returnCenterFromChute();
     }
 
@@ -932,7 +945,7 @@ void dropClawProcedure()
             changeState(STATE_CHECK_DROP_RECOIL);
             sendEvent(EVENT_DROPPED_CLAW);
             closeClaw();
-            runMotorUp(false);
+            runAxis(AXIS_UP, false);
             return;
         }
 
@@ -950,7 +963,7 @@ void dropClawProcedure()
         {
             changeState(STATE_CHECK_DROP_TENSION);
             sendEvent(EVENT_DROPPING_CLAW);
-            runMotorDown(false);
+            runAxis(AXIS_DOWN, false);
             return;
         }
     } else if (_gameMode == GAMEMODE_TARGET)
@@ -961,7 +974,7 @@ void dropClawProcedure()
                 closeClaw();
                 changeState(STATE_CHECK_DROP_RECOIL);
                 sendEvent(EVENT_DROPPED_CLAW);
-                runMotorUp(false);
+                runAxis(AXIS_UP, false);
                 return;
             case STATE_CHECK_DROP_RECOIL:
                 sendEvent(EVENT_RECOILED_CLAW);
@@ -970,7 +983,7 @@ void dropClawProcedure()
             case STATE_RUNNING:
                 changeState(STATE_CHECK_DROP_TENSION);
                 sendEvent(EVENT_DROPPING_CLAW);
-                runMotorDown(false);
+                runAxis(AXIS_DOWN, false);
                 return;
         }
     }
@@ -978,73 +991,81 @@ void dropClawProcedure()
 
 /**
  *
- * run to left & front of machine, open claw, then returnCenterFromChute()
+ * run to the home corner of the machine, open claw, then returnCenterFromChute()
  *
  */
 void returnToWinChute()
 {
-    //ran left/right to limit
-    if (_currentState == STATE_CHECK_RUNCHUTE_LEFT || _currentState == STATE_CHECK_RUNCHUTE_RIGHT)
-    {
-        if (_homeLocation == HOME_LOCATION_BR || _homeLocation == HOME_LOCATION_BL) //run forward (back of machine)
-        {
-            changeState(STATE_CHECK_RUNCHUTE_FORWARD);
-            runMotorForward(false);
-        } else {
-            changeState(STATE_CHECK_RUNCHUTE_BACK); //run backward (front of machine)
-            runMotorBackward(false);
-        }
-        return;
-    }
-    else if (_currentState == STATE_CHECK_RUNCHUTE_BACK || _currentState == STATE_CHECK_RUNCHUTE_FORWARD) //over the win chute now
+    if (_currentState == STATE_CHECK_RUNCHUTE) //over the win chute now
     {
         sendEvent(EVENT_RETURNED_HOME);
         openClaw();
 
-        delay(200);
-
+        unsigned int wait = 200;
         if (_doWiggle)
-            wiggleClaw(); //blocking wiggle
-
-        delay(250);
-
-        if (_gameMode == GAMEMODE_CLAW)
-            returnCenterFromChute();
-        else if (_gameMode == GAMEMODE_TARGET)
         {
-            stopMotorUp(); //stop recoil
-            //grab some more stuff
-            _clawRemoteMoveDurationDrop = 0;
-            _clawRemoteMoveStartTimeDrop = millis();
-            if (_autoDropTargeting)
-                dropClawProcedure();
-            else
-                changeState(STATE_RUNNING);
+            wiggleClaw(wait);
+            wait = 0;
         }
-
+        addTask(leaveWinChute, wait + 250);
         return;
     } else
     {
         
         //recoil claw with force when returning home
         _recoilLimitOverride = true;
-        runMotorUp(true);
-        delay(200);
-
-        if (_homeLocation == HOME_LOCATION_FR || _homeLocation == HOME_LOCATION_BR) //run right
-        {
-            changeState(STATE_CHECK_RUNCHUTE_RIGHT);
-            runMotorRight(false);
-        } else
-        { // if (_homeLocation == HOME_LOCATION_FL)
-            changeState(STATE_CHECK_RUNCHUTE_LEFT);
-            runMotorLeft(false);
-        }
+        runAxis(AXIS_UP, true);
+        addTask(runToWinChute, 200);
         return;
     }
 
 }
 
+/**
+ *
+ * Over the win chute with the claw open, head back or grab more
+ *
+ */
+void leaveWinChute()
+{
+    if (_gameMode == GAMEMODE_CLAW)
+        returnCenterFromChute();
+    else if (_gameMode == GAMEMODE_TARGET)
+    {
+        stopAxis(AXIS_UP); //stop recoil
+        //grab some more stuff
+        _clawRemoteMoveDurationDrop = 0;
+        _clawRemoteMoveStartTimeDrop = millis();
+        if (_autoDropTargeting)
+            dropClawProcedure();
+        else
+            changeState(STATE_RUNNING);
+    }
+}
+
+/**
+ *
+ * Recoiling, run left/right and forward/back together toward the win chute
+ *
+ */
+void runToWinChute()
+{
+    byte axes = 0;
+    if (_homeLocation == HOME_LOCATION_FR || _homeLocation == HOME_LOCATION_BR) //run right
+        axes |= 1 << AXIS_RIGHT;
+    else
+        axes |= 1 << AXIS_LEFT;
+
+    if (_homeLocation == HOME_LOCATION_BR || _homeLocation == HOME_LOCATION_BL) //run forward (back of machine)
+        axes |= 1 << AXIS_FORWARD;
+    else
+        axes |= 1 << AXIS_BACKWARD; //run backward (front of machine)
+
+    changeState(STATE_CHECK_RUNCHUTE);
+    if (!runAxesToLimits(axes))
+        addTask(returnToWinChute, 300); //already there
+}
+
 /**
  *
  * To return to center take the times set from performHoming and then run to the back/right for that amount of time
@@ -1059,14 +1080,14 @@ void returnCenterFromChute()
     
     //start direction based on the home
     if (_homeLocation == HOME_LOCATION_BL || _homeLocation == HOME_LOCATION_FL)
-        runMotorRight(false);
+        runAxis(AXIS_RIGHT, false);
     else
-        runMotorLeft(false);
+        runAxis(AXIS_LEFT, false);
     
     if (_homeLocation == HOME_LOCATION_FL || _homeLocation == HOME_LOCATION_FR)
-        runMotorForward(false);
+        runAxis(AXIS_FORWARD, false);
     else
-        runMotorBackward(false);
+        runAxis(AXIS_BACKWARD, false);
 }
 
 
@@ -1078,205 +1099,45 @@ void returnCenterFromChute()
  *
  */
 
-void notifyLedControllerMessage()
-{
-    _waitForLedAckTimestamp = millis();
-    ledController.print(RTS);
-    ledController.flush();
-}
-
 void sendLedControllerMessage(char message[])
 {
-    notifyLedControllerMessage();
-    strncpy(_lastLedMessage, message, strlen(message)+1);
-    
-}
-
-void sendLedControllerData(char message[])
-{
-    ledController.print(message);
-    ledController.print(CS);
+    _ledLink.send(message);
 }
 
 void handleLedSerialCommands()
 {
-    //if we sent a message but didn't receive an ACK then send again
-    if (_waitForLedAckTimestamp && millis() - _waitForLedAckTimestamp > 300)
-    {
-        _waitForLedAckCount++;
-        notifyLedControllerMessage();
-    }
-
-    if (_waitForLedAckCount > 5) //give up after 5 attempts
-    {
-        _waitForLedAckTimestamp = 0;
-        _waitForLedAckCount = 0;
-    }
-
-    static byte sidx = 0; //serial cursor
-    static unsigned long startTime = 0; //memory placeholder
-
-    startTime = millis();
-
-    //if we have data, read it
-    while (ledController.available()) //burn through data waiting for start byte
-    {
-        char thisChar = ledController.read();
-        if (thisChar == RTS) //if the other end wants to send data, tell them it's OK
-        {
-            ledController.print(CTS);
-            ledController.flush();
-
-            //reset the index
-            sidx = 0;
-            while (millis() - startTime < 300) //wait up to 300ms for next byte
-            {
-                if (!ledController.available())
-                    continue;
-
-                startTime = millis(); //update received timestamp, allows slow data to come in (manually typing)
-                thisChar = ledController.read();
-                if (thisChar == RTS)
-                    continue;
-                if (thisChar == CS)
-                {
-                    while (ledController.available() > 0) //burns the buffer
-                        ledController.read();
-
-                    _sLedIncomingCommand[sidx] = '\0'; //terminate string
-
-                    int eventid = 0;
-                    char data[10];
-                    debugString("LED: ");
-                    debugLine(_sLedIncomingCommand);
-
-                    // example: 108 1
-                    broadcastToClients(_sLedIncomingCommand);
-
-                    break;
-                } else {
-                    //save our byte
-                    _sLedIncomingCommand[sidx] = thisChar;
-                    sidx++;
-                    //prevent overlfow and reset to our last byte
-                    if (sidx >= _numChars) {
-                        sidx = _numChars - 1;
-                    }
-                }
-            }
-            //we either processed data from a successful command or the command timed out
-        }
-        else if (thisChar == CTS)
-        {
-            _waitForLedAckTimestamp = 0;
-            _waitForLedAckCount = 0;
-
-            sendLedControllerData(_lastLedMessage);
-        }
-    }
+    _ledLink.poll();
 }
 
-void notifyPlinkoControllerMessage()
+//message from the led controller, relayed as is
+void handleLedMessage(char message[])
 {
-    _waitForAckTimestamp = millis();
-    plinkoController.print(RTS);
-    plinkoController.flush();
+    debugString("LED: ");
+    debugLine(message);
+
+    broadcastToClients(message);
 }
 
 void sendPlinkoControllerMessage(char message[])
 {
-    notifyPlinkoControllerMessage();
-    strncpy(_lastPlinkoMessage, message, strlen(message)+1);
-    
+    _plinkoLink.send(message);
 }
 
-void sendPlinkoControllerData(char message[])
+void handlePlinkoSerialCommands()
 {
-    plinkoController.print(message);
-    plinkoController.print(CS);
+    _plinkoLink.poll();
 }
 
-//command from plinko is ".command args!"
-void handlePlinkoSerialCommands()
+//message from plinko is "eventid data"
+void handlePlinkoMessage(char message[])
 {
-    //if we sent a message but didn't receive an ACK then send again
-    if (_waitForAckTimestamp && millis() - _waitForAckTimestamp > 300)
-    {
-        _waitForAckCount++;
-        notifyPlinkoControllerMessage();
-    }
+    debugString("Plinko: ");
+    debugLine(message);
 
-    if (_waitForAckCount > 5) //give up after 5 attempts
-    {
-        _waitForAckTimestamp = 0;
-        _waitForAckCount = 0;
-    }
-    
-    static byte sidx = 0; //serial cursor
-    static unsigned long startTime = 0; //memory placeholder
-
-    startTime = millis();
-
-    //if we have data, read it
-    while (plinkoController.available()) //burn through data waiting for start byte
-    {
-        char thisChar = plinkoController.read();
-        if (thisChar == RTS)
-        {
-            plinkoController.print(CTS);
-            plinkoController.flush();
-
-            //reset the index
-            sidx = 0;
-
-            while (millis() - startTime < 300) //wait up to 300ms for next byte
-            {
-
-                if (!plinkoController.available())
-                    continue;
-
-                startTime = millis(); //update received timestamp, allows slow data to come in (manually typing)
-                thisChar = plinkoController.read();
-                if (thisChar == RTS)
-                    continue;
-                if (thisChar == CS)
-                {
-
-                    while (plinkoController.available() > 0) //burns the buffer
-                        plinkoController.read();
-
-                    _sPlinkoIncomingCommand[sidx] = '\0'; //terminate string
-                    
-                    int eventid = 0;
-                    char data[10];
-                    debugString("Plinko: ");
-                    debugLine(_sPlinkoIncomingCommand);
-                    sscanf(_sPlinkoIncomingCommand, "%d %s", &eventid, data);
-
-                    // example: 108 1
-                    broadcastToClients(eventid, data);
-
-                    break;
-                } else {
-                    //save our byte
-                    _sPlinkoIncomingCommand[sidx] = thisChar;
-                    sidx++;
-                    //prevent overlfow and reset to our last byte
-                    if (sidx >= _numChars) {
-                        sidx = _numChars - 1;
-                    }
-                }
-            }
-            //we either processed data from a successful command or the command timed out
-        }
-        else if (thisChar == CTS)
-        {
-            _waitForAckTimestamp = 0;
-            _waitForAckCount = 0;
-
-            sendPlinkoControllerData(_lastPlinkoMessage);
-        }
-    }
+    // example: 108 1
+    int eventid = atoi(message);
+    char *data = strchr(message, ' ');
+    broadcastToClients(eventid, data ? data + 1 : (char*)"");
 }
 
 /**
@@ -1293,35 +1154,14 @@ void checkMovements()
     //if duration is negative, we may have started movign the claw but it requires a stop command to stop it
     //we verify there is also a start time
     //then check if we've waited long enough
-    if (_clawRemoteMoveDurationForward >= 0 && _clawRemoteMoveStartTimeForward > 0 && curTime - _clawRemoteMoveStartTimeForward >= _clawRemoteMoveDurationForward)
-    {
-        stopMotorForward();
-        _clawRemoteMoveStartTimeForward = 0;
-    }
-    if (_clawRemoteMoveDurationBackward >= 0 && _clawRemoteMoveStartTimeBackward > 0 && curTime - _clawRemoteMoveStartTimeBackward >= _clawRemoteMoveDurationBackward)
-    {
-        stopMotorBackward();
-        _clawRemoteMoveStartTimeBackward = 0;
-    }
-    if (_clawRemoteMoveDurationLeft >= 0 && _clawRemoteMoveStartTimeLeft > 0 && curTime - _clawRemoteMoveStartTimeLeft >= _clawRemoteMoveDurationLeft)
-    {
-        stopMotorLeft();
-        _clawRemoteMoveStartTimeLeft = 0;
-    }
-    if (_clawRemoteMoveDurationRight >= 0 && _clawRemoteMoveStartTimeRight > 0 && curTime - _clawRemoteMoveStartTimeRight >= _clawRemoteMoveDurationRight)
-    {
-        stopMotorRight();
-        _clawRemoteMoveStartTimeRight = 0;
-    }
-    if (_clawRemoteMoveDurationDown >= 0 && _clawRemoteMoveStartTimeDown > 0 && curTime - _clawRemoteMoveStartTimeDown >= _clawRemoteMoveDurationDown)
-    {
-        stopMotorDown();
-        _clawRemoteMoveStartTimeDown = 0;
-    }
-    if (_clawRemoteMoveDurationUp >= 0 && _clawRemoteMoveStartTimeUp > 0 && curTime - _clawRemoteMoveStartTimeUp >= _clawRemoteMoveDurationUp)
+    for (byte i=0; i < AXIS_COUNT; i++)
     {
-        stopMotorUp();
-        _clawRemoteMoveStartTimeUp = 0;
+        Axis &axis = _axes[i];
+        if (axis.remoteDuration >= 0 && axis.remoteStartTime > 0 && curTime - axis.remoteStartTime >= axis.remoteDuration)
+        {
+            stopAxis(i);
+            axis.remoteStartTime = 0;
+        }
     }
 }
 
@@ -1471,25 +1311,11 @@ void checkConveyorSensor()
     static unsigned long curTime = 0; //memory placeholder
 
     curTime = millis();
-    int sensorVal = digitalRead(_PINConveyorSensor);
-    if (sensorVal == _conveyorSensorTripped)
-    {
-        
-
-        if (curTime - _timestampConveyorSensorTripped > _conveyorSensorTripDelay)
-            sendEvent(EVENT_CONVEYOR_TRIPPED);
-
-        _timestampConveyorSensorTripped = curTime;
-    }
-
-    sensorVal = digitalRead(_PINConveyorSensor2);
-    if (sensorVal == _conveyorSensorTripped)
-    {
-        if (curTime - _timestampConveyor2SensorTripped > _conveyorSensorTripDelay)
-            sendEvent(EVENT_CONVEYOR2_TRIPPED);
+    _conveyorSensors.sample(0, digitalRead(_PINConveyorSensor) == _conveyorSensorTripped, curTime);
+    _conveyorSensors.sample(1, digitalRead(_PINConveyorSensor2) == _conveyorSensorTripped, curTime);
 
-        _timestampConveyor2SensorTripped = curTime;
-    }
+    while (_conveyorSensors.available())
+        sendEvent(_conveyorSensors.read());
 }
 
 void checkGameReset()
@@ -1523,28 +1349,114 @@ void sendEvent(int event)
  */
 void broadcastToClients(int event, char outputData[])
 {
-    debugInt(event);
-    debugString(":0 ");
-    debugLine(outputData);
+    queueEvent(event, outputData);
+}
 
+void broadcastToClients(char outputData[])
+{
+    queueEvent(EVENT_INFO, outputData);
+}
+
+//limit and failsafe events only report state, a repeat says nothing new
+bool isStatusEvent(int event)
+{
+    return (event >= EVENT_LIMIT_LEFT && event <= EVENT_LIMIT_DOWN) || (event >= EVENT_FAILSAFE_LEFT && event <= EVENT_FAILSAFE_FLIPPER);
+}
+
+//true if every connected client still has this event waiting
+bool isEventPending(int event)
+{
+    bool anyClient = false;
+    unsigned long newest = 0; //cursor of the client furthest along
     for (byte i=0; i < _clientCount; i++)
     {
-        if (_clients[i] && _clients[i].connected())
-            sendFormattedResponse(_clients[i], event, "0", outputData);
+        if (!_clients[i] || !_clients[i].connected())
+            continue;
+        if (!anyClient || _connections[i].eventCursor > newest)
+            newest = _connections[i].eventCursor;
+        anyClient = true;
     }
+    if (!anyClient)
+        return false;
+
+    for (unsigned long seq = newest; seq != _eventQueueNext; seq++)
+    {
+        if (_eventQueue[seq % _eventQueueSize].event == event)
+            return true;
+    }
+    return false;
 }
 
-void broadcastToClients(char outputData[])
+//format an event into the ring, the oldest event is overwritten when it's full
+void queueEvent(int event, char outputData[])
 {
-    debugInt(EVENT_INFO);
-    debugString(":0 ");
-    debugLine(outputData);
+    if (isStatusEvent(event) && isEventPending(event))
+    {
+        _eventsCoalesced++;
+        return;
+    }
+
+    QueuedEvent &entry = _eventQueue[_eventQueueNext % _eventQueueSize];
+    entry.event = event;
+    int length = snprintf(entry.line, _eventLineChars, "%i:0 %s\r\n", event, outputData);
+    if (length >= _eventLineChars) //truncated, keep the line ending
+    {
+        length = _eventLineChars - 1;
+        entry.line[length - 2] = '\r';
+        entry.line[length - 1] = '\n';
+    }
+    entry.length = length;
+    _eventQueueNext++;
 
+    //anyone a full ring behind just lost their oldest event
     for (byte i=0; i < _clientCount; i++)
     {
-        if (_clients[i] && _clients[i].connected())
-            sendFormattedResponse(_clients[i], EVENT_INFO, "0", outputData);
+        if (_eventQueueNext - _connections[i].eventCursor > _eventQueueSize)
+        {
+            _connections[i].eventCursor = _eventQueueNext - _eventQueueSize;
+            if (_clients[i] && _clients[i].connected())
+                _connections[i].eventsDropped++;
+        }
+    }
+    if (_eventQueueNext - _serialEventCursor > _eventQueueSize)
+        _serialEventCursor = _eventQueueNext - _eventQueueSize;
+}
+
+//write queued events to everyone, whole lines only and only what fits without blocking
+void sendQueuedEvents()
+{
+    int budget = _eventLoopByteBudget;
+
+    if (!_isDebugMode)
+        _serialEventCursor = _eventQueueNext;
+    while (_serialEventCursor != _eventQueueNext && budget > 0)
+    {
+        QueuedEvent &entry = _eventQueue[_serialEventCursor % _eventQueueSize];
+        if (Serial.availableForWrite() < entry.length)
+            break;
+        Serial.write((uint8_t*)entry.line, entry.length);
+        budget -= entry.length;
+        _serialEventCursor++;
+    }
+
+    for (byte n=0; n < _clientCount && budget > 0; n++)
+    {
+        byte i = (_nextClientToDrain + n) % _clientCount;
+        if (!_clients[i] || !_clients[i].connected())
+            continue;
+
+        TelnetConnection &conn = _connections[i];
+        while (conn.eventCursor != _eventQueueNext && budget > 0)
+        {
+            QueuedEvent &entry = _eventQueue[conn.eventCursor % _eventQueueSize];
+            if (_clients[i].availableForWrite() < entry.length)
+                break;
+            _clients[i].write((uint8_t*)entry.line, entry.length);
+            budget -= entry.length;
+            conn.eventCursor++;
+        }
     }
+    _nextClientToDrain = (_nextClientToDrain + 1) % _clientCount;
 }
 
 void handleTelnetConnectors()
@@ -1564,57 +1476,115 @@ void handleTelnetConnectors()
         bool foundSlot = false;
         for (byte i=0; i < _clientCount; i++)
         {
-            if (!_clients[i] || !_clients[i].connected()) {
-                //add this person to the list of clients
-                _clients[i] = client;
-                client.flush();
-                foundSlot = true;
-                break;
-            }
+            if (!_clients[i] || !_clients[i].connected()) {
+                //add this person to the list of clients
+                _clients[i] = client;
+                resetConnection(i);
+                client.flush();
+                foundSlot = true;
+                break;
+            }
+        }
+        //if there was no slot open, take the first one
+        if (!foundSlot)
+        {
+            _clients[0].flush();
+            _clients[0].stop();
+            _clients[0] = client;
+            resetConnection(0);
+            client.flush();
+        }
+    }
+
+    //check for new data from everyone, round robin with a byte budget so one chatty client can't hold up the loop
+    int budget = _telnetLoopByteBudget;
+    for (byte n=0; n < _clientCount && budget > 0; n++)
+    {
+        byte i = (_nextClientToService + n) % _clientCount;
+        if (_clients[i] && _clients[i].available())
+            budget -= handleClientComms(i, budget);
+    }
+    _nextClientToService = (_nextClientToService + 1) % _clientCount;
+
+}
+
+void resetConnection(byte clientIndex)
+{
+    _connections[clientIndex].idx = 0;
+    _connections[clientIndex].inBinaryFrame = false;
+    _connections[clientIndex].binaryLength = 0;
+    _connections[clientIndex].eventCursor = _eventQueueNext; //only events from here on
+    _connections[clientIndex].eventsDropped = 0;
+}
+
+//read what this client has waiting, up to the budget, returns how many bytes were used
+int handleClientComms(byte clientIndex, int budget)
+{
+    static byte chunk[_telnetClientByteBudget];
+    EthernetClient &client = _clients[clientIndex];
+
+    int count = client.available();
+    if (count > _telnetClientByteBudget)
+        count = _telnetClientByteBudget;
+    if (count > budget)
+        count = budget;
+
+    //one bulk read is a single SPI transaction instead of one per byte
+    count = client.read(chunk, count);
+    if (count <= 0)
+        return 0;
+
+    for (int i=0; i < count; i++)
+        handleClientByte(client, _connections[clientIndex], chunk[i]);
+
+    return count;
+}
+
+void handleClientByte(EthernetClient &client, TelnetConnection &conn, char thisChar)
+{
+    if (conn.inBinaryFrame)
+    {
+        if (conn.binaryLength == 0)
+        {
+            conn.binaryLength = (byte)thisChar;
+            if (conn.binaryLength < 2 || conn.binaryLength >= _numChars) //needs a sequence and must fit with its crc
+                conn.inBinaryFrame = false;
+            return;
         }
-        //if there was no slot open, take the first one
-        if (!foundSlot)
+
+        conn.incomingCommand[conn.idx] = thisChar;
+        conn.idx++;
+        if (conn.idx > conn.binaryLength) //body and crc are in
         {
-            _clients[0].flush();
-            _clients[0].stop();
-            _clients[0] = client;
-            client.flush();
+            handleBinaryFrame(client, (byte*)conn.incomingCommand, conn.binaryLength);
+            conn.inBinaryFrame = false;
+            conn.idx = 0;
         }
+        return;
     }
 
-    //check for new data from everyone
-    for (byte i=0; i < _clientCount; i++)
+    if (conn.idx == 0 && (byte)thisChar == BIN_FRAME_START)
     {
-        //read all data in buffer
-        while(_clients[i] && _clients[i].available())
-        {
-            //handle next byte of data
-            handleClientComms(_clients[i]);
-        }
+        conn.inBinaryFrame = true;
+        conn.binaryLength = 0;
+        return;
     }
 
-}
-
-void handleClientComms(EthernetClient &client)
-{
-    static byte idx = 0; //index for socket cursor, if multi connection this will b0rk?
-    // read the bytes incoming from the client:
-    char thisChar = client.read();
     if (thisChar == _commandDelimiter)
     {
 
-        _incomingCommand[idx] = '\0'; //terminate string
-        handleTelnetCommand(client);
-        idx = 0;
+        conn.incomingCommand[conn.idx] = '\0'; //terminate string
+        conn.idx = 0;
+        handleTelnetCommand(client, conn.incomingCommand);
     } else {
         if (thisChar != '\r') //ignore CR
         {
             //save our byte
-            _incomingCommand[idx] = thisChar;
-            idx++;
+            conn.incomingCommand[conn.idx] = thisChar;
+            conn.idx++;
             //prevent overlfow and reset to our last byte
-            if (idx >= _numChars) {
-                idx = _numChars - 1;
+            if (conn.idx >= _numChars) {
+                conn.idx = _numChars - 1;
             }
         }
     }
@@ -1631,7 +1601,7 @@ void handleClientComms(EthernetClient &client)
  */
 
 
-void handleTelnetCommand(EthernetClient &client)
+void handleTelnetCommand(EthernetClient &client, char incomingData[])
 {
     static char outputData[100];
     static char sequence[10]= {0}; //holds the command
@@ -1656,8 +1626,8 @@ void handleTelnetCommand(EthernetClient &client)
     memset(argument6, 0, sizeof(argument6));
     */
 
-    //simplistic approach
-    sscanf(_incomingCommand, "%s %s %s %s %s %s %s %s", sequence, command, argument, argument2, argument3, argument4, argument5, argument6);
+    //simplistic approach, arguments keep old values when not sent so check the count
+    int fieldCount = sscanf(incomingData, "%s %s %s %s %s %s %s %s", sequence, command, argument, argument2, argument3, argument4, argument5, argument6);
 
 
     /*
@@ -1684,7 +1654,32 @@ void handleTelnetCommand(EthernetClient &client)
 
     } else if (strcmp(command,"debug") == 0) { //some debug info
 
-        sprintf(outputData, "%i,%i,%i,%i,%i,%i,%i,%s", _currentState, _lastState, _halfTimespanRunWidth, _halfTimespanRunDepth, _wiggleTime, _failsafeMotorLimit, _homeLocation, _lastLedMessage);
+        sprintf(outputData, "%i,%i,%i,%i,%i,%i,%i,%u,%u,%u,%u", _currentState, _lastState, _halfTimespanRunWidth, _halfTimespanRunDepth, _wiggleTime, _failsafeMotorLimit, _homeLocation, _ledLink.getDropped(), _ledLink.getFailed(), _plinkoLink.getDropped(), _plinkoLink.getFailed());
+        sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
+
+    } else if (strcmp(command,"perf") == 0) { //loop timing: "perf on|off" to run the profiler, "perf" for the whole loop, "perf n" for stage n
+
+        if (strcmp(argument,"on") == 0 || strcmp(argument,"off") == 0)
+        {
+            _profiler.setEnabled(strcmp(argument,"on") == 0);
+            sprintf(outputData, "%i", _profiler.isEnabled());
+        }
+        else
+        {
+            byte stage = fieldCount > 2 ? atoi(argument) : _profiler.getStageCount();
+            if (!_profiler.format(stage, outputData, 100))
+                sprintf(outputData, "%i", _profiler.getStageCount());
+        }
+        sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
+
+    } else if (strcmp(command,"perfreset") == 0) { //clear loop timing stats
+
+        _profiler.reset();
+        sendFormattedResponse(client, EVENT_INFO, sequence, "");
+
+    } else if (strcmp(command,"eq") == 0) { //event queue counters, coalesced then dropped per client slot
+
+        sprintf(outputData, "%u,%u,%u,%u,%u", _eventsCoalesced, _connections[0].eventsDropped, _connections[1].eventsDropped, _connections[2].eventsDropped, _connections[3].eventsDropped);
         sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
 
     } else if (strcmp(command,"state") == 0) { //set machine state manually
@@ -1803,18 +1798,7 @@ void handleTelnetCommand(EthernetClient &client)
     } else if (strcmp(command,"s") == 0) { //stop movement
 
         sendFormattedResponse(client, EVENT_INFO, sequence, "");
-
-        //don't do anything if we're not in a mode to accept input
-        if (_currentState != STATE_RUNNING)
-            return;
-
-
-        stopMotorLeft();
-        stopMotorRight();
-        stopMotorForward();
-        stopMotorBackward();
-        stopMotorUp();
-        stopMotorDown();
+        stopFromRemote();
 
     } else if (strcmp(command,"u") == 0) { //move claw up
 
@@ -1909,37 +1893,37 @@ void handleTelnetCommand(EthernetClient &client)
         {
             case CLAW_BACKWARD:
 
-                if (isLimitBackward())
+                if (isAxisLimit(AXIS_BACKWARD))
                     isLimit = 1;
                 break;
 
             case CLAW_FORWARD:
 
-                if (isLimitForward())
+                if (isAxisLimit(AXIS_FORWARD))
                     isLimit = 1;
                 break;
 
             case CLAW_LEFT:
 
-                if (isLimitLeft())
+                if (isAxisLimit(AXIS_LEFT))
                     isLimit = 1;
                 break;
 
             case CLAW_RIGHT:
 
-                if (isLimitRight())
+                if (isAxisLimit(AXIS_RIGHT))
                     isLimit = 1;
                 break;
 
             case CLAW_DROP:
 
-                if (isLimitDown())
+                if (isAxisLimit(AXIS_DOWN))
                     isLimit = 1;
                 break;
 
             case CLAW_RECOIL:
 
-                if (isLimitUp())
+                if (isAxisLimit(AXIS_UP))
                     isLimit = 1;
                 break;
 
@@ -1989,13 +1973,53 @@ void handleTelnetCommand(EthernetClient &client)
 
         _runToCenterDurationWidth = atoi(argument);
         _runToCenterDurationDepth = atoi(argument2);
+        saveCalibration();
         sprintf(outputData, "%i %i", _runToCenterDurationWidth, _runToCenterDurationDepth);
         sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
 
+    } else if (strcmp(command,"goto") == 0) { //drive the gantry to x y, thousandths of the width and depth, reply 1 started, 0 refused, -1 busy with a sequence so retry
+
+        sprintf(outputData, "%i", gotoPosition(atoi(argument), atoi(argument2)));
+        sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
+
+    } else if (strcmp(command,"pos") == 0) { //where dead reckoning puts the gantry: x,y,xKnown,yKnown
+
+        sprintf(outputData, "%i,%i,%i,%i", getPosition(POS_X), getPosition(POS_Y), _positions[POS_X].known, _positions[POS_Y].known);
+        sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
+
+    } else if (strcmp(command,"pcal") == 0) { //speed of a direction as a percent of the homing direction: pcal 0-3 percent
+
+        byte axis = atoi(argument);
+        int speed = atoi(argument2);
+        for (byte p=0; p < POS_COUNT && speed > 0; p++)
+        {
+            if (_positions[p].lowAxis == axis)
+                _positions[p].lowSpeed = speed;
+            else if (_positions[p].highAxis == axis)
+                _positions[p].highSpeed = speed;
+        }
+        saveCalibration();
+        sprintf(outputData, "%i,%i,%i,%i", _positions[POS_X].lowSpeed, _positions[POS_X].highSpeed, _positions[POS_Y].lowSpeed, _positions[POS_Y].highSpeed);
+        sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
+
+    } else if (strcmp(command,"cal") == 0) { //stored calibration: "cal warm 0|1" boot from it or not, "cal clear" forget it, reply valid,seq,warm,width,depth
+
+        if (strcmp(argument,"warm") == 0)
+        {
+            _warmBoot = atoi(argument2) == 1;
+            saveCalibration();
+        }
+        else if (strcmp(argument,"clear") == 0)
+            _calibration.erase();
+
+        sprintf(outputData, "%i,%u,%i,%i,%i", _calibration.isValid(), _calibration.getSequence(), _warmBoot, _timespanRunWidth, _timespanRunDepth);
+        sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
+
     } else if (strcmp(command,"creset") == 0) { //reset custom centering
 
         _runToCenterDurationWidth = _halfTimespanRunWidth;
         _runToCenterDurationDepth = _halfTimespanRunDepth;
+        saveCalibration();
 
         sprintf(outputData, "%i %i", _runToCenterDurationWidth, _runToCenterDurationDepth);
         sendFormattedResponse(client, EVENT_INFO, sequence, outputData);
@@ -2019,14 +2043,14 @@ void handleTelnetCommand(EthernetClient &client)
     } else if (strcmp(command,"strobe") == 0) { //strobe the lights
 
         sendFormattedResponse(client, EVENT_INFO, sequence, "");
-        sprintf(_lastLedMessage, "s %s %s %s %s %s %s", argument, argument2, argument3, argument4, argument5, argument6);
-        sendLedControllerMessage(_lastLedMessage);
+        sprintf(outputData, "s %s %s %s %s %s %s", argument, argument2, argument3, argument4, argument5, argument6);
+        sendLedControllerMessage(outputData);
 
     } else if (strcmp(command,"uno") == 0) { //send generic commands to uno
 
         sendFormattedResponse(client, EVENT_INFO, sequence, "");
-        sprintf(_lastLedMessage, "%s %s %s %s %s %s", argument, argument2, argument3, argument4, argument5, argument6);
-        sendLedControllerMessage(_lastLedMessage);
+        sprintf(outputData, "%s %s %s %s %s %s", argument, argument2, argument3, argument4, argument5, argument6);
+        sendLedControllerMessage(outputData);
     } else if (strcmp(command,"p") == 0)
     {
         int power = atoi(argument);
@@ -2061,6 +2085,131 @@ void sendFormattedResponse(EthernetClient &client, int event, char sequence[], c
     client.println(response);
 }
 
+/**
+ *
+ *
+ *
+ * BINARY NETWORK COMMANDS
+ *
+ *
+ *
+ */
+
+byte crc8(byte data[], byte length, byte crc)
+{
+    for (byte i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (byte bit = 0; bit < 8; bit++)
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : (crc << 1);
+    }
+    return crc;
+}
+
+/**
+ * Handle a binary frame, frame holds sequence, commands and the trailing crc; length excludes the crc
+ * Every command is checked before any run so a bad frame never half executes
+ */
+void handleBinaryFrame(EthernetClient &client, byte frame[], byte length)
+{
+    unsigned int sequence = ((unsigned int)frame[0] << 8) | frame[1];
+
+    byte crc = crc8(&length, 1, 0);
+    crc = crc8(frame, length, crc);
+    if (crc != frame[length])
+    {
+        sendBinaryAck(client, sequence, BIN_ACK_BAD_CRC, 0);
+        return;
+    }
+
+    byte count = 0;
+    byte pos = 2;
+    while (pos < length)
+    {
+        byte opcode = frame[pos];
+        if (opcode >= _binaryCommandCount || pos + 1 + _binaryCommands[opcode].argCount * 2 > length)
+        {
+            sendBinaryAck(client, sequence, BIN_ACK_BAD_COMMAND, 0);
+            return;
+        }
+        pos += 1 + _binaryCommands[opcode].argCount * 2;
+        count++;
+    }
+
+    //ack before running, events caused by the commands have to come after it
+    sendBinaryAck(client, sequence, BIN_ACK_OK, count);
+
+    int args[BIN_MAX_ARGS];
+    pos = 2;
+    while (pos < length)
+    {
+        const BinaryCommand &cmd = _binaryCommands[frame[pos]];
+        pos++;
+        for (byte i = 0; i < cmd.argCount; i++)
+        {
+            args[i] = (int)(((unsigned int)frame[pos] << 8) | frame[pos + 1]);
+            pos += 2;
+        }
+        cmd.handler(args);
+    }
+}
+
+void sendBinaryAck(EthernetClient &client, unsigned int sequence, byte status, byte count)
+{
+    byte ack[7];
+    ack[0] = BIN_FRAME_START;
+    ack[1] = 4;
+    ack[2] = sequence >> 8;
+    ack[3] = sequence & 0xFF;
+    ack[4] = status;
+    ack[5] = count;
+    ack[6] = crc8(&ack[1], 5, 0);
+    client.write(ack, sizeof(ack)); //one write per ack keeps the W5100 traffic down
+}
+
+void binaryPing(int args[])
+{
+    //nothing to do, the ack answers it
+}
+
+void binaryMove(int args[])
+{
+    moveFromRemote((byte)args[0], args[1]);
+}
+
+void binaryStop(int args[])
+{
+    stopFromRemote();
+}
+
+void binaryClaw(int args[])
+{
+    if (args[0] == 1)
+        closeClaw();
+    else
+        openClaw();
+}
+
+void binaryBelt(int args[])
+{
+    moveConveyorBelt(args[0]);
+}
+
+void binaryBelt2(int args[])
+{
+    moveConveyorBelt2(args[0]);
+}
+
+void binaryFlip(int args[])
+{
+    moveFlipper((byte)args[0]);
+}
+
+void binaryLight(int args[])
+{
+    digitalWrite(_PINLightsWhite, args[0] == 1 ? RELAYPINON : RELAYPINOFF);
+}
+
 /**
  * Run the conveyor belt for the passed number of milliseconds
  * 0 = stop
@@ -2098,6 +2247,19 @@ void moveConveyorBelt2(int runTime)
 }
 
 
+//stop every axis, ignored unless a player is in control
+void stopFromRemote()
+{
+    //don't do anything if we're not in a mode to accept input
+    if (_currentState != STATE_RUNNING)
+        return;
+
+    for (byte i=0; i < AXIS_COUNT; i++)
+        stopAxis(i);
+    cancelGoto();
+    _deferredMoveCount = 0; //moves sent before the stop don't run after it
+}
+
 /**
  * @brief  Move the motor a direction for a specified duration
  * @note
@@ -2111,6 +2273,19 @@ void moveFromRemote(byte direction, int duration)
     if (_currentState != STATE_RUNNING)
         return;
 
+    //a sequence step is pending, hold the move until it's done
+    if (isTaskPending())
+    {
+        if (_deferredMoveCount < _deferredMoveSize)
+        {
+            DeferredMove &move = _deferredMoves[(_deferredMoveHead + _deferredMoveCount) % _deferredMoveSize];
+            move.direction = direction;
+            move.duration = duration;
+            _deferredMoveCount++;
+        }
+        return;
+    }
+
     //Handle dropping first
     switch (direction)
     {
@@ -2123,26 +2298,13 @@ void moveFromRemote(byte direction, int duration)
                 dropClawProcedure();
             }
             else if (_gameMode == GAMEMODE_TARGET && _isClawClosed)
-            {
-                openClaw();
-                delay(500);
-
-                if (_doWiggle)
-                    wiggleClaw();
-
-                delay(500);
-                returnToWinChute();
-            }
+                releaseAndReturn(500);
             break;
         case CLAW_DOWN:
-            _clawRemoteMoveDurationDown = duration;
-            _clawRemoteMoveStartTimeDown = millis();
-            runMotorDown(false);
+            moveAxisFromRemote(AXIS_DOWN, duration);
             break;
         case CLAW_UP:
-            _clawRemoteMoveDurationUp = duration;
-            _clawRemoteMoveStartTimeUp = millis();
-            runMotorUp(false);
+            moveAxisFromRemote(AXIS_UP, duration);
             break;
     }
 
@@ -2153,24 +2315,16 @@ void moveFromRemote(byte direction, int duration)
     switch (direction)
     {
         case CLAW_FORWARD:
-            _clawRemoteMoveDurationForward = duration;
-            _clawRemoteMoveStartTimeForward = millis();
-            runMotorForward(false);
+            moveAxisFromRemote(AXIS_FORWARD, duration);
             break;
         case CLAW_BACKWARD:
-            _clawRemoteMoveDurationBackward = duration;
-            _clawRemoteMoveStartTimeBackward = millis();
-            runMotorBackward(false);
+            moveAxisFromRemote(AXIS_BACKWARD, duration);
             break;
         case CLAW_LEFT:
-            _clawRemoteMoveDurationLeft = duration;
-            _clawRemoteMoveStartTimeLeft = millis();
-            runMotorLeft(false);
+            moveAxisFromRemote(AXIS_LEFT, duration);
             break;
         case CLAW_RIGHT:
-            _clawRemoteMoveDurationRight = duration;
-            _clawRemoteMoveStartTimeRight = millis();
-            runMotorRight(false);
+            moveAxisFromRemote(AXIS_RIGHT, duration);
             break;
     }
 }
@@ -2182,148 +2336,331 @@ void moveFromRemote(byte direction, int duration)
  */
 
 
-bool isLimitLeft()
+//remember which register and bit a pin lives on, returns its index in _inputSnapshot
+byte registerInput(byte pin, byte &mask)
 {
-    return digitalRead(_PINLimitLeft)==LIMITON;
+    volatile uint8_t *port = portInputRegister(digitalPinToPort(pin));
+    mask = digitalPinToBitMask(pin);
+
+    for (byte i=0; i < _inputPortCount; i++)
+    {
+        if (_inputPorts[i] == port)
+            return i;
+    }
+
+    if (_inputPortCount >= _maxInputPorts) //out of room, fall back to sharing the last slot
+        return _maxInputPorts - 1;
+
+    _inputPorts[_inputPortCount] = port;
+    return _inputPortCount++;
 }
 
-bool isLimitRight()
+//read every registered input port once
+void sampleInputs()
 {
-    return digitalRead(_PINLimitRight)==LIMITON;
+    for (byte i=0; i < _inputPortCount; i++)
+        _inputSnapshot[i] = *_inputPorts[i];
 }
 
-bool isLimitForward()
+bool isAxisLimit(byte axisIndex)
 {
-    return digitalRead(_PINLimitForward)==LIMITON;
+    Axis &axis = _axes[axisIndex];
+    bool high = _inputSnapshot[axis.limitPort] & axis.limitMask;
+    return high == (axis.limitLevel == HIGH);
 }
 
-bool isLimitBackward()
+//at the limit and done settling, checkLimits() has stopped it and sent the limit event unless the recoil override kept it running
+bool isAxisSettled(byte axisIndex)
 {
-    return digitalRead(_PINLimitBackward)==LIMITON;
+    Axis &axis = _axes[axisIndex];
+    if (!isAxisLimit(axisIndex))
+        return false;
+    if (!axis.running)
+        return true;
+    return axis.timestampLimit && (!axis.settles || millis() - axis.timestampLimit >= (unsigned long)_limitSettleTime);
 }
 
-bool isLimitDown()
+void runAxis(byte axisIndex, bool override)
 {
-    return digitalRead(_PINLimitDown)==LIMITOFF;
+    Axis &axis = _axes[axisIndex];
+    stopAxis(axis.opposite);
+    if (!isAxisLimit(axisIndex) || override)
+    {
+        if (!axis.running)
+            integratePositions(); //start counting this axis from now, not the last update
+        axis.running = true;
+        axis.timestampMove = millis();
+        digitalWrite(axis.motorPin, RELAYPINON);
+    }
 }
 
-bool isLimitUp()
+void stopAxis(byte axisIndex)
 {
-    return digitalRead(_PINLimitUp)==LIMITON;
+    if (_axes[axisIndex].running)
+        integratePositions(); //count up to now before it stops
+    _axes[axisIndex].running = false;
+    digitalWrite(_axes[axisIndex].motorPin, RELAYPINOFF);
 }
 
-void runMotorLeft(bool override)
+/**
+ * @brief  Start every axis in mask toward its limit at once, checkAxesAtLimits() stops each as it arrives
+ * @retval false if they were all at their limits already
+ */
+bool runAxesToLimits(byte mask)
 {
-    stopMotorRight();
-    if (!isLimitLeft() || override)
+    _pendingAxes = 0;
+    _timestampAxesStart = millis();
+    for (byte i=0; i < AXIS_COUNT; i++)
     {
-        _isMotorRunningLeft = true;
-        _timestampMotorMoveLeft = millis();
-        digitalWrite(_PINMoveLeft, RELAYPINON);
+        if (!(mask & (1 << i)))
+            continue;
+
+        _axes[i].timespanToLimit = 0;
+        if (isAxisLimit(i))
+            continue;
+
+        _pendingAxes |= 1 << i;
+        runAxis(i, false);
     }
+    return _pendingAxes;
 }
 
-void runMotorRight(bool override)
+/**
+ * @brief  Stop each pending axis that reached its limit and note how long it took
+ * @retval true once every axis from runAxesToLimits() is there
+ */
+bool checkAxesAtLimits()
 {
-    stopMotorLeft();
-    if (!isLimitRight() || override)
+    for (byte i=0; i < AXIS_COUNT; i++)
     {
-        _isMotorRunningRight = true;
-        _timestampMotorMoveRight = millis();
-        digitalWrite(_PINMoveRight, RELAYPINON);
+        if (!(_pendingAxes & (1 << i)))
+            continue;
+
+        if (isAxisLimit(i))
+        {
+            stopAxis(i);
+            _axes[i].timespanToLimit = millis() - _timestampAxesStart;
+            _pendingAxes &= ~(1 << i);
+            debugString("A L ");
+            debugLine((char*)_axes[i].name);
+        }
+        else if (!_axes[i].running) //a scenario where the motor was stopped but it's not at the limit
+        {
+            runAxis(i, false);
+        }
     }
+    return !_pendingAxes;
 }
 
-void runMotorForward(bool override)
+void stopPendingAxes()
 {
-    stopMotorBackward();
-    if (!isLimitForward() || override)
+    for (byte i=0; i < AXIS_COUNT; i++)
     {
-        _isMotorRunningForward = true;
-        _timestampMotorMoveForward = millis();
-        digitalWrite(_PINMoveForward, RELAYPINON);
+        if (_pendingAxes & (1 << i))
+            stopAxis(i);
     }
+    _pendingAxes = 0;
 }
 
-void runMotorBackward(bool override)
+//travel between the limits in position units, 0 until homing has timed it
+long getPositionSpan(byte p)
 {
-    stopMotorForward();
-    if (!isLimitBackward() || override)
-    {
-        _isMotorRunningBackward = true;
-        _timestampMotorMoveBackward = millis();
-        digitalWrite(_PINMoveBackward, RELAYPINON);
-    }
+    return (long)(p == POS_X ? _timespanRunWidth : _timespanRunDepth) * 100;
+}
+
+//position in thousandths of the span, -1 if it isn't known
+int getPosition(byte p)
+{
+    long span = getPositionSpan(p);
+    if (!_positions[p].known || !span)
+        return -1;
+
+    if (span < POS_SCALE) //under a thousandth of a unit per step, scale up instead
+        return _positions[p].position * POS_SCALE / span;
+    return _positions[p].position / (span / POS_SCALE);
 }
 
-void runMotorDown(bool override)
+//add the motor on-time since the last call to each position, runAxis() and stopAxis() call it so only time actually spent moving counts
+void integratePositions()
 {
-    stopMotorUp();
-    if (!isLimitDown() || override)
+    unsigned long curTime = millis();
+    long elapsed = curTime - _timestampPositionUpdate;
+    _timestampPositionUpdate = curTime;
+
+    for (byte p=0; p < POS_COUNT; p++)
     {
-        _isMotorRunningDown = true;
-        _timestampMotorMoveDown = millis();
-        digitalWrite(_PINMoveDown, RELAYPINON);
+        GantryPosition &pos = _positions[p];
+        if (_axes[pos.lowAxis].running)
+            pos.position -= elapsed * pos.lowSpeed;
+        if (_axes[pos.highAxis].running)
+            pos.position += elapsed * pos.highSpeed;
     }
 }
 
-void runMotorUp(bool override)
+/**
+ * @brief  Integrate motor on-time into each position and stop goto moves that got there, call every loop
+ * @note   A limit switch is the truth, the position snaps to it whenever one is made
+ */
+void updatePositions()
 {
-    stopMotorDown();
-    if (!isLimitUp() || override)
+    integratePositions();
+
+    for (byte p=0; p < POS_COUNT; p++)
+    {
+        GantryPosition &pos = _positions[p];
+        long span = getPositionSpan(p);
+        bool runningLow = _axes[pos.lowAxis].running;
+        bool runningHigh = _axes[pos.highAxis].running;
+
+        if (isAxisLimit(pos.lowAxis))
+        {
+            pos.position = 0;
+            pos.known = true;
+        }
+        else if (span && isAxisLimit(pos.highAxis))
+        {
+            pos.position = span;
+            pos.known = true;
+        }
+        else if (pos.position < 0)
+            pos.position = 0;
+        else if (span && pos.position > span)
+            pos.position = span;
+
+        if (pos.target < 0)
+            continue;
+
+        if (_currentState != STATE_RUNNING) //a sequence took over the motors
+        {
+            pos.target = -1;
+            continue;
+        }
+
+        //stopped by a limit before getting there counts as there
+        if ((runningHigh && pos.position >= pos.target) || (runningLow && pos.position <= pos.target) || (!runningHigh && !runningLow))
+        {
+            stopAxis(pos.lowAxis);
+            stopAxis(pos.highAxis);
+            pos.target = -1;
+        }
+    }
+
+    if (_gotoActive && _positions[POS_X].target < 0 && _positions[POS_Y].target < 0)
     {
-        _isMotorRunningUp = true;
-        _timestampMotorMoveUp = millis();
-        digitalWrite(_PINMoveUp, RELAYPINON);
+        _gotoActive = false;
+        if (_currentState == STATE_RUNNING)
+            sendEvent(EVENT_POSITION_REACHED);
     }
 }
 
-void stopMotorLeft()
+/**
+ * @brief  Drive both horizontal axes toward x y at once, EVENT_POSITION_REACHED when they're there
+ * @note   x and y are thousandths of the width and depth from the left and front limits
+ * @retval 1 started, 0 if we aren't taking moves or haven't homed yet, -1 if a sequence step is pending so try again
+ */
+int gotoPosition(int x, int y)
 {
-    if (!_isMotorRunningLeft) //avoid useless writes
-        return;
+    if (_currentState != STATE_RUNNING)
+        return 0;
+
+    if (isTaskPending())
+        return -1;
+
+    if (_gameMode == GAMEMODE_TARGET && !_isClawClosed && !_allowTargetingMoves)
+        return 0;
+
+    for (byte p=0; p < POS_COUNT; p++)
+    {
+        if (!_positions[p].known || !getPositionSpan(p))
+            return 0;
+    }
+
+    int targets[POS_COUNT] = { x, y };
+    for (byte p=0; p < POS_COUNT; p++)
+    {
+        GantryPosition &pos = _positions[p];
+        long span = getPositionSpan(p);
+        long scaled = constrain(targets[p], 0, POS_SCALE);
+        pos.target = span < POS_SCALE ? span * scaled / POS_SCALE : span / POS_SCALE * scaled;
 
-    _isMotorRunningLeft = false;
-    digitalWrite(_PINMoveLeft, RELAYPINOFF);
+        //goto replaces any timed move on these axes
+        _axes[pos.lowAxis].remoteStartTime = 0;
+        _axes[pos.highAxis].remoteStartTime = 0;
+        stopAxis(pos.lowAxis);
+        stopAxis(pos.highAxis);
+
+        if (pos.target > pos.position)
+            runAxis(pos.highAxis, false);
+        else if (pos.target < pos.position)
+            runAxis(pos.lowAxis, false);
+    }
+    _gotoActive = true;
+    return 1;
 }
 
-void stopMotorRight()
+void cancelGoto()
 {
-    if (!_isMotorRunningRight) //avoid useless writes
-        return;
-
-    _isMotorRunningRight = false;
-    digitalWrite(_PINMoveRight, RELAYPINOFF);
+    _positions[POS_X].target = -1;
+    _positions[POS_Y].target = -1;
+    _gotoActive = false;
 }
 
-void stopMotorForward()
+/**
+ * @brief  Restore travel times, centering and position speeds from EEPROM
+ * @retval false if there's no good record, nothing is changed
+ */
+bool loadCalibration()
 {
-    if (!_isMotorRunningForward) //avoid useless writes
-        return;
+    ClawCalibration cal;
+    if (!_calibration.load(&cal) || cal.timespanRunWidth <= 0 || cal.timespanRunDepth <= 0)
+        return false;
 
-    _isMotorRunningForward = false;
-    digitalWrite(_PINMoveForward, RELAYPINOFF);
+    _timespanRunWidth = cal.timespanRunWidth;
+    _timespanRunDepth = cal.timespanRunDepth;
+    _halfTimespanRunWidth = _timespanRunWidth / 2;
+    _halfTimespanRunDepth = _timespanRunDepth / 2;
+    _runToCenterDurationWidth = cal.runToCenterDurationWidth;
+    _runToCenterDurationDepth = cal.runToCenterDurationDepth;
+    for (byte p=0; p < POS_COUNT; p++)
+    {
+        _positions[p].lowSpeed = cal.positionSpeeds[p][0];
+        _positions[p].highSpeed = cal.positionSpeeds[p][1];
+    }
+    _warmBoot = cal.warmBoot;
+    return true;
 }
 
-void stopMotorBackward()
+//write the current calibration, the store skips it if nothing changed
+void saveCalibration()
 {
-    if (!_isMotorRunningBackward) //avoid useless writes
+    if (_timespanRunWidth <= 0 || _timespanRunDepth <= 0) //never homed, nothing worth keeping
         return;
 
-    _isMotorRunningBackward = false;
-    digitalWrite(_PINMoveBackward, RELAYPINOFF);
+    ClawCalibration cal;
+    cal.timespanRunWidth = _timespanRunWidth;
+    cal.timespanRunDepth = _timespanRunDepth;
+    cal.runToCenterDurationWidth = _runToCenterDurationWidth;
+    cal.runToCenterDurationDepth = _runToCenterDurationDepth;
+    for (byte p=0; p < POS_COUNT; p++)
+    {
+        cal.positionSpeeds[p][0] = _positions[p].lowSpeed;
+        cal.positionSpeeds[p][1] = _positions[p].highSpeed;
+    }
+    cal.warmBoot = _warmBoot;
+    _calibration.save(&cal);
 }
 
-void stopMotorDown()
+void moveAxisFromRemote(byte axisIndex, int duration)
 {
-    _isMotorRunningDown = false;
-    digitalWrite(_PINMoveDown, RELAYPINOFF);
-}
+    for (byte p=0; p < POS_COUNT; p++) //a nudge takes the axis back from goto
+    {
+        if (_positions[p].lowAxis == axisIndex || _positions[p].highAxis == axisIndex)
+            _positions[p].target = -1;
+    }
 
-void stopMotorUp()
-{
-    _isMotorRunningUp = false;
-    digitalWrite(_PINMoveUp, RELAYPINOFF);
+    _axes[axisIndex].remoteDuration = duration;
+    _axes[axisIndex].remoteStartTime = millis();
+    runAxis(axisIndex, false);
 }
 
 void debugLine(char message[])
@@ -2379,33 +2716,117 @@ void changeState(int newState)
 
     _lastState = _currentState;
     _currentState = newState;
+
+    if (newState == STATE_FAILSAFE) //whatever sequence was running is over
+        clearTasks();
+}
+/**
+ * @brief  Queue the next timed step of a sequence
+ * @note   The first step waits from now, every later one waits from the step before it
+ * @retval false if the queue is full
+ */
+bool addTask(void (*action)(), unsigned int wait)
+{
+    if (_taskQueueCount >= _taskQueueSize)
+        return false;
+
+    if (_taskQueueCount == 0)
+        _timestampLastTask = millis();
+
+    ScheduledTask &task = _taskQueue[(_taskQueueHead + _taskQueueCount) % _taskQueueSize];
+    task.action = action;
+    task.wait = wait;
+    _taskQueueCount++;
+    return true;
+}
+
+bool isTaskPending()
+{
+    return _taskQueueCount > 0;
+}
+
+//replay moves held by moveFromRemote() once no step is pending, a drop queues steps again and holds the rest
+void runDeferredMoves()
+{
+    while (_deferredMoveCount && !isTaskPending())
+    {
+        DeferredMove move = _deferredMoves[_deferredMoveHead];
+        _deferredMoveHead = (_deferredMoveHead + 1) % _deferredMoveSize;
+        _deferredMoveCount--;
+        moveFromRemote(move.direction, move.duration);
+    }
+}
+
+void clearTasks()
+{
+    _taskQueueCount = 0;
+}
+
+//run every step that is due, a step can queue more steps
+void runTasks()
+{
+    while (_taskQueueCount && millis() - _timestampLastTask >= _taskQueue[_taskQueueHead].wait)
+    {
+        void (*action)() = _taskQueue[_taskQueueHead].action;
+        _taskQueueHead = (_taskQueueHead + 1) % _taskQueueSize;
+        _taskQueueCount--;
+        _timestampLastTask = millis();
+        action();
+    }
+}
+
+/**
+ * @brief  Target mode, let go of the prize and head back to the win chute
+ * @note   pause is how long to wait before and after the wiggle
+ * @retval None
+ */
+void releaseAndReturn(unsigned int pause)
+{
+    openClaw();
+    if (_doWiggle)
+    {
+        wiggleClaw(pause);
+        addTask(returnToWinChute, pause);
+    }
+    else
+        addTask(returnToWinChute, pause * 2);
 }
+
 /**
  * @brief  Wiggle the claw
- * @note
+ * @note   Queued as timed steps, starts after wait
  * @retval None
  */
-void wiggleClaw()
+void wiggleClaw(unsigned int wait)
+{
+    addTask(wiggleRight, wait);
+    addTask(wiggleLeft, _wiggleTime);
+    addTask(wiggleRight, _wiggleTime);
+    addTask(wiggleLeft, _wiggleTime);
+    addTask(wiggleStop, _wiggleTime);
+}
+
+void wiggleRight()
 {
-    runMotorRight(false);
-    delay(_wiggleTime);
-    runMotorLeft(false);
-    delay(_wiggleTime);
-    runMotorRight(false);
-    delay(_wiggleTime);
-    runMotorLeft(false);
-    delay(_wiggleTime);
-    stopMotorLeft();
+    runAxis(AXIS_RIGHT, false);
+}
+
+void wiggleLeft()
+{
+    runAxis(AXIS_LEFT, false);
+}
+
+void wiggleStop()
+{
+    stopAxis(AXIS_LEFT);
 }
 
 void clapClaw(int times)
 {
-    for(int i = 0; i < times; i++)
+    for(int i = 0; i < times && _taskQueueSize - _taskQueueCount >= 2; i++)
     {
-        closeClaw();
-        delay(_wiggleTime);
-        openClaw();
-        delay(_wiggleTime);
+        addTask(closeClaw, i ? _wiggleTime : 0);
+        addTask(openClaw, _wiggleTime);
     }
 }
 
@@ -0,0 +1,101 @@
+#include "LoopProfiler.h"
+
+LoopProfiler::LoopProfiler(const char *const stageNames[], byte stageCount)
+{
+    _stageNames = stageNames;
+    _stageCount = stageCount > PROFILER_MAX_STAGES ? PROFILER_MAX_STAGES : stageCount;
+    _enabled = false;
+    _loopStart = 0;
+    _lastMark = 0;
+    reset();
+}
+
+void LoopProfiler::setEnabled(bool enabled)
+{
+    _enabled = enabled;
+}
+
+bool LoopProfiler::isEnabled()
+{
+    return _enabled;
+}
+
+byte LoopProfiler::getStageCount()
+{
+    return _stageCount;
+}
+
+void LoopProfiler::reset()
+{
+    for (byte i = 0; i <= PROFILER_MAX_STAGES; i++)
+    {
+        _stats[i].min = 0xFFFFFFFF;
+        _stats[i].max = 0;
+        _stats[i].total = 0;
+        _stats[i].count = 0;
+        for (byte b = 0; b < PROFILER_BUCKETS; b++)
+            _stats[i].buckets[b] = 0;
+    }
+}
+
+void LoopProfiler::beginLoop()
+{
+    if (!_enabled)
+        return;
+
+    _loopStart = micros();
+    _lastMark = _loopStart;
+}
+
+void LoopProfiler::mark(byte stage)
+{
+    if (!_enabled || stage >= _stageCount)
+        return;
+
+    unsigned long now = micros();
+    record(_stats[stage], now - _lastMark);
+    _lastMark = now;
+}
+
+void LoopProfiler::endLoop()
+{
+    if (!_enabled)
+        return;
+
+    record(_stats[PROFILER_MAX_STAGES], micros() - _loopStart);
+}
+
+void LoopProfiler::record(ProfilerStats &stats, unsigned long elapsed)
+{
+    if (elapsed < stats.min)
+        stats.min = elapsed;
+    if (elapsed > stats.max)
+        stats.max = elapsed;
+    stats.total += elapsed;
+    stats.count++;
+
+    //each bucket is 4x wider than the last, starting at 64us
+    byte bucket = 0;
+    unsigned long limit = 64;
+    while (bucket < PROFILER_BUCKETS - 1 && elapsed >= limit)
+    {
+        bucket++;
+        limit <<= 2;
+    }
+    if (stats.buckets[bucket] < 0xFFFF)
+        stats.buckets[bucket]++;
+}
+
+int LoopProfiler::format(byte stage, char output[], int size)
+{
+    if (stage > _stageCount)
+        return 0;
+
+    ProfilerStats &stats = stage == _stageCount ? _stats[PROFILER_MAX_STAGES] : _stats[stage];
+    const char *name = stage == _stageCount ? "loop" : _stageNames[stage];
+    unsigned long avg = stats.count ? stats.total / stats.count : 0;
+    unsigned long min = stats.count ? stats.min : 0;
+
+    return snprintf(output, size, "%s,%lu,%lu,%lu,%lu,%u,%u,%u,%u,%u,%u", name, stats.count, min, avg, stats.max,
+        stats.buckets[0], stats.buckets[1], stats.buckets[2], stats.buckets[3], stats.buckets[4], stats.buckets[5]);
+}
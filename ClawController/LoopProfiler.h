@@ -0,0 +1,49 @@
+#ifndef LoopProfiler_h
+#define LoopProfiler_h
+
+#include "Arduino.h"
+
+#define PROFILER_MAX_STAGES 10 //most stages one loop can be split into
+#define PROFILER_BUCKETS 6 //histogram buckets: <64us, <256us, <1ms, <4ms, <16ms, longer
+
+struct ProfilerStats
+{
+    unsigned long min; //shortest time seen, micros
+    unsigned long max; //longest time seen, micros
+    unsigned long total; //sum of every time seen, for the average
+    unsigned long count; //how many times were recorded
+    unsigned int buckets[PROFILER_BUCKETS]; //how many times landed in each range
+};
+
+/**
+ * Times each stage of loop() and the loop as a whole.
+ *
+ * Call beginLoop() at the top of loop(), mark(stage) after each stage and endLoop() at the bottom.
+ * Each mark records the time since the previous mark. Nothing is measured until it's enabled,
+ * disabled it costs one flag check per call.
+ */
+class LoopProfiler
+{
+  public:
+    LoopProfiler(const char *const stageNames[], byte stageCount);
+    void setEnabled(bool enabled);
+    bool isEnabled();
+    void beginLoop();
+    void mark(byte stage);
+    void endLoop();
+    void reset(); //clear all stats
+    byte getStageCount();
+    int format(byte stage, char output[], int size); //"name,count,min,avg,max,buckets...", stage == getStageCount() is the whole loop
+
+  private:
+    const char *const *_stageNames;
+    byte _stageCount;
+    bool _enabled;
+    unsigned long _loopStart;
+    unsigned long _lastMark;
+    ProfilerStats _stats[PROFILER_MAX_STAGES + 1]; //last entry is the whole loop
+
+    void record(ProfilerStats &stats, unsigned long elapsed);
+};
+
+#endif
@@ -1,3 +1,5 @@
+#include "SensorClassifier.h"
+
 HardwareSerial &clawController = Serial1;
 HardwareSerial &conveyorController = Serial2;
 HardwareSerial &wifiController = Serial3;
@@ -43,7 +45,7 @@ int _moveForwardAfterGrabTime = 1500;
 int _moveRightAfterGrabTime = 1500;
 
 //CONVEYOR BELT STUFF 
-unsigned long _timestampConveyorSensorTripped = 0; //what time the sensor last saw movement
+SensorClassifier<1> _conveyorSensor; //hold-off of _conveyorSensorTripDelay
 unsigned long _timestampConveyorBeltStart = 0; //when the conveyor belt started running
 int _conveyorSensorTripped = HIGH; //used to determine if trip is on a high or low
 int _failsafeBeltLimit = 30000; //limit for running conveyor belt
@@ -140,6 +142,7 @@ void initConveyor()
     conveyorController.begin(19200); //talk to motor controller
 
     pinMode(_PINConveyorSensor, INPUT_PULLUP);
+    _conveyorSensor.setSensor(0, EVENT_CONVEYOR_TRIPPED, 0, _conveyorSensorTripDelay);
 }
 
 // read a serial byte (returns -1 if nothing received after the timeout expires)
@@ -180,17 +183,10 @@ void checkConveyorSensor()
     static unsigned long curTime = 0; //memory placeholder
 
     curTime = millis();
-    int sensorVal = digitalRead(_PINConveyorSensor);
-    if (sensorVal == _conveyorSensorTripped)
-    {
-        
-
-        if (curTime - _timestampConveyorSensorTripped > _conveyorSensorTripDelay)
-            sendEvent(EVENT_CONVEYOR_TRIPPED);
-
-        _timestampConveyorSensorTripped = curTime;
-    }
+    _conveyorSensor.sample(0, digitalRead(_PINConveyorSensor) == _conveyorSensorTripped, curTime);
 
+    while (_conveyorSensor.available())
+        sendEvent(_conveyorSensor.read());
 }
 
 
@@ -1,4 +1,6 @@
 #include "FastLED.h"
+#include "SerialLink.h"
+#include "LedPushCoordinator.h"
 
 FASTLED_USING_NAMESPACE
 
@@ -18,16 +20,19 @@ const int _PINButton = 3;
 const int _PINRelay = 53;
 
 const byte _numChars = 64;
-char _incomingCommand[_numChars]; // an array to store the received data
+SerialLink _serialLink(Serial); //framed link to the claw controller
+
+//patterns draw once a frame, the strip goes out when the link is quiet, see the leds command
+const byte _frameInterval = 1000 / FRAMES_PER_SECOND;
+unsigned long _timestampLastFrame = 0;
+LedPushCoordinator _ledPush(1, _frameInterval, 2, _frameInterval * 4);
 
 unsigned long checkTime = 0;
-const char RTS = '{'; //request to send data
-const char CS = '}'; //comeplete send data
-const char CTS = '!'; //clear to send data
 
 void setup() {
   delay(2000);
   Serial.begin(115200);
+  _serialLink.setReceiveHandler(handleCommand);
   pinMode(PSU_PIN, OUTPUT);
   analogWrite(PSU_PIN, 165);
   // tell FastLED about the LED strip configuration
@@ -47,18 +52,35 @@ uint8_t gCurrentPatternNumber = 0; // Index number of which pattern is current
 uint8_t gHue = 0; // rotating "base color" used by many of the patterns
 bool _lightsEnabled = true;
 
-char _lastLedMessage[40]; //led message
-unsigned long _waitForLedAckTimestamp = 0; //time we sent last led message
-byte _waitForLedAckCount = 0; //retry counter
+//strobe in progress, loop() moves it one flash at a time so commands are still read mid-strobe
+//a new strobe replaces the running one, patterns pick back up after the end pause
+const byte _maxStrobeColors = 2;
+struct Strobe
+{
+  bool active;
+  byte colors[_maxStrobeColors][3]; //flashed in turn, off between each
+  byte colorCount;
+  int stepCount; //every flash on and every flash off is a step
+  int step; //next step to show
+  int flashDelay;
+  int endPause; //dark after the last flash before patterns resume
+  unsigned long timestampStep;
+  unsigned long wait; //time until the next step
+};
+Strobe _strobe = { false };
 
 void loop()
 {
 
-  // Call the current pattern function once, updating the 'leds' array
-  if (_lightsEnabled)
+  // Call the current pattern function once a frame, updating the 'leds' array
+  if (_strobe.active)
+    runStrobe();
+  else if (_lightsEnabled && millis() - _timestampLastFrame >= _frameInterval)
+  {
+    _timestampLastFrame = millis();
     gPatterns[gCurrentPatternNumber]();
-
-
+    _ledPush.markDirty(0);
+  }
 
   // do some periodic updates
   EVERY_N_MILLISECONDS( 20 ) { gHue++; } // slowly cycle the "base color" through the rainbow
@@ -67,104 +89,24 @@ void loop()
 
   handleSerialCommands();
 
-  // insert a delay to keep the framerate modest
-  FastLED.delay(8);
-}
-
-void notifySerialMessage()
-{
-    _waitForLedAckTimestamp = millis();
-    Serial.print(RTS);
-    Serial.flush();
-    
+  // a show blocks interrupts, hold it while a frame is coming in
+  if (_serialLink.isReceiving())
+    _ledPush.noteActivity();
+  if (_ledPush.nextPush(millis()) >= 0)
+    showStrip();
 }
 
 void sendSerialMessage(char message[])
 {
-    notifySerialMessage();
-    strncpy(_lastLedMessage, message, strlen(message)+1);
-}
-
-void sendSerialData(char message[])
-{
-    Serial.print(message);
-    Serial.print(CS);
-    Serial.flush();
+    _serialLink.send(message);
 }
 
 void handleSerialCommands()
 {
-    //if we sent a message but didn't receive an ACK then send again
-    if (_waitForLedAckTimestamp && millis() - _waitForLedAckTimestamp > 300)
-    {
-        _waitForLedAckCount++;
-        notifySerialMessage();
-    }
-
-    if (_waitForLedAckCount > 5) //give up after 5 attempts
-    {
-        _waitForLedAckTimestamp = 0;
-        _waitForLedAckCount = 0;
-    }
-
-    static byte sidx = 0; //serial cursor
-    static unsigned long startTime = 0; //memory placeholder
-
-    startTime = millis();
-
-    //if we have data, read it
-    while (Serial.available() > 0) //burns through the buffer waiting for a start byte
-    {
-      char thisChar = Serial.read();
-
-      if (thisChar == RTS) //if the other end wants to send data, tell them it's OK
-      {
-        Serial.print(CTS);
-        Serial.flush();
-
-        
-        //no we wait for data to come in
-        sidx = 0;
-        
-        while (millis() - startTime < 300) //wait up to 300ms for next byte
-        {
-          if (!Serial.available()) //if nothing new.. continue
-              continue;
-
-          startTime = millis(); //update received timestamp, allows slow data to come in (manually typing)
-          thisChar = Serial.read();
-          if (thisChar == RTS)
-                    continue;
-          if (thisChar == CS) //if we receive a proper ending, process the data
-          {
-            while (Serial.available() > 0) //burns the buffer
-              Serial.read();
-
-            _incomingCommand[sidx] = '\0'; //terminate string
-            handleCommand();
-            break;
-          } else {
-            //save our byte
-            _incomingCommand[sidx] = thisChar;
-            sidx++;
-            //prevent overlfow and reset to our last byte
-            if (sidx >= _numChars) {
-                sidx = _numChars - 1;
-            }
-          } 
-        } //end data while loop
-      } //end RTS check
-      else if (thisChar == CTS)
-      {
-          _waitForLedAckTimestamp = 0;
-          _waitForLedAckCount = 0;
-
-          sendSerialData(_lastLedMessage);
-      }
-    } //end initial while loop
+    _serialLink.poll();
 }
 
-void handleCommand()
+void handleCommand(char incomingData[])
 {
   char outputData[100];
   char command[_numChars]= {0}; //holds the command
@@ -176,7 +118,7 @@ void handleCommand()
   char argument6[_numChars]= {0}; //holds the setting
 
   //inefficient but safer, everything is a string then converted later
-  sscanf(_incomingCommand, "%s %s %s %s %s %s %s", command, argument1, argument2, argument3, argument4, argument5, argument6);
+  sscanf(incomingData, "%s %s %s %s %s %s %s", command, argument1, argument2, argument3, argument4, argument5, argument6);
 
   if (strcmp(command,"s") == 0) //strobe
   {
@@ -189,7 +131,8 @@ void handleCommand()
     int flashDelay = atoi(argument5);
     int endPause = atoi(argument6);
 
-    strobe(red, green, blue, strobeCount, flashDelay, endPause);
+    byte colors[][3] = { { red, green, blue } };
+    startStrobe(colors, 1, strobeCount, flashDelay, endPause);
 
    }
    else if (strcmp(command,"ds") == 0) { //police strobe
@@ -210,7 +153,8 @@ void handleCommand()
     int flashDelay = atoi(argument4);
     int endPause = atoi(argument5);
 
-    dualstrobe(red, green, blue, red2, green2, blue2, strobeCount, flashDelay, endPause);
+    byte colors[][3] = { { red, green, blue }, { red2, green2, blue2 } };
+    startStrobe(colors, 2, strobeCount, flashDelay, endPause);
 
    } else if (strcmp(command,"p") == 0)
    {
@@ -222,8 +166,14 @@ void handleCommand()
       if (!_lightsEnabled)
       {
         setAll(0,0,0);
-        showStrip();
+        _ledPush.markDirty(0);
       }
+   } else if (strcmp(command,"leds") == 0) //led push stats: pushes,deferred,forced,crcErrors,dropped,failed, "leds reset" clears them
+   {
+      if (strcmp(argument1,"reset") == 0)
+        _ledPush.resetCounters();
+      sprintf(outputData, "leds %u,%u,%u,%u,%u,%u", _ledPush.getPushes(), _ledPush.getDeferred(), _ledPush.getForced(), _serialLink.getCrcErrors(), _serialLink.getDropped(), _serialLink.getFailed());
+      sendSerialMessage(outputData);
    }
 }
 
@@ -307,29 +257,47 @@ void juggle() {
   }
 }
 
-void strobe(byte red, byte green, byte blue, int strobeCount, int flashDelay, int endPause){
-  for(int j = 0; j < strobeCount; j++) {
-    setAll(red,green,blue);
-    FastLED.delay(flashDelay);
-    setAll(0,0,0);
-    FastLED.delay(flashDelay);
+void startStrobe(byte colors[][3], byte colorCount, int strobeCount, int flashDelay, int endPause)
+{
+  for (byte c = 0; c < colorCount; c++)
+  {
+    _strobe.colors[c][0] = colors[c][0];
+    _strobe.colors[c][1] = colors[c][1];
+    _strobe.colors[c][2] = colors[c][2];
   }
- 
- delay(endPause);
+  _strobe.colorCount = colorCount;
+  _strobe.stepCount = strobeCount * colorCount * 2;
+  _strobe.step = 0;
+  _strobe.flashDelay = flashDelay;
+  _strobe.endPause = endPause;
+  _strobe.timestampStep = millis();
+  _strobe.wait = _strobe.stepCount ? 0 : endPause; //first flash on the next loop
+  _strobe.active = true;
 }
 
-void dualstrobe(byte red, byte green, byte blue, byte red2, byte green2, byte blue2, int strobeCount, int flashDelay, int endPause){
-  for(int j = 0; j < strobeCount; j++) {
-    setAll(red,green,blue);
-    FastLED.delay(flashDelay);
-    setAll(0,0,0);
-    FastLED.delay(flashDelay);
+void runStrobe()
+{
+  if (millis() - _strobe.timestampStep < _strobe.wait)
+    return;
+
+  if (_strobe.step >= _strobe.stepCount) //end pause is over
+  {
+    _strobe.active = false;
+    return;
+  }
 
-    setAll(red2,green2,blue2);
-    FastLED.delay(flashDelay);
+  if (_strobe.step % 2)
     setAll(0,0,0);
-    FastLED.delay(flashDelay);
+  else
+  {
+    byte *color = _strobe.colors[(_strobe.step / 2) % _strobe.colorCount];
+    setAll(color[0], color[1], color[2]);
   }
- 
- delay(endPause);
+  _ledPush.markDirty(0);
+
+  _strobe.step++;
+  _strobe.timestampStep = millis();
+  _strobe.wait = _strobe.flashDelay;
+  if (_strobe.step >= _strobe.stepCount)
+    _strobe.wait += _strobe.endPause;
 }
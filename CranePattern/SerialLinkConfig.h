@@ -0,0 +1,8 @@
+#ifndef SerialLinkConfig_h
+#define SerialLinkConfig_h
+
+//the Uno only has 2K, a queue of 4 still answers a full window of commands from the claw controller
+//the window stays at 4 to match the claw controller's end of the link
+#define SERIAL_LINK_QUEUE 4
+
+#endif
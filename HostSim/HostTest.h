@@ -0,0 +1,42 @@
+#ifndef HostTest_h
+#define HostTest_h
+
+#include <stdio.h>
+
+/**
+ * Just enough of a test runner for the host builds: CHECK() records a failure and carries on,
+ * RUN_TEST() resets the mock HAL before each test and main() returns the failure count for ctest.
+ */
+
+static int _testFailures = 0;
+static const char *_testName = "";
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) \
+        { \
+            _testFailures++; \
+            printf("FAIL %s (%s:%d): %s\n", _testName, __FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
+
+#define CHECK_NEAR(value, expected, tolerance) \
+    do { \
+        double _v = (double)(value), _e = (double)(expected); \
+        if (_v - _e > (tolerance) || _e - _v > (tolerance)) \
+        { \
+            _testFailures++; \
+            printf("FAIL %s (%s:%d): %s = %g, expected %g +/- %g\n", _testName, __FILE__, __LINE__, #value, _v, _e, (double)(tolerance)); \
+        } \
+    } while (0)
+
+#define RUN_TEST(test) \
+    do { \
+        _testName = #test; \
+        mockReset(); \
+        int _before = _testFailures; \
+        test(); \
+        printf("%s %s\n", _testFailures == _before ? "ok  " : "FAIL", #test); \
+    } while (0)
+
+#endif
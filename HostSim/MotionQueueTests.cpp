@@ -0,0 +1,227 @@
+#include "Arduino.h"
+#include "StepperController.h"
+#include "FastStepperController.h"
+#include "MotionQueue.h"
+#include "HostTest.h"
+#include "StepperSim.h"
+
+/**
+ * MotionQueue driving two steppers on the virtual clock, set up like the sketch's LR and PAN axes.
+ * Positions are counted back from the step and dir pin edges, not taken from the controllers.
+ */
+
+const byte LR_STEP_PIN = 4;
+const byte LR_DIR_PIN = 5;
+const byte PAN_STEP_PIN = 7;
+const byte PAN_DIR_PIN = 8;
+
+typedef FastStepperController<LR_STEP_PIN, LR_DIR_PIN, 6, 10, 16> LRStepper;
+typedef FastStepperController<PAN_STEP_PIN, PAN_DIR_PIN, 9, 11, 17> PANStepper;
+
+const int CRUISE_MICROS = 500; //step interval at the 2000 steps/S max speed below
+
+static int _queueCompleteEvents;
+
+static void onQueueComplete()
+{
+    _queueCompleteEvents++;
+}
+
+static void setupAxis(StepperController &stepper, long limit)
+{
+    stepper.setLimitTriggerState(LOW);
+    stepper.setLimits(limit, -limit);
+    stepper.setAccel(20);
+    stepper.setMaxSpeed(2000);
+}
+
+//where the pins say an axis is, and the furthest it got either way
+static long physical(byte stepPin, byte dirPin, long *highest = 0, long *lowest = 0)
+{
+    const MockEdge *edges = mockEdges();
+    long position = 0;
+    bool forward = true;
+    if (highest)
+        *highest = 0;
+    if (lowest)
+        *lowest = 0;
+    for (unsigned long i = 0; i < mockEdgeCount(); i++)
+    {
+        if (edges[i].pin == dirPin)
+            forward = edges[i].level == HIGH;
+        else if (edges[i].pin == stepPin && edges[i].level == HIGH)
+        {
+            position += forward ? 1 : -1;
+            if (highest && position > *highest)
+                *highest = position;
+            if (lowest && position < *lowest)
+                *lowest = position;
+        }
+    }
+    return position;
+}
+
+static void runQueue(MotionQueue &queue, StepperController &lr, StepperController &pan, unsigned long loopMicros)
+{
+    queue.run();
+    runLoop([&]() {
+        lr.step();
+        pan.step();
+        queue.run();
+    }, [&]() { return !queue.isRunning(); }, loopMicros, 20000000ul);
+}
+
+//the step after position on the trace of a pin, -1 if it never got there
+static long stepIndexAt(byte stepPin, byte dirPin, long position)
+{
+    const MockEdge *edges = mockEdges();
+    long current = 0;
+    long index = 0;
+    bool forward = true;
+    for (unsigned long i = 0; i < mockEdgeCount(); i++)
+    {
+        if (edges[i].pin == dirPin)
+            forward = edges[i].level == HIGH;
+        else if (edges[i].pin == stepPin && edges[i].level == HIGH)
+        {
+            current += forward ? 1 : -1;
+            if (current == position)
+                return index;
+            index++;
+        }
+    }
+    return -1;
+}
+
+static void checkFollowerSoftLimit(bool timer)
+{
+    LRStepper lr;
+    PANStepper pan;
+    setupAxis(lr, 100000l);
+    setupAxis(pan, 240l);
+    if (timer)
+    {
+        lr.attachTimer(0);
+        pan.attachTimer(1);
+    }
+
+    //a follower with no switches in the way has only its soft limits to stop it
+    pan.setDirection(DIRECTION_FORWARD);
+    lr.setFollower(&pan, 600);
+    lr.moveTo(1000);
+    runLoop([&]() { lr.step(); pan.step(); }, [&]() { return !lr.isRunning(); }, timer ? 500 : 8, 5000000ul);
+
+    long highest;
+    CHECK(physical(PAN_STEP_PIN, PAN_DIR_PIN, &highest) == 240);
+    CHECK(highest == 240);
+    CHECK(pan.getPosition() == 240);
+    CHECK(lr.getPosition() < 1000); //stopped with it
+}
+
+static void testFollowerStopsAtSoftLimit()
+{
+    checkFollowerSoftLimit(false);
+    mockReset();
+    checkFollowerSoftLimit(true);
+}
+
+static void testQueueRejectsTargetsOutsideLimits()
+{
+    LRStepper lr;
+    PANStepper pan;
+    setupAxis(lr, 5000l);
+    setupAxis(pan, 240l);
+    MotionQueue queue(&lr, &pan);
+
+    CHECK(!queue.add(1000, 300, 0));
+    CHECK(!queue.add(6000, 0, 0));
+    CHECK(queue.add(1000, 240, 0));
+    CHECK(queue.count() == 1);
+}
+
+static void checkBlendedSegmentsDontStop(bool timer)
+{
+    LRStepper lr;
+    PANStepper pan;
+    setupAxis(lr, 100000l);
+    setupAxis(pan, 100000l);
+    if (timer)
+    {
+        lr.attachTimer(0);
+        pan.attachTimer(1);
+    }
+    MotionQueue queue(&lr, &pan);
+    queue.setEventQueueComplete(onQueueComplete);
+    _queueCompleteEvents = 0;
+
+    //LR leads all the way, PAN goes with it then holds still
+    CHECK(queue.add(1000, 200, 0));
+    CHECK(queue.add(2000, 500, 0));
+    CHECK(queue.add(3000, 500, 0));
+    runQueue(queue, lr, pan, timer ? 500 : 8);
+
+    CHECK(_queueCompleteEvents == 1);
+    CHECK(lr.getPosition() == 3000 && pan.getPosition() == 500);
+    CHECK(physical(LR_STEP_PIN, LR_DIR_PIN) == 3000);
+    CHECK(physical(PAN_STEP_PIN, PAN_DIR_PIN) == 500);
+
+    //cruising straight through both joins, no slow down and no gap
+    std::vector<long> gaps = intervals(edgeTimes(LR_STEP_PIN, HIGH));
+    CHECK(gaps.size() == 2999);
+    for (size_t i = 500; i < 2500 && i < gaps.size(); i++)
+        CHECK_NEAR(gaps[i], CRUISE_MICROS, timer ? TIMER_TICK_MICROS : 8);
+}
+
+static void testBlendedSegmentsDontStop()
+{
+    checkBlendedSegmentsDontStop(false);
+    mockReset();
+    checkBlendedSegmentsDontStop(true);
+}
+
+static void checkReversingFollowerStops(bool timer)
+{
+    LRStepper lr;
+    PANStepper pan;
+    setupAxis(lr, 100000l);
+    setupAxis(pan, 100000l);
+    if (timer)
+    {
+        lr.attachTimer(0);
+        pan.attachTimer(1);
+    }
+    MotionQueue queue(&lr, &pan);
+
+    //LR carries on the same way but PAN turns round at the join
+    CHECK(queue.add(1000, 300, 0));
+    CHECK(queue.add(2000, 0, 0));
+    runQueue(queue, lr, pan, timer ? 500 : 8);
+
+    long highest;
+    CHECK(physical(PAN_STEP_PIN, PAN_DIR_PIN, &highest) == 0);
+    CHECK(highest == 300);
+    CHECK(physical(LR_STEP_PIN, LR_DIR_PIN) == 2000);
+
+    //LR has to slow into the join so PAN can turn round
+    std::vector<long> gaps = intervals(edgeTimes(LR_STEP_PIN, HIGH));
+    long join = stepIndexAt(LR_STEP_PIN, LR_DIR_PIN, 1000);
+    CHECK(join > 0 && (size_t)join < gaps.size());
+    if (join > 0 && (size_t)join < gaps.size())
+        CHECK(gaps[join - 1] > 4 * CRUISE_MICROS);
+}
+
+static void testReversingFollowerStops()
+{
+    checkReversingFollowerStops(false);
+    mockReset();
+    checkReversingFollowerStops(true);
+}
+
+int main()
+{
+    RUN_TEST(testFollowerStopsAtSoftLimit);
+    RUN_TEST(testQueueRejectsTargetsOutsideLimits);
+    RUN_TEST(testBlendedSegmentsDontStop);
+    RUN_TEST(testReversingFollowerStops);
+    return _testFailures;
+}
@@ -0,0 +1,97 @@
+#include "Arduino.h"
+#include "SensorClassifier.h"
+#include "Defines.h"
+#include "HostTest.h"
+#include <vector>
+
+/**
+ * SensorClassifier set up as each sketch sets it up, fed the sensor edges from a trace in traces/.
+ * Trace lines are "time sensor level", "! code" lines list the hits expected in order.
+ */
+
+//play a trace into classifier, polling every pollEvery time units like loop() would, 0 to never poll
+template <byte SENSORS>
+static void checkTrace(SensorClassifier<SENSORS> &classifier, const char *name, unsigned long pollEvery)
+{
+    char path[200];
+    snprintf(path, sizeof(path), "%s/%s", HOSTSIM_TRACE_DIR, name);
+    FILE *file = fopen(path, "r");
+    CHECK(file != 0);
+    if (!file)
+        return;
+
+    std::vector<int> expected;
+    std::vector<int> hits;
+    unsigned long now = 0;
+    char line[200];
+    while (fgets(line, sizeof(line), file))
+    {
+        unsigned long time;
+        int sensor;
+        int level;
+        int code;
+        if (sscanf(line, "! %d", &code) == 1)
+        {
+            expected.push_back(code);
+            continue;
+        }
+        if (line[0] == '#' || sscanf(line, "%lu %d %d", &time, &sensor, &level) != 3)
+            continue;
+
+        for (; pollEvery && now + pollEvery < time; now += pollEvery)
+            classifier.poll(now + pollEvery);
+        now = time;
+        classifier.sample((byte)sensor, level != 0, time);
+        while (classifier.available())
+            hits.push_back(classifier.read());
+    }
+    fclose(file);
+
+    //let anything pending or waiting on a window finish
+    for (unsigned long end = now + 1000000ul; pollEvery && now < end; now += pollEvery)
+        classifier.poll(now);
+    while (classifier.available())
+        hits.push_back(classifier.read());
+
+    CHECK(hits.size() == expected.size());
+    for (size_t i = 0; i < hits.size() && i < expected.size(); i++)
+    {
+        if (hits[i] != expected[i])
+            printf("  %s hit %u: got %d, expected %d\n", name, (unsigned)i, hits[i], expected[i]);
+        CHECK(hits[i] == expected[i]);
+    }
+}
+
+//as initScoring() and applyScoringTimes() with the default timings, times in uS
+static void testSkeeballScoringTrace()
+{
+    SensorClassifier<8> classifier;
+    classifier.setSensor(0, SCORE_SLOT_1000, 0, 500 * 1000UL);
+    classifier.setSensor(1, SCORE_SLOT_2000, 0, 500 * 1000UL);
+    classifier.setSensor(2, SCORE_SLOT_3000, 0, 500 * 1000UL);
+    classifier.setSensor(3, SCORE_SLOT_4000, 0, 500 * 1000UL);
+    classifier.setSensor(4, SCORE_SLOT_10K_RIGHT, 0, 500 * 1000UL);
+    classifier.setSensor(5, SCORE_SLOT_10K_LEFT, 0, 500 * 1000UL);
+    classifier.setSensor(6, SCORE_SLOT_BALL_STOP, 5 * 1000UL, 50 * 1000UL);
+    classifier.setSensor(7, SCORE_SLOT_RETURN, 0, 200 * 1000UL);
+    CHECK(classifier.addCoincidence(0x10 | 0x20, 20 * 1000UL, SCORE_SLOT_5000));
+
+    checkTrace(classifier, "skeeball_scoring.txt", 248);
+}
+
+//as initScoreSensors(), times in mS
+static void testPlinkoSlotsTrace()
+{
+    SensorClassifier<12> classifier;
+    for (byte i = 0; i < 12; i++)
+        classifier.setSensor(i, i + 1, 0, 1000);
+
+    checkTrace(classifier, "plinko_slots.txt", 0);
+}
+
+int main()
+{
+    RUN_TEST(testSkeeballScoringTrace);
+    RUN_TEST(testPlinkoSlotsTrace);
+    return _testFailures;
+}
@@ -0,0 +1,179 @@
+#include "Arduino.h"
+#include "SerialLink.h"
+#include "HostTest.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * Two SerialLinks talking over an in memory wire on the virtual clock. Either direction of the wire can
+ * lose bytes and either end can be restarted by building a new link on it.
+ */
+
+//one end of the wire, writes land in the other end's receive buffer
+class MockWire : public Stream
+{
+  public:
+    MockWire() : peer(0), dropping(false) {}
+    int available() { return (int)incoming.size(); }
+    int read()
+    {
+        if (incoming.empty())
+            return -1;
+        int b = incoming.front();
+        incoming.pop_front();
+        return b;
+    }
+    size_t write(uint8_t b)
+    {
+        if (!dropping)
+            peer->incoming.push_back(b);
+        return 1;
+    }
+
+    MockWire *peer;
+    bool dropping; //lose everything written from this end
+    std::deque<uint8_t> incoming;
+};
+
+static std::vector<std::string> _received;
+
+static void onMessage(char message[])
+{
+    _received.push_back(message);
+}
+
+static void connect(MockWire &a, MockWire &b)
+{
+    a.peer = &b;
+    b.peer = &a;
+    _received.clear();
+}
+
+//poll both ends every mS until nothing is left to send or timeout mS pass
+static void settle(SerialLink &a, SerialLink &b, unsigned long timeout)
+{
+    for (unsigned long i = 0; i < timeout; i++)
+    {
+        a.poll();
+        b.poll();
+        if (!a.pending() && !b.pending() && !a.isReceiving() && !b.isReceiving())
+            return;
+        mockAdvance(1000);
+    }
+}
+
+static void testDeliversInOrder()
+{
+    MockWire wireA, wireB;
+    connect(wireA, wireB);
+    SerialLink sender(wireA);
+    SerialLink receiver(wireB);
+    receiver.setReceiveHandler(onMessage);
+
+    CHECK(sender.send("1 ping"));
+    CHECK(sender.send("2 gl"));
+    CHECK(sender.send("3 mq 100 200 0"));
+    settle(sender, receiver, 1000);
+
+    CHECK(_received.size() == 3);
+    if (_received.size() == 3)
+    {
+        CHECK(_received[0] == "1 ping");
+        CHECK(_received[1] == "2 gl");
+        CHECK(_received[2] == "3 mq 100 200 0");
+    }
+    CHECK(sender.pending() == 0);
+}
+
+static void testLostAcksDontDuplicate()
+{
+    MockWire wireA, wireB;
+    connect(wireA, wireB);
+    SerialLink sender(wireA);
+    SerialLink receiver(wireB);
+    receiver.setReceiveHandler(onMessage);
+
+    sender.send("first");
+    settle(sender, receiver, 1000);
+
+    //acks are lost so the sender resends, the receiver must hand each message over once
+    wireB.dropping = true;
+    sender.send("second");
+    sender.send("third");
+    for (int i = 0; i < 700; i++)
+    {
+        sender.poll();
+        receiver.poll();
+        mockAdvance(1000);
+    }
+    wireB.dropping = false;
+    settle(sender, receiver, 2000);
+
+    CHECK(_received.size() == 3);
+    CHECK(sender.pending() == 0);
+    CHECK(sender.getFailed() == 0);
+}
+
+//the sender restarts after the receiver has taken some of its messages, wherever that leaves the numbering
+static void testPeerRestartResyncs()
+{
+    for (int delivered = 0; delivered <= 2 * SERIAL_LINK_WINDOW + 2; delivered++)
+    {
+        mockReset();
+        MockWire wireA, wireB;
+        connect(wireA, wireB);
+        SerialLink receiver(wireB);
+        receiver.setReceiveHandler(onMessage);
+        {
+            SerialLink sender(wireA);
+            char message[10];
+            for (int i = 0; i < delivered; i++)
+            {
+                sprintf(message, "m%i", i);
+                sender.send(message);
+                settle(sender, receiver, 1000);
+            }
+        }
+
+        SerialLink restarted(wireA);
+        restarted.send("after restart");
+        settle(restarted, receiver, 1000);
+
+        CHECK((int)_received.size() == delivered + 1);
+        if ((int)_received.size() == delivered + 1)
+            CHECK(_received.back() == "after restart");
+        CHECK(restarted.pending() == 0);
+    }
+}
+
+//a restarted sender repeating the message it sent last, once its retries would have run out
+static void testPeerRestartRepeatsMessage()
+{
+    MockWire wireA, wireB;
+    connect(wireA, wireB);
+    SerialLink receiver(wireB);
+    receiver.setReceiveHandler(onMessage);
+    {
+        SerialLink sender(wireA);
+        sender.send("408 startup");
+        settle(sender, receiver, 1000);
+    }
+    mockAdvance(2500000ul); //bootloader and setup()
+
+    SerialLink restarted(wireA);
+    restarted.send("408 startup");
+    settle(restarted, receiver, 1000);
+
+    CHECK(_received.size() == 2);
+    CHECK(restarted.pending() == 0);
+}
+
+int main()
+{
+    RUN_TEST(testDeliversInOrder);
+    RUN_TEST(testLostAcksDontDuplicate);
+    RUN_TEST(testPeerRestartResyncs);
+    RUN_TEST(testPeerRestartRepeatsMessage);
+    return _testFailures;
+}
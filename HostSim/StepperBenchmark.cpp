@@ -0,0 +1,124 @@
+#include "Arduino.h"
+#include "StepperController.h"
+#include "FastStepperController.h"
+#include "StepperSim.h"
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Motion performance across accel/max speed settings, polled and timer driven.
+ *
+ *  rate - steps per second achieved over the cruise part of the move, against the max speed asked for
+ *  jitter - mean and worst deviation of cruise step intervals from the planned interval, uS
+ *  cost - host CPU per step() call from loop(), cycles where the CPU has a cycle counter, else nS.
+ *         Only comparable between runs on the same machine, it's for spotting regressions.
+ *
+ * --quick runs a couple of settings for ctest.
+ */
+
+typedef FastStepperController<4, 5, 6, 10, 16> BenchStepper;
+
+const unsigned long LOOP_MICROS = 20; //a loop() with little else to do
+
+static unsigned long long cpuNow()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+struct BenchResult
+{
+    double rate;
+    double meanJitter;
+    long worstJitter;
+    double costPerCall;
+};
+
+static BenchResult runMove(int accel, int maxSpeed, bool timer, long steps)
+{
+    mockReset();
+    BenchStepper stepper;
+    stepper.setLimitTriggerState(LOW);
+    stepper.setLimits(1000000l, -1000000l);
+    stepper.setAccel(accel);
+    stepper.setMaxSpeed(maxSpeed);
+    if (timer)
+        stepper.attachTimer(0);
+
+    unsigned long long cycles = 0;
+    unsigned long calls = 0;
+    stepper.moveTo(steps);
+    runLoop([&]() {
+        unsigned long long start = cpuNow();
+        stepper.step();
+        cycles += cpuNow() - start;
+        calls++;
+    }, [&]() { return !stepper.isRunning(); }, LOOP_MICROS, 600000000ul);
+
+    std::vector<unsigned long> rising = edgeTimes(4, HIGH);
+    std::vector<long> gaps = intervals(rising);
+
+    //cruise is the middle of the move once the ramp is done, skip a ramp length either end
+    long ramp = (maxSpeed + accel - 1) / accel;
+    size_t from = (size_t)ramp;
+    size_t to = gaps.size() > (size_t)ramp ? gaps.size() - (size_t)ramp : 0;
+
+    BenchResult result = { 0, 0, 0, calls ? (double)cycles / calls : 0 };
+    if (to <= from)
+        return result;
+
+    double planned = 1000000.0 / maxSpeed;
+    double total = 0;
+    for (size_t i = from; i < to; i++)
+    {
+        double deviation = gaps[i] - planned;
+        if (deviation < 0)
+            deviation = -deviation;
+        total += deviation;
+        if ((long)(deviation + 0.5) > result.worstJitter)
+            result.worstJitter = (long)(deviation + 0.5);
+    }
+    result.rate = (to - from) * 1000000.0 / (double)(rising[to] - rising[from]);
+    result.meanJitter = total / (to - from);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    bool quick = argc > 1 && strcmp(argv[1], "--quick") == 0;
+
+    static const int accels[] = { 9, 20, 50 };
+    static const int speeds[] = { 400, 1000, 2000, 3000, 5000 };
+    int accelCount = quick ? 1 : 3;
+    int speedCount = quick ? 2 : 5;
+    long steps = quick ? 3000 : 20000;
+
+#if defined(__x86_64__) || defined(__i386__)
+    const char *costUnit = "cycles";
+#else
+    const char *costUnit = "nS";
+#endif
+    printf("%-6s %6s %6s | %9s %9s %7s | %s/call\n", "mode", "accel", "speed", "rate", "jitter", "worst", costUnit);
+
+    int failures = 0;
+    for (int t = 0; t < 2; t++)
+    {
+        for (int a = 0; a < accelCount; a++)
+        {
+            for (int s = 0; s < speedCount; s++)
+            {
+                BenchResult result = runMove(accels[a], speeds[s], t == 1, steps);
+                printf("%-6s %6d %6d | %9.1f %9.2f %7ld | %.0f\n", t ? "timer" : "polled", accels[a], speeds[s],
+                    result.rate, result.meanJitter, result.worstJitter, result.costPerCall);
+                if (result.rate <= 0)
+                    failures++; //never reached cruise, the move itself is broken
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,64 @@
+#ifndef StepperSim_h
+#define StepperSim_h
+
+#include "Arduino.h"
+#include <vector>
+
+/**
+ * Helpers for driving a stepper on the virtual clock and reading back what the pins did.
+ * The loop function stands in for the sketch's loop(), called every loopMicros of virtual time.
+ */
+
+//run loop until done() or timeout uS pass, returns the virtual time it took
+template <class Loop, class Done>
+unsigned long runLoop(Loop loop, Done done, unsigned long loopMicros, unsigned long timeout)
+{
+    unsigned long start = micros();
+    while (!done() && micros() - start < timeout)
+    {
+        loop();
+        mockAdvance(loopMicros);
+    }
+    return micros() - start;
+}
+
+//times of every change of pin to level in the trace
+inline std::vector<unsigned long> edgeTimes(byte pin, byte level)
+{
+    std::vector<unsigned long> times;
+    const MockEdge *edges = mockEdges();
+    for (unsigned long i = 0; i < mockEdgeCount(); i++)
+    {
+        if (edges[i].pin == pin && edges[i].level == level)
+            times.push_back(edges[i].time);
+    }
+    return times;
+}
+
+//gaps between consecutive times
+inline std::vector<long> intervals(const std::vector<unsigned long> &times)
+{
+    std::vector<long> gaps;
+    for (size_t i = 1; i < times.size(); i++)
+        gaps.push_back((long)(times[i] - times[i - 1]));
+    return gaps;
+}
+
+//high time of each pulse on pin
+inline std::vector<long> pulseWidths(byte pin)
+{
+    std::vector<unsigned long> rising = edgeTimes(pin, HIGH);
+    std::vector<unsigned long> falling = edgeTimes(pin, LOW);
+    std::vector<long> widths;
+    size_t f = 0;
+    for (size_t r = 0; r < rising.size(); r++)
+    {
+        while (f < falling.size() && falling[f] < rising[r])
+            f++;
+        if (f < falling.size())
+            widths.push_back((long)(falling[f] - rising[r]));
+    }
+    return widths;
+}
+
+#endif
@@ -0,0 +1,369 @@
+#include "Arduino.h"
+#include "StepperController.h"
+#include "FastStepperController.h"
+#include "HostTest.h"
+#include "StepperSim.h"
+
+/**
+ * StepperController on the virtual clock. Each test drives a move the way the sketch does, step() from
+ * loop() and optionally Timer1, then checks the recorded step pin edges.
+ */
+
+const byte STEP_PIN = 4;
+const byte DIR_PIN = 5;
+const byte ENABLE_PIN = 6;
+const byte HOME_PIN = 10;
+const byte END_PIN = 16;
+
+typedef FastStepperController<STEP_PIN, DIR_PIN, ENABLE_PIN, HOME_PIN, END_PIN> TestStepper;
+
+//switches close on the physical position of the carriage, counted from the step and dir pins
+static long _physical;
+static unsigned long _edgesSeen;
+static long _homeSwitchAt; //closed at or below this
+static long _endSwitchAt; //closed at or above this
+static long _lowestPhysical; //furthest the carriage went toward home
+
+static int _moveCompleteEvents;
+static int _homeCompleteEvents;
+static int _endLimitEvents;
+
+static void trackCarriage()
+{
+    const MockEdge *edges = mockEdges();
+    for (; _edgesSeen < mockEdgeCount(); _edgesSeen++)
+    {
+        if (edges[_edgesSeen].pin == STEP_PIN && edges[_edgesSeen].level == HIGH)
+            _physical += digitalRead(DIR_PIN) == HIGH ? 1 : -1;
+    }
+    if (_physical < _lowestPhysical)
+        _lowestPhysical = _physical;
+    mockSetPin(HOME_PIN, _physical <= _homeSwitchAt ? LOW : HIGH);
+    mockSetPin(END_PIN, _physical >= _endSwitchAt ? LOW : HIGH);
+}
+
+static void onMoveComplete(int stepperId)
+{
+    (void)stepperId;
+    _moveCompleteEvents++;
+}
+
+static void onHomeComplete(int stepperId)
+{
+    (void)stepperId;
+    _homeCompleteEvents++;
+}
+
+static void onEndLimit(int stepperId)
+{
+    (void)stepperId;
+    _endLimitEvents++;
+}
+
+//a stepper set up like the sketch's pan axis, switches open and far away
+static void setupStepper(TestStepper &stepper)
+{
+    _physical = 0;
+    _lowestPhysical = 0;
+    _edgesSeen = 0;
+    _homeSwitchAt = -100000l;
+    _endSwitchAt = 100000l;
+    _moveCompleteEvents = 0;
+    _homeCompleteEvents = 0;
+    _endLimitEvents = 0;
+    mockSetTickHook(trackCarriage);
+
+    stepper.setLimitTriggerState(LOW);
+    stepper.setLimits(100000l, -100000l);
+    stepper.setAccel(20);
+    stepper.setMaxSpeed(2000);
+    stepper.setEventMoveComplete(onMoveComplete);
+    stepper.setEventAutoHomeComplete(onHomeComplete);
+    stepper.setEventLimitEnd(onEndLimit);
+    trackCarriage();
+}
+
+static unsigned long runUntilStopped(TestStepper &stepper, unsigned long loopMicros, unsigned long timeout)
+{
+    return runLoop([&]() { stepper.step(); }, [&]() { return !stepper.isRunning(); }, loopMicros, timeout);
+}
+
+static long shortest(const std::vector<long> &gaps, size_t from, size_t to)
+{
+    long best = 0x7FFFFFFFl;
+    for (size_t i = from; i < to && i < gaps.size(); i++)
+    {
+        if (gaps[i] < best)
+            best = gaps[i];
+    }
+    return best;
+}
+
+static void testPolledMoveReachesTarget()
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+
+    stepper.moveTo(2000);
+    runUntilStopped(stepper, 8, 5000000ul);
+
+    std::vector<long> gaps = intervals(edgeTimes(STEP_PIN, HIGH));
+    CHECK(stepper.getPosition() == 2000);
+    CHECK(_physical == 2000);
+    CHECK(gaps.size() == 1999);
+    CHECK(_moveCompleteEvents == 1);
+    CHECK_NEAR(gaps[1000], 500, 8); //cruising at max speed, within a loop of the plan
+    CHECK(gaps[0] > 2 * gaps[1000]); //ramps up
+    CHECK(gaps[gaps.size() - 1] > 2 * gaps[1000]); //and down into the target
+}
+
+static void testTimerMoveIgnoresLoopLatency()
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+    stepper.attachTimer(0);
+
+    stepper.moveTo(2000);
+    runUntilStopped(stepper, 2000, 5000000ul); //loop() only gets round every 2mS
+
+    std::vector<long> gaps = intervals(edgeTimes(STEP_PIN, HIGH));
+    CHECK(stepper.getPosition() == 2000);
+    CHECK(_physical == 2000);
+    CHECK(gaps.size() == 1999);
+    for (size_t i = 900; i < 1100 && i < gaps.size(); i++)
+        CHECK_NEAR(gaps[i], 500, TIMER_TICK_MICROS); //timer resolution, not loop resolution
+}
+
+static void testTimerPulseNeedsNoBusyWait()
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+    stepper.attachTimer(0);
+
+    stepper.moveTo(500);
+    runUntilStopped(stepper, 100, 5000000ul);
+
+    std::vector<long> widths = pulseWidths(STEP_PIN);
+    CHECK(stepper.getPosition() == 500);
+    CHECK(widths.size() == 500);
+    for (size_t i = 0; i < widths.size(); i++)
+    {
+        CHECK(widths[i] >= 5); //driver minimum
+        CHECK(widths[i] <= STEP_PULSE_MICROS + 2 * TIMER_TICK_MICROS);
+    }
+    CHECK(mockIsrDelayMicros() == 0);
+    CHECK(mockIsrCount() >= 1000); //a compare to raise and one to drop each pulse
+}
+
+static void testLateInterruptDoesNotStall()
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+    stepper.attachTimer(0);
+
+    stepper.moveTo(3000);
+    runLoop([&]() { stepper.step(); }, [&]() { return stepper.getPosition() >= 1000; }, 100, 5000000ul);
+
+    //a long critical section swallows a couple of deadlines
+    mockBlockInterrupts(true);
+    mockAdvance(1500);
+    mockBlockInterrupts(false);
+    runUntilStopped(stepper, 100, 5000000ul);
+
+    std::vector<long> gaps = intervals(edgeTimes(STEP_PIN, HIGH));
+    CHECK(stepper.getPosition() == 3000);
+    long longest = 0;
+    for (size_t i = 500; i + 500 < gaps.size(); i++)
+    {
+        if (gaps[i] > longest)
+            longest = gaps[i];
+    }
+    CHECK(longest <= 1500 + 500); //late by the critical section, not by a timer wrap
+}
+
+static void testTimerStopsAtSwitchWhileLoopStalls()
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+    stepper.attachTimer(0);
+    _endSwitchAt = 300;
+
+    stepper.moveTo(1000);
+    runUntilStopped(stepper, 100000, 5000000ul); //loop() stuck for 100mS at a time
+
+    CHECK(_physical >= 300 && _physical <= 301);
+    CHECK(_endLimitEvents == 1);
+    CHECK(!stepper.isRunning());
+}
+
+static void testTimerAutoHomeWhileLoopStalls()
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+    stepper.attachTimer(0);
+    _homeSwitchAt = -150;
+
+    stepper.autoHome();
+    runUntilStopped(stepper, 50000, 20000000ul);
+
+    CHECK(stepper.isHomed());
+    CHECK(_homeCompleteEvents == 1);
+    CHECK(_lowestPhysical >= -151); //turned round at the switch, not somewhere past it
+}
+
+static void testSoftLimitStopsMove()
+{
+    TestStepper polled;
+    setupStepper(polled);
+    polled.setLimits(500l, -500l);
+    polled.moveTo(800);
+    runUntilStopped(polled, 8, 5000000ul);
+    CHECK(polled.getPosition() == 500);
+    CHECK(_physical == 500);
+
+    mockReset();
+    TestStepper timed;
+    setupStepper(timed);
+    timed.attachTimer(1);
+    timed.setLimits(500l, -500l);
+    timed.moveTo(-800);
+    runUntilStopped(timed, 100, 5000000ul);
+    CHECK(timed.getPosition() == -500);
+    CHECK(_physical == -500);
+}
+
+static void testEndSwitchStopsMove()
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+    _endSwitchAt = 300;
+
+    stepper.moveTo(1000);
+    runUntilStopped(stepper, 8, 5000000ul);
+
+    CHECK(_physical >= 300 && _physical <= 301);
+    CHECK(_endLimitEvents == 1);
+    CHECK(_moveCompleteEvents == 1);
+    CHECK(!stepper.isRunning());
+}
+
+static void testAutoHomeBacksOffSwitch()
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+    _homeSwitchAt = -150;
+
+    stepper.autoHome();
+    runUntilStopped(stepper, 8, 10000000ul);
+
+    CHECK(stepper.isHomed());
+    CHECK(stepper.getPosition() == 0);
+    CHECK(_homeCompleteEvents == 1);
+    CHECK_NEAR(_physical, -150 + 41, 2); //switch releases, then backoff steps
+}
+
+static void checkRetargetReverses(bool timer)
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+    if (timer)
+        stepper.attachTimer(0);
+
+    stepper.moveTo(5000);
+    runLoop([&]() { stepper.step(); }, [&]() { return stepper.getPosition() >= 300; }, 8, 5000000ul);
+    stepper.retarget(200);
+    runUntilStopped(stepper, 8, 5000000ul);
+
+    CHECK(stepper.getPosition() == 200);
+    CHECK(_physical == 200);
+    CHECK(_moveCompleteEvents == 1);
+
+    //find the reversal in the trace, the steps either side of it have to be slow
+    std::vector<unsigned long> dirChanges = edgeTimes(DIR_PIN, LOW);
+    CHECK(dirChanges.size() == 1);
+    std::vector<unsigned long> steps = edgeTimes(STEP_PIN, HIGH);
+    std::vector<long> gaps = intervals(steps);
+    size_t turn = 0;
+    while (turn < steps.size() && steps[turn] < dirChanges[0])
+        turn++;
+    CHECK(turn > 2 && turn + 2 < steps.size());
+    CHECK(shortest(gaps, turn - 3, turn + 2) > 4 * shortest(gaps, 0, gaps.size()));
+}
+
+static void testRetargetReversesThroughZero()
+{
+    checkRetargetReverses(false);
+    mockReset();
+    checkRetargetReverses(true);
+}
+
+//rising edge intervals of a reference move against the recorded copy in traces/, --record rewrites it
+static void checkRecordedTrace(bool record)
+{
+    TestStepper stepper;
+    setupStepper(stepper);
+
+    stepper.moveTo(400);
+    runUntilStopped(stepper, 8, 5000000ul);
+    std::vector<long> gaps = intervals(edgeTimes(STEP_PIN, HIGH));
+
+    const char *path = HOSTSIM_TRACE_DIR "/stepper_move_polled.txt";
+    if (record)
+    {
+        FILE *file = fopen(path, "w");
+        CHECK(file != 0);
+        if (!file)
+            return;
+        fprintf(file, "# moveTo(400), accel 20, max speed 2000, loop every 8uS: uS between step rising edges\n");
+        for (size_t i = 0; i < gaps.size(); i++)
+            fprintf(file, "%ld\n", gaps[i]);
+        fclose(file);
+        return;
+    }
+
+    FILE *file = fopen(path, "r");
+    CHECK(file != 0);
+    if (!file)
+        return;
+
+    char line[200];
+    size_t index = 0;
+    while (fgets(line, sizeof(line), file))
+    {
+        if (line[0] == '#')
+            continue;
+        CHECK(index < gaps.size());
+        if (index >= gaps.size())
+            break;
+        CHECK_NEAR(gaps[index], atol(line), 8);
+        index++;
+    }
+    fclose(file);
+    CHECK(index == gaps.size());
+}
+
+static bool _recordTraces = false;
+
+static void testMatchesRecordedTrace()
+{
+    checkRecordedTrace(_recordTraces);
+}
+
+int main(int argc, char **argv)
+{
+    _recordTraces = argc > 1 && strcmp(argv[1], "--record") == 0;
+
+    RUN_TEST(testPolledMoveReachesTarget);
+    RUN_TEST(testTimerMoveIgnoresLoopLatency);
+    RUN_TEST(testTimerPulseNeedsNoBusyWait);
+    RUN_TEST(testLateInterruptDoesNotStall);
+    RUN_TEST(testTimerStopsAtSwitchWhileLoopStalls);
+    RUN_TEST(testTimerAutoHomeWhileLoopStalls);
+    RUN_TEST(testSoftLimitStopsMove);
+    RUN_TEST(testEndSwitchStopsMove);
+    RUN_TEST(testAutoHomeBacksOffSwitch);
+    RUN_TEST(testRetargetReversesThroughZero);
+    RUN_TEST(testMatchesRecordedTrace);
+
+    return _testFailures ? 1 : 0;
+}
@@ -0,0 +1,212 @@
+#include "Arduino.h"
+#include <vector>
+
+volatile uint16_t TCNT1, OCR1A, OCR1B, OCR1C;
+volatile uint8_t TIMSK1, TCCR1A, TCCR1B;
+MockFlagRegister TIFR1;
+
+//the compare ISRs live in whatever is linked in, a test without a stepper has none
+void mockTimer1CompA() __attribute__((weak));
+void mockTimer1CompB() __attribute__((weak));
+void mockTimer1CompC() __attribute__((weak));
+
+static unsigned long _clock; //virtual micros()
+static byte _tickPhase; //uS into the current Timer1 tick
+static byte _pins[MOCK_PIN_COUNT];
+static volatile uint8_t _ports[MOCK_PIN_COUNT];
+static std::vector<MockEdge> _edges;
+static void (*_tickHook)();
+static bool _interruptsBlocked;
+static bool _inIsr;
+static unsigned long _isrCount;
+static unsigned long _isrDelayMicros;
+
+static void serviceTimer()
+{
+    if (_interruptsBlocked || _inIsr)
+        return;
+
+    static const struct { uint8_t bit; void (*vector)(); } channels[] = {
+        { OCF1A, mockTimer1CompA }, { OCF1B, mockTimer1CompB }, { OCF1C, mockTimer1CompC }
+    };
+    for (byte i = 0; i < 3; i++)
+    {
+        uint8_t mask = _BV(channels[i].bit);
+        if (!(TIFR1.value & mask) || !(TIMSK1 & mask) || !channels[i].vector)
+            continue;
+
+        TIFR1.value &= ~mask; //hardware clears the flag on entry
+        _inIsr = true;
+        _isrCount++;
+        channels[i].vector();
+        _inIsr = false;
+    }
+}
+
+static void tick()
+{
+    //free running from reset, the steppers only start the prescaler once per power up
+    TCNT1 = TCNT1 + 1;
+    if (TCNT1 == OCR1A)
+        TIFR1.value |= _BV(OCF1A);
+    if (TCNT1 == OCR1B)
+        TIFR1.value |= _BV(OCF1B);
+    if (TCNT1 == OCR1C)
+        TIFR1.value |= _BV(OCF1C);
+    if (_tickHook)
+        _tickHook();
+    serviceTimer();
+}
+
+void mockAdvance(unsigned long us)
+{
+    while (us--)
+    {
+        _clock++;
+        if (++_tickPhase == 4)
+        {
+            _tickPhase = 0;
+            tick();
+        }
+    }
+}
+
+void mockReset()
+{
+    _clock = 0;
+    _tickPhase = 0;
+    TCNT1 = OCR1A = OCR1B = OCR1C = 0;
+    TIMSK1 = TCCR1A = TCCR1B = 0;
+    TIFR1.value = 0;
+    memset(_pins, 0, sizeof(_pins));
+    _edges.clear();
+    _tickHook = 0;
+    _interruptsBlocked = false;
+    _inIsr = false;
+    _isrCount = 0;
+    _isrDelayMicros = 0;
+}
+
+void mockSetPin(uint8_t pin, uint8_t level)
+{
+    if (pin < MOCK_PIN_COUNT)
+        _pins[pin] = level ? HIGH : LOW;
+}
+
+void mockSetTickHook(void (*hook)())
+{
+    _tickHook = hook;
+}
+
+void mockBlockInterrupts(bool blocked)
+{
+    _interruptsBlocked = blocked;
+    if (!blocked)
+        serviceTimer(); //anything that matched meanwhile runs now
+}
+
+bool mockInIsr()
+{
+    return _inIsr;
+}
+
+unsigned long mockIsrCount()
+{
+    return _isrCount;
+}
+
+unsigned long mockIsrDelayMicros()
+{
+    return _isrDelayMicros;
+}
+
+const MockEdge *mockEdges()
+{
+    return _edges.empty() ? 0 : &_edges[0];
+}
+
+unsigned long mockEdgeCount()
+{
+    return _edges.size();
+}
+
+void mockClearEdges()
+{
+    _edges.clear();
+}
+
+unsigned long micros()
+{
+    return _clock;
+}
+
+unsigned long millis()
+{
+    return _clock / 1000ul;
+}
+
+void delay(unsigned long ms)
+{
+    mockAdvance(ms * 1000ul);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    if (_inIsr)
+        _isrDelayMicros += us;
+    mockAdvance(us); //inside an ISR the matches wait for it to return, as on the chip
+}
+
+void noInterrupts()
+{
+}
+
+void interrupts()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    if (pin < MOCK_PIN_COUNT && mode == INPUT_PULLUP)
+        _pins[pin] = HIGH;
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+    if (pin >= MOCK_PIN_COUNT)
+        return;
+
+    level = level ? HIGH : LOW;
+    if (_pins[pin] == level)
+        return;
+    _pins[pin] = level;
+    MockEdge edge = { _clock, pin, level };
+    _edges.push_back(edge);
+}
+
+int digitalRead(uint8_t pin)
+{
+    return pin < MOCK_PIN_COUNT ? _pins[pin] : LOW;
+}
+
+//every pin gets a port of its own at bit 0, writes through these aren't traced
+volatile uint8_t *portOutputRegister(uint8_t port)
+{
+    return &_ports[port];
+}
+
+volatile uint8_t *portInputRegister(uint8_t port)
+{
+    return &_ports[port];
+}
+
+uint8_t digitalPinToPort(uint8_t pin)
+{
+    return pin < MOCK_PIN_COUNT ? pin : 0;
+}
+
+uint8_t digitalPinToBitMask(uint8_t pin)
+{
+    (void)pin;
+    return 1;
+}
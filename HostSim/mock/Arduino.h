@@ -0,0 +1,114 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+/**
+ * Host stand-in for the parts of the Arduino core and ATmega2560 the sketch libraries use.
+ *
+ * Time only moves when the test moves it: mockAdvance() runs a virtual micros() clock, ticks Timer1
+ * at 4uS like the /64 prescaler and calls the compare ISRs on a match. delay() and delayMicroseconds()
+ * advance the same clock. Every pin write is recorded with its time so tests can check edge timings.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+
+#ifndef __AVR__
+#define __AVR__ 1 //build the Timer1 paths, the registers below stand in for the hardware
+#endif
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define _BV(b) (1 << (b))
+
+#define MOCK_PIN_COUNT 70
+
+//Timer1, writing a 1 to a TIFR1 bit clears that flag like on the chip
+struct MockFlagRegister
+{
+    uint8_t value;
+    MockFlagRegister &operator=(uint8_t clear) { value &= ~clear; return *this; }
+    operator uint8_t() const { return value; }
+};
+extern volatile uint16_t TCNT1, OCR1A, OCR1B, OCR1C;
+extern volatile uint8_t TIMSK1, TCCR1A, TCCR1B;
+extern MockFlagRegister TIFR1;
+#define OCIE1A 1
+#define OCIE1B 2
+#define OCIE1C 3
+#define OCF1A 1
+#define OCF1B 2
+#define OCF1C 3
+#define CS10 0
+#define CS11 1
+#define CS12 2
+
+#define ISR(vector) void vector()
+#define TIMER1_COMPA_vect mockTimer1CompA
+#define TIMER1_COMPB_vect mockTimer1CompB
+#define TIMER1_COMPC_vect mockTimer1CompC
+
+unsigned long micros();
+unsigned long millis();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+volatile uint8_t *portOutputRegister(uint8_t port);
+volatile uint8_t *portInputRegister(uint8_t port);
+uint8_t digitalPinToPort(uint8_t pin);
+uint8_t digitalPinToBitMask(uint8_t pin);
+
+void noInterrupts();
+void interrupts();
+
+//serial port interface as the libraries use it, tests supply the other end
+class Stream
+{
+  public:
+    virtual ~Stream() {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t written = 0;
+        while (size--)
+            written += write(*buffer++);
+        return written;
+    }
+};
+
+//simulation control
+struct MockEdge
+{
+    unsigned long time; //uS on the virtual clock
+    byte pin;
+    byte level;
+};
+
+void mockReset(); //clock, timer, pins and trace back to power on
+void mockAdvance(unsigned long us); //run the clock, servicing Timer1 matches as they happen
+void mockSetPin(uint8_t pin, uint8_t level); //drive an input, not recorded in the trace
+void mockSetTickHook(void (*hook)()); //called every timer tick, e.g. to close a switch at some position
+void mockBlockInterrupts(bool blocked); //hold off the ISRs like a long critical section, matches stay pending
+bool mockInIsr();
+unsigned long mockIsrCount();
+unsigned long mockIsrDelayMicros(); //time ISRs spent in delayMicroseconds(), busy waiting with interrupts off
+const MockEdge *mockEdges(); //every pin change since mockReset()
+unsigned long mockEdgeCount();
+void mockClearEdges();
+
+#include "DigitalWriteFast.h"
+
+#endif
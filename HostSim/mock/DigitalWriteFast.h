@@ -0,0 +1,13 @@
+#ifndef __digitalWriteFast_h_
+#define __digitalWriteFast_h_ 1
+
+/**
+ * Host stand-in for DigitalWriteFast.h. Arduino.h pulls this in first and the include guard matches
+ * the real library's, so the sketch's copy is skipped and fast pin access lands in the recorded pins.
+ */
+
+#define digitalWriteFast(P, V) digitalWrite((P), (V))
+#define digitalReadFast(P) digitalRead((P))
+#define pinModeFast(P, V) pinMode((P), (V))
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef util_atomic_h
+#define util_atomic_h
+
+//ISRs only run from mockAdvance() so nothing can interrupt a block, it just runs once
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (int _atomicOnce = 1; _atomicOnce; _atomicOnce = 0)
+
+#endif
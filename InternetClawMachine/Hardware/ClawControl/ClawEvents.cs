@@ -12,6 +12,7 @@
         EVENT_RETURNED_CENTER = 107,
         EVENT_SCORE_SENSOR = 108,
         EVENT_BELT2_SENSOR = 109,
+        EVENT_POSITION_REACHED = 110,
 
         EVENT_LIMIT_LEFT = 200,
         EVENT_LIMIT_RIGHT = 201,
@@ -725,6 +725,22 @@ namespace InternetClawMachine.Hardware.Skeeball
             return await SendCommandAsync($"mt {controller} {position}");
         }
 
+        public async Task<SkeeballMessageQueueMessage> Retarget(int controller, int position)
+        {
+            if (!IsConnected)
+                return null;
+
+            return await SendCommandAsync($"rt {controller} {position}");
+        }
+
+        public async Task<SkeeballMessageQueueMessage> Jog(int controller, int speed)
+        {
+            if (!IsConnected)
+                return null;
+
+            return await SendCommandAsync($"jog {controller} {speed}");
+        }
+
         public async Task<SkeeballMessageQueueMessage> SetLimit(int controller, int high, int low)
         {
             if (!IsConnected)
@@ -761,6 +777,38 @@ namespace InternetClawMachine.Hardware.Skeeball
             return await SendCommandAsync(str);
         }
 
+        public async Task<SkeeballMessageQueueMessage> HomeAll(int timeout)
+        {
+            if (!IsConnected)
+                return null;
+
+            var str = $"homeall {timeout}";
+            return await SendCommandAsync(str);
+        }
+
+        /// <summary>
+        /// Home from the stored limits at boot or run a full homing, reply is "valid sequence warm"
+        /// </summary>
+        public async Task<SkeeballMessageQueueMessage> SetWarmBoot(bool enabled)
+        {
+            if (!IsConnected)
+                return null;
+
+            var str = $"cal warm {(enabled ? 1 : 0)}";
+            return await SendCommandAsync(str);
+        }
+
+        /// <summary>
+        /// Forget the stored limits, the next boot runs a full homing
+        /// </summary>
+        public async Task<SkeeballMessageQueueMessage> ClearCalibration()
+        {
+            if (!IsConnected)
+                return null;
+
+            return await SendCommandAsync("cal clear");
+        }
+
         public async Task<SkeeballMessageQueueMessage> SetHome(int controller)
         {
             if (!IsConnected)
@@ -26,6 +26,7 @@ namespace InternetClawMachine.Hardware.Skeeball
         EVENT_HOMING_COMPLETE = 406, //
         EVENT_MOVE_STARTED = 407, //movement given started
         EVENT_STARTUP = 408, //Movement controller just booted
+        EVENT_HOMING_ALL_COMPLETE = 410, //homeall finished, result and ms per stepper
 
         EVENT_INFO = 900
     }
@@ -0,0 +1,84 @@
+#include "LedPushCoordinator.h"
+
+LedPushCoordinator::LedPushCoordinator(byte stripCount, unsigned int slotInterval, unsigned int quietTime, unsigned int maxHold)
+{
+    _stripCount = stripCount > 8 ? 8 : stripCount;
+    _dirty = 0;
+    _nextStrip = 0;
+    _slotInterval = slotInterval;
+    _quietTime = quietTime;
+    _maxHold = maxHold;
+    _lastPush = 0;
+    _lastActivity = 0;
+    _holding = false;
+    _holdStart = 0;
+    resetCounters();
+}
+
+void LedPushCoordinator::markDirty(byte strip)
+{
+    if (strip < _stripCount)
+        _dirty |= 1 << strip;
+}
+
+void LedPushCoordinator::noteActivity()
+{
+    _lastActivity = millis();
+}
+
+int LedPushCoordinator::nextPush(unsigned long now)
+{
+    if (!_dirty || now - _lastPush < _slotInterval)
+        return -1;
+
+    noInterrupts();
+    unsigned long lastActivity = _lastActivity;
+    interrupts();
+
+    if (now - lastActivity < _quietTime)
+    {
+        if (!_holding)
+        {
+            _holding = true;
+            _holdStart = now;
+            _deferred++;
+        }
+        if (now - _holdStart < _maxHold)
+            return -1;
+
+        _forced++;
+    }
+    _holding = false;
+
+    byte strip = _nextStrip;
+    while (!(_dirty & (1 << strip)))
+        strip = (strip + 1) % _stripCount;
+
+    _dirty &= ~(1 << strip);
+    _nextStrip = (strip + 1) % _stripCount;
+    _lastPush = now;
+    _pushes++;
+    return strip;
+}
+
+unsigned int LedPushCoordinator::getPushes()
+{
+    return _pushes;
+}
+
+unsigned int LedPushCoordinator::getDeferred()
+{
+    return _deferred;
+}
+
+unsigned int LedPushCoordinator::getForced()
+{
+    return _forced;
+}
+
+void LedPushCoordinator::resetCounters()
+{
+    _pushes = 0;
+    _deferred = 0;
+    _forced = 0;
+}
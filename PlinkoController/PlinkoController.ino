@@ -1,4 +1,8 @@
 #include "FastLED.h"
+#include "SerialLink.h"
+#include "LoopProfiler.h"
+#include "LedPushCoordinator.h"
+#include "SensorClassifier.h"
 
 FASTLED_USING_NAMESPACE
 
@@ -22,9 +26,12 @@ HardwareSerial &mainController = Serial1; //PIN 18 & 19
 #define NUM_LEDS_STAGE_1 59
 #define NUM_LEDS_STAGE_2 46
 
-CRGB leds_stage_1[NUM_LEDS_STAGE_1];
+CRGB leds_stage_1[NUM_LEDS_STAGE_1]; //what goes out, base with the overlays on top
 CRGB leds_stage_2[NUM_LEDS_STAGE_2];
 
+CRGB leds_stage_1_base[NUM_LEDS_STAGE_1]; //patterns draw and fade here
+CRGB leds_stage_2_base[NUM_LEDS_STAGE_2];
+
 CRGB leds_stage_1_rainbow[NUM_LEDS_STAGE_1];
 CRGB leds_stage_2_rainbow[NUM_LEDS_STAGE_2];
 
@@ -33,38 +40,42 @@ CLEDController *controllers[NUM_STRIPS];
 #define BRIGHTNESS         32
 #define FRAMES_PER_SECOND  120
 
+//strips only go out when something drew on them, at most once a frame
+byte _stripsDirty = 0; //bit per controller
+unsigned long _timestampLastFrame = 0;
+const byte _frameInterval = 1000 / FRAMES_PER_SECOND;
+
+//dirty strips go out one per slot and wait for the serial ports to go quiet, see the leds command
+LedPushCoordinator _ledPush(NUM_STRIPS, _frameInterval / NUM_STRIPS, 2, _frameInterval * 4);
+
 
 bool _isDebugMode = false;
 
 const int _numChars = 60;
 
-const byte _slotStage11[] = { 0, 1, 2, 3, 58, 57, 56, 55, 7, 6, 5, 4 };
-const byte _slotStage12[] = { 4, 5, 6, 7, 54, 53, 52, 51, 11, 10, 9, 8 };
-const byte _slotStage13[] = { 8, 9, 10, 11, 50, 49, 48, 47, 15, 14, 13, 12 };
-const byte _slotStage14[] = { 12, 13, 14, 15, 46, 45, 44, 43, 19, 18, 17, 16 };
-const byte _slotStage15[] = { 16, 17, 18, 19, 43, 42, 41, 40, 23, 22, 21, 20 };
-const byte _slotStage16[] = { 20, 21, 22, 23, 39, 38, 37, 36, 27, 26, 25, 24 };
-const byte _slotStage17[] = { 24, 25, 26, 27, 35, 34, 33, 32, 31, 30, 29, 28 };
-
-const byte _slotStage11Size = 12;
-const byte _slotStage12Size = 12;
-const byte _slotStage13Size = 12;
-const byte _slotStage14Size = 12;
-const byte _slotStage15Size = 12;
-const byte _slotStage16Size = 12;
-const byte _slotStage17Size = 12;
-
-const byte _slotStage25[] = { 4, 5, 6, 7, 41, 42, 43, 44, 45, 3, 2, 1, 0 };
-const byte _slotStage24[] = { 8, 9, 10, 11, 37, 38, 39, 40, 7, 6, 5, 4 };
-const byte _slotStage23[] = { 12, 13, 14, 15, 33, 34, 35, 36, 11, 10, 9, 8 };
-const byte _slotStage22[] = { 16, 17, 18, 19, 28, 29, 30, 31, 32, 15, 14, 13, 12 };
-const byte _slotStage21[] = { 20, 21, 22, 23, 24, 25, 26, 27, 28, 19, 18, 17, 16 };
-
-const byte _slotStage21Size = 13;
-const byte _slotStage22Size = 13;
-const byte _slotStage23Size = 12;
-const byte _slotStage24Size = 12;
-const byte _slotStage25Size = 13;
+//every slot's leds in the order a ball would trace them, slots back to back, one table per board
+const byte _pathStage1[] PROGMEM = {
+    0, 1, 2, 3, 58, 57, 56, 55, 7, 6, 5, 4,
+    4, 5, 6, 7, 54, 53, 52, 51, 11, 10, 9, 8,
+    8, 9, 10, 11, 50, 49, 48, 47, 15, 14, 13, 12,
+    12, 13, 14, 15, 46, 45, 44, 43, 19, 18, 17, 16,
+    16, 17, 18, 19, 43, 42, 41, 40, 23, 22, 21, 20,
+    20, 21, 22, 23, 39, 38, 37, 36, 27, 26, 25, 24,
+    24, 25, 26, 27, 35, 34, 33, 32, 31, 30, 29, 28
+};
+const byte _pathStage2[] PROGMEM = {
+    20, 21, 22, 23, 24, 25, 26, 27, 28, 19, 18, 17, 16,
+    16, 17, 18, 19, 28, 29, 30, 31, 32, 15, 14, 13, 12,
+    12, 13, 14, 15, 33, 34, 35, 36, 11, 10, 9, 8,
+    8, 9, 10, 11, 37, 38, 39, 40, 7, 6, 5, 4,
+    4, 5, 6, 7, 41, 42, 43, 44, 45, 3, 2, 1, 0
+};
+const byte _pathStage1Size = 84;
+const byte _pathStage2Size = 63;
+
+//where each scoring slot sits in its board's path, slots 1-7 are stage 1, 8-12 stage 2
+const byte _slotPathStart[] PROGMEM = { 0, 12, 24, 36, 48, 60, 72, 0, 13, 26, 38, 50 };
+const byte _slotPathSize[] PROGMEM = { 12, 12, 12, 12, 12, 12, 12, 13, 13, 12, 12, 13 };
 
 //SCORING 
 const int _PINStage1LatchReset = 24;
@@ -85,29 +96,46 @@ const int _PINStage2Sensor4 = 45;
 const int _PINStage2Sensor5 = 49;
 
 const int EVENT_SCORE_SENSOR = 108; 
-
-unsigned long _timestampStage1ScoreSensor1 = 0;
-unsigned long _timestampStage1ScoreSensor2 = 0;
-unsigned long _timestampStage1ScoreSensor3 = 0;
-unsigned long _timestampStage1ScoreSensor4 = 0;
-unsigned long _timestampStage1ScoreSensor5 = 0;
-unsigned long _timestampStage1ScoreSensor6 = 0;
-unsigned long _timestampStage1ScoreSensor7 = 0;
-
-unsigned long _timestampStage2ScoreSensor1 = 0;
-unsigned long _timestampStage2ScoreSensor2 = 0;
-unsigned long _timestampStage2ScoreSensor3 = 0;
-unsigned long _timestampStage2ScoreSensor4 = 0;
-unsigned long _timestampStage2ScoreSensor5 = 0;
-
-unsigned long _timestampStage1Sensor = 0; //Time we last flashed
-unsigned long _timestampStage2Sensor = 0; //Time we last flashed
-
-byte _stage1SlotFlashing = 0; // handles which slot is flashing in stage 1 - 0 = none
-byte _stage2SlotFlashing = 0; // handles which slot is flashing in stage 2 - 0 = none
-
-byte _stage1FlashesComplete = 0; // handles which slot is flashing in stage 1 - 0 = none
-byte _stage2FlashesComplete = 0; // handles which slot is flashing in stage 2 - 0 = none
+const int EVENT_INFO = 900; //Event to show when we want to pass info back
+
+//loop() stages timed by the profiler, see the perf command
+const byte PERF_MAIN = 0;
+const byte PERF_USB = 1;
+const byte PERF_SENSORS = 2;
+const byte PERF_LIGHTS = 3;
+const byte PERF_FRAME = 4;
+const char *const _perfStageNames[] = { "main", "usb", "sensors", "lights", "frame" };
+LoopProfiler _profiler(_perfStageNames, 5);
+
+//score sensors in slot order, slot number is the index + 1
+struct ScoreSensor
+{
+    byte pin;
+    byte stage; //0 for the top board, 1 for the bottom, picks the latch to clear
+    byte port; //index into _sensorSnapshot, set in initScoreSensors
+    byte mask;
+};
+
+const byte _scoreSensorCount = 12;
+ScoreSensor _scoreSensors[_scoreSensorCount] = {
+    { _PINStage1Sensor1, 0 }, { _PINStage1Sensor2, 0 }, { _PINStage1Sensor3, 0 }, { _PINStage1Sensor4, 0 },
+    { _PINStage1Sensor5, 0 }, { _PINStage1Sensor6, 0 }, { _PINStage1Sensor7, 0 },
+    { _PINStage2Sensor1, 1 }, { _PINStage2Sensor2, 1 }, { _PINStage2Sensor3, 1 }, { _PINStage2Sensor4, 1 },
+    { _PINStage2Sensor5, 1 }
+};
+SensorClassifier<_scoreSensorCount> _scoreClassifier; //hold-off per slot, reports the slot number
+
+//the sensors sit on a handful of ports, each is read once per pass
+const byte _maxSensorPorts = 4;
+volatile uint8_t *_sensorPorts[_maxSensorPorts];
+byte _sensorSnapshot[_maxSensorPorts];
+byte _sensorPortCount = 0;
+unsigned int _sensorsTripped = 0; //bit per slot from the last pass
+
+//latch clears run from loop() instead of holding it up
+const byte _latchResetPins[2] = { _PINStage1LatchReset, _PINStage2LatchReset };
+unsigned long _timestampLatchReset[2] = { 0, 0 }; //when the clear pulse started, 0 when idle
+int _latchResetPulse = 50; //how long to hold a latch in reset
 
 int _scoreSensorDelay = 1000; // how long before we look at a sensor again
 
@@ -117,7 +145,6 @@ byte _fadeBy = 10; //how quick to fade trails
 
 int SENSOR_TRIPPED_STATE = HIGH;
 
-char _sPlinkoIncomingCommand[_numChars]; // an array to store the received data
 char _sUsbPlinkoIncomingCommand[_numChars];
 
 byte _redColor = 255;
@@ -126,58 +153,54 @@ byte _greenColor = 0;
 bool _showRainbow = false;
 bool _staticRainbow = false;
 
-// TRACER DISPLAY VARIABLES
-bool _tracerEnabled = false;
-bool _wasTracertEnabled = false;
-int _tracerStage1Index = 0;
-int _tracerStage2Index = 0;
-byte _tracerStage1Dir = 0;
-byte _tracerStage2Dir = 0;
-unsigned long _timestampTacer = 0;
-
-//U Tracer
-bool _utracerEnabled = false;
-bool _wasuTracertEnabled = false;
-byte _utracerStage1Index = 0;
-byte _utracerStage2Index = 0;
-byte _utracerStage1Dir = 0;
-byte _utracerStage2Dir = 0;
-int _utracerStage1SlotIndex = 0;
-int _utracerStage2SlotIndex = 0;
-unsigned long _timestampuTacer = 0;
-
-
-//Reverse U Tracer
-bool _urtracerEnabled = false;
-bool _wasurTracertEnabled = false;
-byte _urtracerStage1Index = 0;
-byte _urtracerStage2Index = 0;
-byte _urtracerStage1Dir = 0;
-byte _urtracerStage2Dir = 0;
-int _urtracerStage1SlotIndex = 0;
-int _urtracerStage2SlotIndex = 0;
-unsigned long _timestampurTacer = 0;
-
-// BLINK ALL DISPLAY VARIABLES
-bool _blinkAllEnabled = false;
-bool _wasBlinkAllEnabled = false;
-unsigned long _timestampLastBlinkedAll = 0;
-bool _blinkAllOn = false;
-
-char _lastPlinkoMessage[40]; //plinko message
-unsigned long _waitForAckTimestamp = 0; //time we sent last plinko message
-byte _waitForAckCount = 0;
+/*
+  EFFECT LAYERS - patterns sit in the base buffer and fade, overlays are drawn over the base every frame
+  so a slot can flash without stopping whatever pattern is running
+*/
+const byte LAYER_NONE = 0;
+const byte LAYER_TRACER = 1; //one lit pixel bouncing along a path, leaves a fading trail
+const byte LAYER_BLINK = 2; //whole strip on and off
+const byte LAYER_SLOT_FLASH = 3; //a slot on and off over whatever is under it
+
+const byte PRIORITY_PATTERN = 0;
+const byte PRIORITY_OVERLAY = 1;
+
+const byte STYLE_NORMAL = 0;
+const byte STYLE_REVERSE = 1; //opposite hue and swapped red/blue
+
+struct EffectLayer
+{
+    byte kind;
+    byte strip; //controller index
+    byte priority;
+    byte style;
+    const byte *path; //PROGMEM led indexes, 0 walks the strip in order
+    byte start; //first entry of path used
+    byte length; //entries used
+    int position;
+    char direction;
+    byte steps; //overlays: toggles left, on while even
+    bool on;
+    unsigned int interval; //ms between steps
+    unsigned long timestampStep;
+};
+
+const byte _maxLayers = 6;
+EffectLayer _layers[_maxLayers];
+byte _overlayStrips = 0; //strips that had an overlay last frame, redrawn once more when it ends
+
+SerialLink _mainLink(mainController); //framed link to the main controller
 
 uint8_t gHue = 0; // rotating "base color" used by many of the patterns
-const char RTS = '{'; //request to send data
-const char CS = '}'; //complete send data
-const char CTS = '!'; //clear to send data
+const char RTS = '{'; //start of a usb command
+const char CS = '}'; //end of a usb command
 
 void setup() {
     delay(2000);
   
     mainController.begin(250000);
     usbController.begin(115200);
+    _mainLink.setReceiveHandler(handleSerialCommand);
 
     // tell FastLED about the LED strip configuration
     controllers[0] = &FastLED.addLeds<LED_TYPE,DATA_PIN_STAGE_1,COLOR_ORDER>(leds_stage_1, NUM_LEDS_STAGE_1).setCorrection(TypicalLEDStrip);
@@ -197,38 +220,42 @@ void loop()
     }
 
 
+    _profiler.beginLoop();
+
     handlePlinkoSerialCommands();
+    _profiler.mark(PERF_MAIN);
     handleUsbSerialCommands();
-    handleSlotFlashing();
+    _profiler.mark(PERF_USB);
     checkScoreSensors();
+    _profiler.mark(PERF_SENSORS);
 
-    runTracer();
-    runUTracer();
-    runURTracer();
-    runFlashAll();
+    //patterns step and fade once a frame so their speed doesn't depend on how fast loop() runs
+    if (millis() - _timestampLastFrame >= _frameInterval)
+    {
+        _timestampLastFrame = millis();
 
-    EVERY_N_MILLISECONDS( 20 ) { gHue++; } // slowly cycle the "base color" through the rainbow
+        runEffects();
 
+        EVERY_N_MILLISECONDS( 20 ) { gHue++; } // slowly cycle the "base color" through the rainbow
+        _profiler.mark(PERF_LIGHTS);
 
-    FastLED.delay(8);
+        queueDirtyStrips();
+    }
+    showNextStrip();
+    _profiler.mark(PERF_FRAME);
 
+    _profiler.endLoop();
 }
 
 void initScoreSensors()
 {
-    pinMode(_PINStage1Sensor1, INPUT);
-    pinMode(_PINStage1Sensor2, INPUT);
-    pinMode(_PINStage1Sensor3, INPUT);
-    pinMode(_PINStage1Sensor4, INPUT);
-    pinMode(_PINStage1Sensor5, INPUT);
-    pinMode(_PINStage1Sensor6, INPUT);
-    pinMode(_PINStage1Sensor7, INPUT);
-
-    pinMode(_PINStage2Sensor1, INPUT);
-    pinMode(_PINStage2Sensor2, INPUT);
-    pinMode(_PINStage2Sensor3, INPUT);
-    pinMode(_PINStage2Sensor4, INPUT);
-    pinMode(_PINStage2Sensor5, INPUT);
+    for (byte i=0; i < _scoreSensorCount; i++)
+    {
+        ScoreSensor &sensor = _scoreSensors[i];
+        pinMode(sensor.pin, INPUT);
+        sensor.port = registerSensorPort(sensor.pin, sensor.mask);
+        _scoreClassifier.setSensor(i, i + 1, 0, _scoreSensorDelay);
+    }
 
     pinMode(_PINStage1LatchReset, OUTPUT);
     pinMode(_PINStage2LatchReset, OUTPUT);
@@ -236,6 +263,41 @@ void initScoreSensors()
     digitalWrite(_PINStage2LatchReset, HIGH);
 }
 
+//remember which register and bit a sensor pin lives on, returns its index in _sensorSnapshot
+byte registerSensorPort(byte pin, byte &mask)
+{
+    volatile uint8_t *port = portInputRegister(digitalPinToPort(pin));
+    mask = digitalPinToBitMask(pin);
+
+    for (byte i=0; i < _sensorPortCount; i++)
+    {
+        if (_sensorPorts[i] == port)
+            return i;
+    }
+
+    if (_sensorPortCount >= _maxSensorPorts) //out of room, fall back to sharing the last slot
+        return _maxSensorPorts - 1;
+
+    _sensorPorts[_sensorPortCount] = port;
+    return _sensorPortCount++;
+}
+
+//read every sensor port once and pack the results into a bit per slot
+unsigned int sampleScoreSensors()
+{
+    for (byte i=0; i < _sensorPortCount; i++)
+        _sensorSnapshot[i] = *_sensorPorts[i];
+
+    unsigned int tripped = 0;
+    for (byte i=0; i < _scoreSensorCount; i++)
+    {
+        bool high = _sensorSnapshot[_scoreSensors[i].port] & _scoreSensors[i].mask;
+        if (high == (SENSOR_TRIPPED_STATE == HIGH))
+            tripped |= 1 << i;
+    }
+    return tripped;
+}
+
 
 /**
  *
@@ -247,305 +309,77 @@ void checkScoreSensors()
     static unsigned long curTime = 0;
     curTime = millis();
 
-    if (digitalRead(_PINStage1Sensor1) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage1Sensor1);
-        debugLine(".");
-       
-        if (curTime - _timestampStage1ScoreSensor1 > _scoreSensorDelay)
-        {
-            _timestampStage1ScoreSensor1 = curTime;
-            triggerFlashing(1);
-            sendScoreSensorClear(_PINStage1LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "1");
-        }
-    }
+    releaseScoreSensorClear(curTime);
 
-    if (digitalRead(_PINStage1Sensor2) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage1Sensor2);
-        debugLine(".");
-       
-        if (curTime - _timestampStage1ScoreSensor2 > _scoreSensorDelay)
-        {
-            _timestampStage1ScoreSensor2 = curTime;
-            triggerFlashing(2);
-            sendScoreSensorClear(_PINStage1LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "2");
-        }
-    }
+    unsigned int tripped = sampleScoreSensors();
+    unsigned int changed = tripped ^ _sensorsTripped; //only slots that tripped or cleared
+    _sensorsTripped = tripped;
 
-    if (digitalRead(_PINStage1Sensor3) == SENSOR_TRIPPED_STATE)
+    for (byte i=0; changed && i < _scoreSensorCount; i++)
     {
-        debugString("sensor hit ");
-        debugString(_PINStage1Sensor3);
-        debugLine(".");
-       
-        if (curTime - _timestampStage1ScoreSensor3 > _scoreSensorDelay)
-        {
-            _timestampStage1ScoreSensor3 = curTime;
-            triggerFlashing(3);
-            sendScoreSensorClear(_PINStage1LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "3");
-        }
-    }
+        unsigned int bit = 1 << i;
+        if (!(changed & bit))
+            continue;
 
-    if (digitalRead(_PINStage1Sensor4) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage1Sensor4);
-        debugLine(".");
-       
-        if (curTime - _timestampStage1ScoreSensor4 > _scoreSensorDelay)
+        if (tripped & bit)
         {
-            _timestampStage1ScoreSensor4 = curTime;
-            triggerFlashing(4);
-            sendScoreSensorClear(_PINStage1LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "4");
-        }
-    }
+            debugString("sensor hit ");
+            debugString(_scoreSensors[i].pin);
+            debugLine(".");
 
-    if (digitalRead(_PINStage1Sensor5) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage1Sensor5);
-        debugLine(".");
-       
-        if (curTime - _timestampStage1ScoreSensor5 > _scoreSensorDelay)
-        {
-            _timestampStage1ScoreSensor5 = curTime;
-            triggerFlashing(5);
-            sendScoreSensorClear(_PINStage1LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "5");
+            //clear the latch on every trip, a hit inside the hold-off would otherwise leave it set and the slot dead
+            sendScoreSensorClear(_scoreSensors[i].stage);
         }
+        _scoreClassifier.sample(i, tripped & bit, curTime);
     }
 
-    if (digitalRead(_PINStage1Sensor6) == SENSOR_TRIPPED_STATE)
+    while (_scoreClassifier.available())
     {
-        debugString("sensor hit ");
-        debugString(_PINStage1Sensor6);
-        debugLine(".");
-       
-        if (curTime - _timestampStage1ScoreSensor6 > _scoreSensorDelay)
-        {
-            _timestampStage1ScoreSensor6 = curTime;
-            triggerFlashing(6);
-            sendScoreSensorClear(_PINStage1LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "6");
-        }
-    }
+        int slot = _scoreClassifier.read();
+        char strSlot[4];
+        itoa(slot, strSlot, 10);
 
-    if (digitalRead(_PINStage1Sensor7) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage1Sensor7);
-        debugLine(".");
-       
-        if (curTime - _timestampStage1ScoreSensor7 > _scoreSensorDelay)
-        {
-            _timestampStage1ScoreSensor7 = curTime;
-            triggerFlashing(7);
-            sendScoreSensorClear(_PINStage1LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "7");
-        }
-    }
-
-
-    // STAGE 2
-
-
-
-    if (digitalRead(_PINStage2Sensor1) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage2Sensor1);
-        debugLine(".");
-       
-        if (curTime - _timestampStage2ScoreSensor1 > _scoreSensorDelay)
-        {
-            _timestampStage2ScoreSensor1 = curTime;
-            triggerFlashing(8);
-            sendScoreSensorClear(_PINStage2LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "8");
-        }
-    }
-
-    if (digitalRead(_PINStage2Sensor2) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage2Sensor2);
-        debugLine(".");
-       
-        if (curTime - _timestampStage2ScoreSensor2 > _scoreSensorDelay)
-        {
-            _timestampStage2ScoreSensor2 = curTime;
-            triggerFlashing(9);
-            sendScoreSensorClear(_PINStage2LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "9");
-        }
+        triggerFlashing(slot);
+        sendSerialEvent(EVENT_SCORE_SENSOR, strSlot);
     }
+}
 
-    if (digitalRead(_PINStage2Sensor3) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage2Sensor3);
-        debugLine(".");
-       
-        if (curTime - _timestampStage2ScoreSensor3 > _scoreSensorDelay)
-        {
-            _timestampStage2ScoreSensor3 = curTime;
-            triggerFlashing(10);
-            sendScoreSensorClear(_PINStage2LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "10");
-        }
-    }
+//start clearing the flipflop holding the tripped slots for a stage, released in releaseScoreSensorClear
+void sendScoreSensorClear(byte stage)
+{
+    if (_timestampLatchReset[stage])
+        return; //already clearing
 
-    if (digitalRead(_PINStage2Sensor4) == SENSOR_TRIPPED_STATE)
-    {
-        debugString("sensor hit ");
-        debugString(_PINStage2Sensor4);
-        debugLine(".");
-       
-        if (curTime - _timestampStage2ScoreSensor4 > _scoreSensorDelay)
-        {
-            _timestampStage2ScoreSensor4 = curTime;
-            triggerFlashing(11);
-            sendScoreSensorClear(_PINStage2LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "11");
-        }
-    }
+    digitalWrite(_latchResetPins[stage], LOW);
+    _timestampLatchReset[stage] = millis();
+}
 
-    if (digitalRead(_PINStage2Sensor5) == SENSOR_TRIPPED_STATE)
+void releaseScoreSensorClear(unsigned long curTime)
+{
+    for (byte i=0; i < 2; i++)
     {
-        debugString("sensor hit ");
-        debugString(_PINStage2Sensor5);
-        debugLine(".");
-       
-        if (curTime - _timestampStage2ScoreSensor5 > _scoreSensorDelay)
+        if (_timestampLatchReset[i] && curTime - _timestampLatchReset[i] >= _latchResetPulse)
         {
-            _timestampStage2ScoreSensor5 = curTime;
-            triggerFlashing(12);
-            sendScoreSensorClear(_PINStage2LatchReset);
-            sendSerialEvent(EVENT_SCORE_SENSOR, "12");
+            digitalWrite(_latchResetPins[i], HIGH);
+            _timestampLatchReset[i] = 0;
         }
     }
 }
 
-//set clear to the flipflop holding the tripped slots
-void sendScoreSensorClear(int pin)
-{
-    digitalWrite(pin, LOW);
-    delay(50);
-    digitalWrite(pin, HIGH);
-}
-
 /*
 
   SERIAL HANDLING
 
 */
 
-void notifyMainControllerMessage()
-{
-    _waitForAckTimestamp = millis();
-    mainController.print(RTS);
-    mainController.flush();
-}
-
 void sendMainControllerMessage(char message[])
 {
-    notifyMainControllerMessage();
-    strncpy(_lastPlinkoMessage, message, strlen(message)+1);
-    
-}
-
-void sendMainControllerData(char message[])
-{
-    mainController.print(message);
-    mainController.print(CS);
+    _mainLink.send(message);
 }
 
-
-//command from plinko is ".command args!"
 void handlePlinkoSerialCommands()
 {
-    //if we sent a message but didn't receive an ACK then send again
-    if (_waitForAckTimestamp && millis() - _waitForAckTimestamp > 300)
-    {
-        _waitForAckCount++;
-        notifyMainControllerMessage();
-    }
-            
-    if (_waitForAckCount > 5) //give up after 5 attempts
-    {
-        _waitForAckTimestamp = 0;
-        _waitForAckCount = 0;
-    }
-
-    static byte sidx = 0; //serial cursor
-    static unsigned long startTime = 0; //memory placeholder
-
-
-
-    startTime = millis();
-
-    //if we have data, read it
-    while(mainController.available() > 0) //burns through the buffer waiting for a start byte
-    {
-        char thisChar = mainController.read();
-        if (thisChar == RTS)
-        {
-            mainController.print(CTS);
-            mainController.flush();
-
-            
-
-            //reset the index
-            sidx = 0;
-
-            while (millis() - startTime < 300) //wait up to 300ms for next byte
-            {
-                if (mainController.available() <= 0) //if nothing new.. continue
-                    continue;
-                
-
-                startTime = millis(); //update received timestamp, allows slow data to come in (manually typing)
-                thisChar = mainController.read();
-                if (thisChar == RTS)
-                    continue;
-                if (thisChar == CS) //if we receive a proper ending, process the data
-                {
-                    while (mainController.available() > 0) //burns the buffer
-                        mainController.read();
-
-                    _sPlinkoIncomingCommand[sidx] = '\0'; //terminate string
-
-                    //ADD COMMAND HANDLER
-                    handleSerialCommand(_sPlinkoIncomingCommand);
-                    break; //jump out
-                } else {
-                    //save our byte1
-                    _sPlinkoIncomingCommand[sidx] = thisChar;
-                    sidx++;
-                    
-                    //prevent overlfow and reset to our last byte
-                    if (sidx >= _numChars) {
-                        sidx = _numChars - 1;
-                    }
-                }
-            }
-            //we either processed data from a successful command or the command timed out
-        }
-        else if (thisChar == CTS)
-        {
-            _waitForAckCount = 0;
-            _waitForAckTimestamp = 0;
-
-            sendMainControllerData(_lastPlinkoMessage);
-        }
-    }
+    _mainLink.poll();
 }
 
 void handleUsbSerialCommands()
@@ -604,10 +438,33 @@ void handleSerialCommand(char *incomingData)
     static char argument2[_numChars]= {0}; //holds the axis
     static char argument3[_numChars]= {0}; //holds the axis
 
-    sscanf(incomingData, "%s %s %s %s", command, argument1,argument2, argument3);
+    //arguments keep old values when not sent so check the count
+    int fieldCount = sscanf(incomingData, "%s %s %s %s", command, argument1,argument2, argument3);
 
     if (strcmp(command,"dbg") == 0) { //debug
        _isDebugMode = !_isDebugMode;
+    } else if (strcmp(command,"perf") == 0) { //loop timing: "perf on|off" to run the profiler, "perf" for the whole loop, "perf n" for stage n
+        char outputData[_numChars];
+        if (strcmp(argument1,"on") == 0 || strcmp(argument1,"off") == 0)
+        {
+            _profiler.setEnabled(strcmp(argument1,"on") == 0);
+            sprintf(outputData, "%i", _profiler.isEnabled());
+        }
+        else
+        {
+            byte stage = fieldCount > 1 ? atoi(argument1) : _profiler.getStageCount();
+            if (!_profiler.format(stage, outputData, _numChars))
+                sprintf(outputData, "%i", _profiler.getStageCount());
+        }
+        sendSerialEvent(EVENT_INFO, outputData);
+    } else if (strcmp(command,"perfreset") == 0) { //clear loop timing stats
+        _profiler.reset();
+    } else if (strcmp(command,"leds") == 0) { //led push stats: pushes,deferred,forced,crcErrors,dropped,failed, "leds reset" clears them
+        char outputData[_numChars];
+        if (strcmp(argument1,"reset") == 0)
+            _ledPush.resetCounters();
+        sprintf(outputData, "%u,%u,%u,%u,%u,%u", _ledPush.getPushes(), _ledPush.getDeferred(), _ledPush.getForced(), _mainLink.getCrcErrors(), _mainLink.getDropped(), _mainLink.getFailed());
+        sendSerialEvent(EVENT_INFO, outputData);
     } else if (strcmp(command,"b") == 0) { //blink a specific slot
         int arg = atoi(argument1);
         showSlot(arg);
@@ -625,16 +482,7 @@ void handleSerialCommand(char *incomingData)
         digitalWrite(pin, arg);
     } else if (strcmp(command,"r") == 0) { //restart machine
         int stage = atoi(argument1);
-        if (stage == 1)
-        {
-            digitalWrite(_PINStage1LatchReset, LOW);
-            delay(100);
-            digitalWrite(_PINStage1LatchReset, HIGH);
-        } else {
-            digitalWrite(_PINStage2LatchReset, LOW);
-            delay(100);
-            digitalWrite(_PINStage2LatchReset, HIGH);
-        }
+        sendScoreSensorClear(stage == 1 ? 0 : 1);
     } else if (strcmp(command,"sc") == 0) { //set colors
         int r = atoi(argument1);
         int g = atoi(argument2);
@@ -675,8 +523,6 @@ void handleSerialCommand(char *incomingData)
             default: //disable patterns
             //case 0: 
                 stopAllPatterns();
-                setAll(0, 0, 0, 0);
-                setAll(1, 0, 0, 0);
                 break;
         }
     }
@@ -685,8 +531,9 @@ void handleSerialCommand(char *incomingData)
 
 void sendSerialEvent(int eventId, char outputData[])
 {
-    sprintf(_lastPlinkoMessage, "%i %s", eventId, outputData);
-    sendMainControllerMessage(_lastPlinkoMessage);
+    char message[_numChars];
+    snprintf(message, _numChars, "%i %s", eventId, outputData);
+    sendMainControllerMessage(message);
     debugString("TX: ");
     debugString(eventId);
     debugString(" ");
@@ -706,945 +553,314 @@ void sendSerialEvent(int eventId, char outputData[])
  * ***************** *
 */
 
-void restartPatterns()
+//stop the base patterns and blank the strips, slot flashes keep going
+void stopAllPatterns()
 {
-    if (_wasTracertEnabled)
-    {
-        startTracer();
-    } else if (_wasBlinkAllEnabled)
-    {
-        startFlashAll();
-    } else if (_wasuTracertEnabled)
-    {
-        startUTracer();
-    } else if (_wasurTracertEnabled)
+    for (byte i = 0; i < _maxLayers; i++)
     {
-        startURTracer();
+        if (_layers[i].priority == PRIORITY_PATTERN)
+            _layers[i].kind = LAYER_NONE;
     }
-}
-void stopAllPatterns()
-{
-    stopTracer();
-    stopFlashAll();
-    stopUTracer();
-    stopURTracer();
     setAll(0, 0, 0, 0);
     setAll(1, 0, 0, 0);
 }
 
-void startURTracer()
-{
-    _wasurTracertEnabled = false;
-    _urtracerEnabled = true;
-    //UR TRACERT INIT
-    _urtracerStage1Index = 7;
-    _urtracerStage1SlotIndex = _slotStage17Size;
-    _urtracerStage2Index = 5;
-    _urtracerStage2SlotIndex = _slotStage25Size;
-    _urtracerStage1Dir = 1;
-    _urtracerStage2Dir = 1;
-
-    //U TRACER INIT
-    _utracerStage1Index = 1;
-    _utracerStage2Index = 1;
-    _utracerStage1SlotIndex = 0;
-    _utracerStage2SlotIndex = 0;
-    _utracerStage1Dir = -1;
-    _utracerStage2Dir = -1;
-
-    runURTracer();
-}
-
-
-void stopURTracer()
-{
-    _urtracerEnabled = false;
-}
-
-void runURTracer()
+//free layer, 0 if every one is in use
+EffectLayer *addLayer(byte kind, byte strip, byte priority)
 {
-    if (!_urtracerEnabled)
-        return;
-
-    
-    fadeToBlackBy(leds_stage_1, NUM_LEDS_STAGE_1, _fadeBy);
-    fadeToBlackBy(leds_stage_2, NUM_LEDS_STAGE_2, _fadeBy);
-
-    if (millis() - _timestampurTacer < 50)
-        return;
-
-    _timestampurTacer = millis();
-
-    realRunUTracer();
-
-    int displayIndex1 = 0; // -1 means we reached the end of a slot moving forward, -2 means we reached the start of a slot going in reverse
-    int displayIndex2 = 0;
-    switch (_urtracerStage1Index)
+    for (byte i = 0; i < _maxLayers; i++)
     {
-        case 1:
-            displayIndex1 = getNextURTracerLed1(_slotStage11, _slotStage11Size, _slotStage11Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextURTracerLed1(_slotStage12, _slotStage12Size, _slotStage11Size);
-            else if (displayIndex1 == -2)
-            {
-                //we reached the beginning going in reverse, swap directions
-                _urtracerStage1Index = 1;
-                _urtracerStage1Dir = 0;
-                _urtracerStage1SlotIndex = -1;
-                displayIndex1 = getNextURTracerLed1(_slotStage11, _slotStage11Size, _slotStage11Size);
-            }
-        break;
-        case 2:
-            displayIndex1 = getNextURTracerLed1(_slotStage12, _slotStage12Size, _slotStage11Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextURTracerLed1(_slotStage13, _slotStage13Size, _slotStage12Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextURTracerLed1(_slotStage11, _slotStage11Size, _slotStage11Size);
-        break;
-        case 3:
-            displayIndex1 = getNextURTracerLed1(_slotStage13, _slotStage13Size, _slotStage12Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextURTracerLed1(_slotStage14, _slotStage14Size, _slotStage13Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextURTracerLed1(_slotStage12, _slotStage12Size, _slotStage11Size);
-        break;
-        case 4:
-            displayIndex1 = getNextURTracerLed1(_slotStage14, _slotStage14Size, _slotStage13Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextURTracerLed1(_slotStage15, _slotStage15Size, _slotStage14Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextURTracerLed1(_slotStage13, _slotStage13Size, _slotStage12Size);
-        break;
-        case 5:
-            displayIndex1 = getNextURTracerLed1(_slotStage15, _slotStage15Size, _slotStage14Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextURTracerLed1(_slotStage16, _slotStage16Size, _slotStage15Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextURTracerLed1(_slotStage14, _slotStage14Size, _slotStage13Size);
-        break;
-        case 6:
-            displayIndex1 = getNextURTracerLed1(_slotStage16, _slotStage16Size, _slotStage15Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextURTracerLed1(_slotStage17, _slotStage17Size, _slotStage16Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextURTracerLed1(_slotStage15, _slotStage15Size, _slotStage14Size);
-            
-        break;
-        case 7:
-            displayIndex1 = getNextURTracerLed1(_slotStage17, _slotStage17Size, _slotStage16Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-            {
-                _urtracerStage1Dir = 1; //swap directions
-                _urtracerStage1SlotIndex = _slotStage17Size;
-                _urtracerStage1Index = 7;
-                
-                displayIndex1 = getNextURTracerLed1(_slotStage17, _slotStage17Size, _slotStage16Size);
-                
-            } else if (displayIndex1 == -2)
-            {
-                displayIndex1 = getNextURTracerLed1(_slotStage16, _slotStage16Size, _slotStage15Size);
-            }
-        break;
-        default:
-        break;
-    }
+        EffectLayer &layer = _layers[i];
+        if (layer.kind != LAYER_NONE)
+            continue;
 
-    switch (_urtracerStage2Index)
-    {
-        case 1:
-            displayIndex2 = getNextURTracerLed2(_slotStage21, _slotStage21Size, _slotStage21Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-                displayIndex2 = getNextURTracerLed2(_slotStage22, _slotStage22Size, _slotStage21Size);
-            else if (displayIndex2 == -2)
-            {
-                //we reached the beginning going in reverse, swap directions
-                _urtracerStage2Index = 1;
-                _urtracerStage2Dir = 0;
-                _urtracerStage2SlotIndex = -1;
-                displayIndex2 = getNextURTracerLed2(_slotStage21, _slotStage21Size, _slotStage21Size);
-            }
-        break;
-        case 2:
-            displayIndex2 = getNextURTracerLed2(_slotStage22, _slotStage22Size, _slotStage21Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-                displayIndex2 = getNextURTracerLed2(_slotStage23, _slotStage23Size, _slotStage22Size);
-            else if (displayIndex2 == -2)
-                displayIndex2 = getNextURTracerLed2(_slotStage21, _slotStage21Size, _slotStage21Size);
-        break;
-        case 3:
-            displayIndex2 = getNextURTracerLed2(_slotStage23, _slotStage23Size, _slotStage22Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-                displayIndex2 = getNextURTracerLed2(_slotStage24, _slotStage24Size, _slotStage23Size);
-            else if (displayIndex2 == -2)
-                displayIndex2 = getNextURTracerLed2(_slotStage22, _slotStage22Size, _slotStage21Size);
-        break;
-        case 4:
-            displayIndex2 = getNextURTracerLed2(_slotStage24, _slotStage24Size, _slotStage23Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-                displayIndex2 = getNextURTracerLed2(_slotStage25, _slotStage25Size, _slotStage24Size);
-            else if (displayIndex2 == -2)
-                displayIndex2 = getNextURTracerLed2(_slotStage23, _slotStage23Size, _slotStage22Size);
-        break;
-        case 5:
-            displayIndex2 = getNextURTracerLed2(_slotStage25, _slotStage25Size, _slotStage24Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-            {
-                _urtracerStage2Dir = 1; //swap directions
-                _urtracerStage2SlotIndex = _slotStage25Size;
-                _urtracerStage2Index = 5;
-                
-                displayIndex2 = getNextURTracerLed2(_slotStage25, _slotStage25Size, _slotStage24Size);
-            } else if (displayIndex2 == -2)
-                displayIndex2 = getNextURTracerLed2(_slotStage24, _slotStage24Size, _slotStage23Size);
-        break;
-        default:
-        break;
+        layer.kind = kind;
+        layer.strip = strip;
+        layer.priority = priority;
+        layer.style = STYLE_NORMAL;
+        layer.path = 0;
+        layer.start = 0;
+        layer.length = strip ? NUM_LEDS_STAGE_2 : NUM_LEDS_STAGE_1;
+        layer.position = 0;
+        layer.direction = 1;
+        layer.steps = 0;
+        layer.on = true;
+        layer.interval = 50;
+        layer.timestampStep = millis();
+        return &layer;
     }
-    debugString("u1 - D: ");
-    debugString(_urtracerStage1Dir);
-    debugString(" S: ");
-    debugString(_urtracerStage1Index);
-    debugString(" I: ");
-    debugString(_urtracerStage1SlotIndex);
-    debugString(" L: ");
-    debugString(displayIndex1);
-    debugLine("");
-
-    debugString("u2 - D: ");
-    debugString(_urtracerStage2Dir);
-    debugString(" S: ");
-    debugString(_urtracerStage2Index);
-    debugString(" I: ");
-    debugString(_urtracerStage2SlotIndex);
-    debugString(" L: ");
-    debugString(displayIndex2);
-    debugLine("");
-
-    //display pixel
-    if (_showRainbow)
-    {
-        leds_stage_1[displayIndex1] = CHSV( 255 - gHue, 200, 255);
-        leds_stage_2[displayIndex2] = CHSV( 255 - gHue, 200, 255);
-    } else if (_staticRainbow)
-    {
-        
-        leds_stage_1[displayIndex1].r = leds_stage_1_rainbow[displayIndex1].r;
-        leds_stage_1[displayIndex1].g = leds_stage_1_rainbow[displayIndex1].g;
-        leds_stage_1[displayIndex1].b = leds_stage_1_rainbow[displayIndex1].b;
-
-        leds_stage_2[displayIndex2].r = leds_stage_2_rainbow[displayIndex2].r;
-        leds_stage_2[displayIndex2].g = leds_stage_2_rainbow[displayIndex2].g;
-        leds_stage_2[displayIndex2].b = leds_stage_2_rainbow[displayIndex2].b;
-        
-    } else {
-        setPixel(leds_stage_1[displayIndex1], _blueColor, _greenColor, _redColor);
-        setPixel(leds_stage_2[displayIndex2], _blueColor, _greenColor, _redColor);
-    }
-  
+    return 0;
 }
 
-int getNextURTracerLed1(byte slotStageValues[], int slotStageCurrentSize, int slotStagePrevSize)
+void addTracer(byte strip, const byte *path, byte length, byte style, bool fromEnd)
 {
-    if (_urtracerStage1Dir == 1) //moving in reverse now
-    {
-        _urtracerStage1SlotIndex--;
-        if (_urtracerStage1SlotIndex < 0) //if we've reached the beginning, move to the next slot
-        {
-            _urtracerStage1SlotIndex = slotStagePrevSize;
-            _urtracerStage1Index--;
-            return -2;
-        } else {
-            return slotStageValues[_urtracerStage1SlotIndex]; //return slot value
-        }
-    } else { //moving forward
-        _urtracerStage1SlotIndex++;
-        if (_urtracerStage1SlotIndex >= slotStageCurrentSize) //if we've reached the end, move to the next slot
-        {
-            _urtracerStage1SlotIndex = -1;
-            _urtracerStage1Index++;
-            return -1;
-        }
+    EffectLayer *layer = addLayer(LAYER_TRACER, strip, PRIORITY_PATTERN);
+    if (!layer)
+        return;
 
-        return slotStageValues[_urtracerStage1SlotIndex];
+    layer->path = path;
+    layer->length = length;
+    layer->style = style;
+    if (fromEnd)
+    {
+        layer->position = length - 1;
+        layer->direction = -1;
     }
+    drawLayer(*layer);
 }
 
-int getNextURTracerLed2(byte slotStageValues[], int slotStageCurrentSize, int slotStagePrevSize)
+//pixel bouncing end to end along every led
+void startTracer()
 {
-    if (_urtracerStage2Dir == 1) //moving in reverse now
-    {
-        _urtracerStage2SlotIndex--;
-        if (_urtracerStage2SlotIndex < 0) //if we've reached the beginning, move to the next slot
-        {
-            _urtracerStage2SlotIndex = slotStagePrevSize;
-            _urtracerStage2Index--;
-            return -2;
-        } else {
-            return slotStageValues[_urtracerStage2SlotIndex]; //return slot value
-        }
-    } else { //moving forward
-        _urtracerStage2SlotIndex++;
-        if (_urtracerStage2SlotIndex >= slotStageCurrentSize) //if we've reached the end, move to the next slot
-        {
-            _urtracerStage2SlotIndex = -1;
-            _urtracerStage2Index++;
-            return -1;
-        }
-
-        return slotStageValues[_urtracerStage2SlotIndex];
-    }
+    addTracer(0, 0, NUM_LEDS_STAGE_1, STYLE_NORMAL, false);
+    addTracer(1, 0, NUM_LEDS_STAGE_2, STYLE_NORMAL, false);
 }
 
-
-/*
-
-   U TRACER CODE
-
-*/
-
+//pixel running through each slot in turn and back
 void startUTracer()
 {
-    _wasuTracertEnabled = false;
-    _utracerEnabled = true;
-    _utracerStage1Index = 1;
-    _utracerStage2Index = 1;
-    _utracerStage1SlotIndex = 0;
-    _utracerStage2SlotIndex = 0;
-    _utracerStage1Dir = -1;
-    _utracerStage2Dir = -1;
-    runUTracer();
+    addTracer(0, _pathStage1, _pathStage1Size, STYLE_NORMAL, false);
+    addTracer(1, _pathStage2, _pathStage2Size, STYLE_NORMAL, false);
 }
 
-void runUTracer()
+//u tracer plus a second one in the opposite colors starting from the far end
+void startURTracer()
 {
-    if (!_utracerEnabled)
-        return;
-
-    fadeToBlackBy(leds_stage_1, NUM_LEDS_STAGE_1, _fadeBy);
-    fadeToBlackBy(leds_stage_2, NUM_LEDS_STAGE_2, _fadeBy);
-
-    if (millis() - _timestampuTacer < 50)
-        return;
-
-    _timestampuTacer = millis();
-    realRunUTracer();
-  
-}
-void realRunUTracer()
-{
-    int displayIndex1 = 0; // -1 means we reached the end of a slot moving forward, -2 means we reached the start of a slot going in reverse
-    int displayIndex2 = 0;
-    switch (_utracerStage1Index)
-    {
-        case 1:
-            displayIndex1 = getNextUTracerLed1(_slotStage11, _slotStage11Size, _slotStage11Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextUTracerLed1(_slotStage12, _slotStage12Size, _slotStage11Size);
-            else if (displayIndex1 == -2)
-            {
-                //we reached the beginning going in reverse, swap directions
-                _utracerStage1Index = 1;
-                _utracerStage1Dir = 0;
-                _utracerStage1SlotIndex = -1;
-                displayIndex1 = getNextUTracerLed1(_slotStage11, _slotStage11Size, _slotStage11Size);
-            }
-        break;
-        case 2:
-            displayIndex1 = getNextUTracerLed1(_slotStage12, _slotStage12Size, _slotStage11Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextUTracerLed1(_slotStage13, _slotStage13Size, _slotStage12Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextUTracerLed1(_slotStage11, _slotStage11Size, _slotStage11Size);
-        break;
-        case 3:
-            displayIndex1 = getNextUTracerLed1(_slotStage13, _slotStage13Size, _slotStage12Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextUTracerLed1(_slotStage14, _slotStage14Size, _slotStage13Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextUTracerLed1(_slotStage12, _slotStage12Size, _slotStage11Size);
-        break;
-        case 4:
-            displayIndex1 = getNextUTracerLed1(_slotStage14, _slotStage14Size, _slotStage13Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextUTracerLed1(_slotStage15, _slotStage15Size, _slotStage14Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextUTracerLed1(_slotStage13, _slotStage13Size, _slotStage12Size);
-        break;
-        case 5:
-            displayIndex1 = getNextUTracerLed1(_slotStage15, _slotStage15Size, _slotStage14Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextUTracerLed1(_slotStage16, _slotStage16Size, _slotStage15Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextUTracerLed1(_slotStage14, _slotStage14Size, _slotStage13Size);
-        break;
-        case 6:
-            displayIndex1 = getNextUTracerLed1(_slotStage16, _slotStage16Size, _slotStage15Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-                displayIndex1 = getNextUTracerLed1(_slotStage17, _slotStage17Size, _slotStage16Size);
-            else if (displayIndex1 == -2)
-                displayIndex1 = getNextUTracerLed1(_slotStage15, _slotStage15Size, _slotStage14Size);
-            
-        break;
-        case 7:
-            displayIndex1 = getNextUTracerLed1(_slotStage17, _slotStage17Size, _slotStage16Size);
-            if (displayIndex1 == -1) //if we've reached the end of the line
-            {
-                _utracerStage1Dir = 1; //swap directions
-                _utracerStage1SlotIndex = _slotStage17Size;
-                _utracerStage1Index = 7;
-                
-                displayIndex1 = getNextUTracerLed1(_slotStage17, _slotStage17Size, _slotStage16Size);
-                
-            } else if (displayIndex1 == -2)
-            {
-                displayIndex1 = getNextUTracerLed1(_slotStage16, _slotStage16Size, _slotStage15Size);
-            }
-        break;
-        default:
-        break;
-    }
-
-    switch (_utracerStage2Index)
-    {
-        case 1:
-            displayIndex2 = getNextUTracerLed2(_slotStage21, _slotStage21Size, _slotStage21Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-                displayIndex2 = getNextUTracerLed2(_slotStage22, _slotStage22Size, _slotStage21Size);
-            else if (displayIndex2 == -2)
-            {
-                //we reached the beginning going in reverse, swap directions
-                _utracerStage2Index = 1;
-                _utracerStage2Dir = 0;
-                _utracerStage2SlotIndex = -1;
-                displayIndex2 = getNextUTracerLed2(_slotStage21, _slotStage21Size, _slotStage21Size);
-            }
-        break;
-        case 2:
-            displayIndex2 = getNextUTracerLed2(_slotStage22, _slotStage22Size, _slotStage21Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-                displayIndex2 = getNextUTracerLed2(_slotStage23, _slotStage23Size, _slotStage22Size);
-            else if (displayIndex2 == -2)
-                displayIndex2 = getNextUTracerLed2(_slotStage21, _slotStage21Size, _slotStage21Size);
-        break;
-        case 3:
-            displayIndex2 = getNextUTracerLed2(_slotStage23, _slotStage23Size, _slotStage22Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-                displayIndex2 = getNextUTracerLed2(_slotStage24, _slotStage24Size, _slotStage23Size);
-            else if (displayIndex2 == -2)
-                displayIndex2 = getNextUTracerLed2(_slotStage22, _slotStage22Size, _slotStage21Size);
-        break;
-        case 4:
-            displayIndex2 = getNextUTracerLed2(_slotStage24, _slotStage24Size, _slotStage23Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-                displayIndex2 = getNextUTracerLed2(_slotStage25, _slotStage25Size, _slotStage24Size);
-            else if (displayIndex2 == -2)
-                displayIndex2 = getNextUTracerLed2(_slotStage23, _slotStage23Size, _slotStage22Size);
-        break;
-        case 5:
-            displayIndex2 = getNextUTracerLed2(_slotStage25, _slotStage25Size, _slotStage24Size);
-            if (displayIndex2 == -1) //if we've reached the end of the line
-            {
-                _utracerStage2Dir = 1; //swap directions
-                _utracerStage2SlotIndex = _slotStage25Size;
-                _utracerStage2Index = 5;
-                
-                displayIndex2 = getNextUTracerLed2(_slotStage25, _slotStage25Size, _slotStage24Size);
-            } else if (displayIndex2 == -2)
-                displayIndex2 = getNextUTracerLed2(_slotStage24, _slotStage24Size, _slotStage23Size);
-        break;
-        default:
-        break;
-    }
-    debugString("1 - D: ");
-    debugString(_utracerStage1Dir);
-    debugString(" S: ");
-    debugString(_utracerStage1Index);
-    debugString(" I: ");
-    debugString(_utracerStage1SlotIndex);
-    debugString(" L: ");
-    debugString(displayIndex1);
-    debugLine("");
-
-    debugString("2 - D: ");
-    debugString(_utracerStage2Dir);
-    debugString(" S: ");
-    debugString(_utracerStage2Index);
-    debugString(" I: ");
-    debugString(_utracerStage2SlotIndex);
-    debugString(" L: ");
-    debugString(displayIndex2);
-    debugLine("");
-
-    //display pixel
-    if (_showRainbow)
-    {
-        leds_stage_1[displayIndex1] = CHSV( gHue, 200, 255);
-        leds_stage_2[displayIndex2] = CHSV( gHue, 200, 255);
-    }  else if (_staticRainbow)
-    {
-        leds_stage_1[displayIndex1].r = leds_stage_1_rainbow[displayIndex1].r;
-        leds_stage_1[displayIndex1].g = leds_stage_1_rainbow[displayIndex1].g;
-        leds_stage_1[displayIndex1].b = leds_stage_1_rainbow[displayIndex1].b;
-
-        leds_stage_2[displayIndex2].r = leds_stage_2_rainbow[displayIndex2].r;
-        leds_stage_2[displayIndex2].g = leds_stage_2_rainbow[displayIndex2].g;
-        leds_stage_2[displayIndex2].b = leds_stage_2_rainbow[displayIndex2].b;
-    } else {
-        setPixel(leds_stage_1[displayIndex1], _redColor, _greenColor, _blueColor);
-        setPixel(leds_stage_2[displayIndex2], _redColor, _greenColor, _blueColor);
-    }
+    startUTracer();
+    addTracer(0, _pathStage1, _pathStage1Size, STYLE_REVERSE, true);
+    addTracer(1, _pathStage2, _pathStage2Size, STYLE_REVERSE, true);
 }
 
-int getNextUTracerLed1(byte slotStageValues[], int slotStageCurrentSize, int slotStagePrevSize)
+void startFlashAll()
 {
-    if (_utracerStage1Dir == 1) //moving in reverse now
+    for (byte strip = 0; strip < NUM_STRIPS; strip++)
     {
-        _utracerStage1SlotIndex--;
-        if (_utracerStage1SlotIndex < 0) //if we've reached the beginning, move to the next slot
-        {
-            _utracerStage1SlotIndex = slotStagePrevSize;
-            _utracerStage1Index--;
-            return -2;
-        } else {
-            return slotStageValues[_utracerStage1SlotIndex]; //return slot value
-        }
-    } else { //moving forward
-        _utracerStage1SlotIndex++;
-        if (_utracerStage1SlotIndex >= slotStageCurrentSize) //if we've reached the end, move to the next slot
-        {
-            _utracerStage1SlotIndex = -1;
-            _utracerStage1Index++;
-            return -1;
-        }
+        EffectLayer *layer = addLayer(LAYER_BLINK, strip, PRIORITY_PATTERN);
+        if (!layer)
+            return;
 
-        return slotStageValues[_utracerStage1SlotIndex];
+        layer->interval = 100;
+        layer->on = false;
+        drawLayer(*layer);
     }
 }
 
-int getNextUTracerLed2(byte slotStageValues[], int slotStageCurrentSize, int slotStagePrevSize)
+//flash a scoring slot over whatever is running, replaces a flash already on that board
+void triggerFlashing(int slot)
 {
-    if (_utracerStage2Dir == 1) //moving in reverse now
-    {
-        _utracerStage2SlotIndex--;
-        if (_utracerStage2SlotIndex < 0) //if we've reached the beginning, move to the next slot
-        {
-            _utracerStage2SlotIndex = slotStagePrevSize;
-            _utracerStage2Index--;
-            return -2;
-        } else {
-            return slotStageValues[_utracerStage2SlotIndex]; //return slot value
-        }
-    } else { //moving forward
-        _utracerStage2SlotIndex++;
-        if (_utracerStage2SlotIndex >= slotStageCurrentSize) //if we've reached the end, move to the next slot
-        {
-            _utracerStage2SlotIndex = -1;
-            _utracerStage2Index++;
-            return -1;
-        }
+    if (slot < 1 || slot > _scoreSensorCount)
+        return;
 
-        return slotStageValues[_utracerStage2SlotIndex];
+    byte strip = slot > 7 ? 1 : 0;
+    for (byte i = 0; i < _maxLayers; i++)
+    {
+        if (_layers[i].kind == LAYER_SLOT_FLASH && _layers[i].strip == strip)
+            _layers[i].kind = LAYER_NONE;
     }
-}
 
-void stopUTracer()
-{
-    _utracerEnabled = false;
+    EffectLayer *layer = addLayer(LAYER_SLOT_FLASH, strip, PRIORITY_OVERLAY);
+    if (!layer)
+        return;
+
+    layer->path = strip ? _pathStage2 : _pathStage1;
+    layer->start = pgm_read_byte(&_slotPathStart[slot - 1]);
+    layer->length = pgm_read_byte(&_slotPathSize[slot - 1]);
+    layer->interval = 100;
+    layer->steps = 8;
 }
 
-void startTracer()
+void showSlot(byte slot)
 {
-    _wasTracertEnabled = false;
-    _tracerEnabled = true;
-    _tracerStage1Index = 0;
-    _tracerStage2Index = 0;
-    _tracerStage1Dir = 0;
-    _tracerStage2Dir = 0;
-    runTracer();
+    triggerFlashing(slot);
 }
 
-void stopTracer()
+byte getLayerLed(EffectLayer &layer, int position)
 {
-    _tracerEnabled = false;
+    if (!layer.path)
+        return layer.start + position;
+    return pgm_read_byte(layer.path + layer.start + position);
 }
 
-void runTracer()
+//set one pixel in the current color scheme
+void paintPixel(CRGB &pixel, byte led, byte strip, byte style)
 {
-    if (!_tracerEnabled)
-        return;
-
-    fadeToBlackBy(leds_stage_1, NUM_LEDS_STAGE_1, _fadeBy);
-    fadeToBlackBy(leds_stage_2, NUM_LEDS_STAGE_2, _fadeBy);
-
-    if (millis() - _timestampTacer < 50)
-        return;
-
-    _timestampTacer = millis();
-    //display pixel
     if (_showRainbow)
-    {
-        leds_stage_1[_tracerStage1Index] = CHSV( gHue, 200, 255);
-        leds_stage_2[_tracerStage2Index] = CHSV( gHue, 200, 255);
-    } else if (_staticRainbow)
-    {
-        leds_stage_1[_tracerStage1Index].r = leds_stage_1_rainbow[_tracerStage1Index].r;
-        leds_stage_1[_tracerStage1Index].g = leds_stage_1_rainbow[_tracerStage1Index].g;
-        leds_stage_1[_tracerStage1Index].b = leds_stage_1_rainbow[_tracerStage1Index].b;
-
-        leds_stage_2[_tracerStage2Index].r = leds_stage_2_rainbow[_tracerStage2Index].r;
-        leds_stage_2[_tracerStage2Index].g = leds_stage_2_rainbow[_tracerStage2Index].g;
-        leds_stage_2[_tracerStage2Index].b = leds_stage_2_rainbow[_tracerStage2Index].b;
-    } else {
-        setPixel(leds_stage_1[_tracerStage1Index], _redColor, _greenColor, _blueColor);
-        setPixel(leds_stage_2[_tracerStage2Index], _redColor, _greenColor, _blueColor);
-    }
-    
-    
-    //verify we're not at our bounds STAGE 1
-    if (_tracerStage1Index >= NUM_LEDS_STAGE_1-1)  
-    {
-        _tracerStage1Dir = 1;
-    } else if (_tracerStage1Index <= 0)
-    {
-        _tracerStage1Dir = 0;
-    }
-
-    //verify we're not at our bounds
-    if (_tracerStage2Index >= NUM_LEDS_STAGE_2-1)
-    {
-        _tracerStage2Dir = 1;
-    } else if (_tracerStage2Index <= 0)
-    {
-        _tracerStage2Dir = 0;
-    }
-
-        //increase or decrease pixel we're working on
-    if (_tracerStage1Dir == 1)
-        _tracerStage1Index--;
-    else
-        _tracerStage1Index++;
-
-    if (_tracerStage2Dir == 1)
-        _tracerStage2Index--;
+        pixel = CHSV(style == STYLE_REVERSE ? 255 - gHue : gHue, 200, 255);
+    else if (_staticRainbow)
+        pixel = strip ? leds_stage_2_rainbow[led] : leds_stage_1_rainbow[led];
+    else if (style == STYLE_REVERSE)
+        setPixel(pixel, _blueColor, _greenColor, _redColor);
     else
-        _tracerStage2Index++;
-
-}
-
-void startFlashAll()
-{
-    _wasBlinkAllEnabled = false;
-    _blinkAllEnabled = true;
-    _timestampLastBlinkedAll = 0;
-    _blinkAllOn = true;
-    runFlashAll();
-}
-void stopFlashAll()
-{
-    _blinkAllEnabled = false;
+        setPixel(pixel, _redColor, _greenColor, _blueColor);
 }
 
-void runFlashAll()
+//draw a pattern layer into the base buffer
+void drawLayer(EffectLayer &layer)
 {
-    if (!_blinkAllEnabled)
-        return;
-
-    if (millis() - _timestampLastBlinkedAll > 100)
+    CRGB *base = layer.strip ? leds_stage_2_base : leds_stage_1_base;
+    if (layer.kind == LAYER_TRACER)
     {
-        _timestampLastBlinkedAll = millis();
-        _blinkAllOn = !_blinkAllOn;
-        if (_blinkAllOn)
-        {
-            setAll(0, 0, 0, 0);
-            setAll(1, 0, 0, 0);
-        }
-        else 
-        {
-            setAll(0, _redColor, _greenColor, _blueColor);
-            setAll(1, _redColor, _greenColor, _blueColor);
-        }
-
+        byte led = getLayerLed(layer, layer.position);
+        paintPixel(base[led], led, layer.strip, layer.style);
+    }
+    else if (layer.kind == LAYER_BLINK)
+    {
+        if (layer.on)
+            setAll(layer.strip, _redColor, _greenColor, _blueColor);
+        else
+            setAll(layer.strip, 0, 0, 0);
     }
 }
 
-void handleSlotFlashing()
+//move a layer on one step, false once an overlay has run out
+bool stepLayer(EffectLayer &layer)
 {
-    if (_stage1SlotFlashing > 0)
+    if (layer.kind == LAYER_TRACER)
     {
-        if (millis() - _timestampStage1Sensor > 100)
+        layer.position += layer.direction;
+        if (layer.position >= layer.length || layer.position < 0) //bounce off the ends
         {
-            switch (_stage1SlotFlashing)
-            { 
-                //STAGE 1
-                case 1:
-                    handleStage1Flashing(_slotStage11, _slotStage11Size);
-                    break;
-                case 2:
-                    handleStage1Flashing(_slotStage12, _slotStage12Size);
-                    break;
-                case 3:
-                    handleStage1Flashing(_slotStage13, _slotStage13Size);
-                    break;
-                case 4:
-                    handleStage1Flashing(_slotStage14, _slotStage14Size);
-                    break;
-                case 5:
-                    handleStage1Flashing(_slotStage15, _slotStage15Size);
-                    break;
-                case 6:
-                    handleStage1Flashing(_slotStage16, _slotStage16Size);
-                    break;
-                case 7:
-                    handleStage1Flashing(_slotStage17, _slotStage17Size);
-                    break;
-            }
+            layer.direction = -layer.direction;
+            layer.position += 2 * layer.direction;
         }
     }
-
-    if (_stage2SlotFlashing > 0)
+    else
     {
-        if (millis() - _timestampStage2Sensor > 100)
-        {
-            switch (_stage2SlotFlashing)
-            {
-                case 1:
-                    handleStage2Flashing(_slotStage21, _slotStage21Size);
-                    break;
-                case 2:
-                    handleStage2Flashing(_slotStage22, _slotStage22Size);
-                    break;
-                case 3:
-                    handleStage2Flashing(_slotStage23, _slotStage23Size);
-                    break;
-                case 4:
-                    handleStage2Flashing(_slotStage24, _slotStage24Size);
-                    break;
-                case 5:
-                    handleStage2Flashing(_slotStage25, _slotStage25Size);
-                    break;
-            }
-        }
+        layer.on = !layer.on;
+        if (layer.kind == LAYER_SLOT_FLASH && --layer.steps == 0)
+            return false;
     }
+    return true;
 }
 
-void handleStage1Flashing(byte ledSlots[], byte slotSize)
+//called once a frame, steps every layer that's due then builds what goes out
+void runEffects()
 {
-    _timestampStage1Sensor = millis();
-    _stage1FlashesComplete++;
-    if (_stage1FlashesComplete > 7)
-    {
-        _stage1SlotFlashing = 0;
-        _timestampStage1Sensor = 0;
-        _stage1FlashesComplete = 0;
-        restartPatterns();
-    } else if (_stage1FlashesComplete % 2 == 0)
-    {
-        lightSlot(0, ledSlots, slotSize);                
-    } else {
-        setAll(0, 0, 0, 0);
-    }
-}
+    unsigned long curTime = millis();
+    byte fading = 0; //strips with a tracer on them
+    byte overlays = 0; //strips with an overlay on them
 
-void handleStage2Flashing(byte ledSlots[], byte slotSize)
-{
-    _timestampStage2Sensor = millis();
-    _stage2FlashesComplete++;
-    if (_stage2FlashesComplete > 7)
-    {
-        _stage2SlotFlashing = 0;
-        _timestampStage2Sensor = 0;
-        _stage2FlashesComplete = 0;
-        restartPatterns();
-    } else if (_stage2FlashesComplete % 2 == 0)
+    for (byte i = 0; i < _maxLayers; i++)
     {
-        lightSlot(1, ledSlots, slotSize);                
-    } else {
-        setAll(1, 0, 0, 0);
+        EffectLayer &layer = _layers[i];
+        if (layer.kind == LAYER_NONE)
+            continue;
+
+        if (layer.kind == LAYER_TRACER)
+            fading |= 1 << layer.strip;
+        else if (layer.priority == PRIORITY_OVERLAY)
+            overlays |= 1 << layer.strip;
     }
-}
 
-void triggerFlashing(int slot)
-{
-    if (_tracerEnabled)
-        _wasTracertEnabled = true;
-    if (_blinkAllEnabled)
-        _wasBlinkAllEnabled = true;
+    if (fading & 1)
+        fadeToBlackBy(leds_stage_1_base, NUM_LEDS_STAGE_1, _fadeBy);
+    if (fading & 2)
+        fadeToBlackBy(leds_stage_2_base, NUM_LEDS_STAGE_2, _fadeBy);
+    _stripsDirty |= fading;
 
-    stopAllPatterns();
+    for (byte i = 0; i < _maxLayers; i++)
+    {
+        EffectLayer &layer = _layers[i];
+        if (layer.kind == LAYER_NONE || curTime - layer.timestampStep < layer.interval)
+            continue;
 
-    switch (slot)
-    { 
-        //STAGE 1
-        case 1:
-            _timestampStage1Sensor = millis();
-            _stage1SlotFlashing = 1;
-            lightSlot(0, _slotStage11, _slotStage11Size);
-            break;
-        case 2:
-            _timestampStage1Sensor = millis();
-            _stage1SlotFlashing = 2;
-            lightSlot(0, _slotStage12, _slotStage12Size);
-            break;
-        case 3:
-            _timestampStage1Sensor = millis();
-            _stage1SlotFlashing = 3;
-            lightSlot(0, _slotStage13, _slotStage13Size);
-            break;
-        case 4:
-            _timestampStage1Sensor = millis();
-            _stage1SlotFlashing = 4;
-            lightSlot(0, _slotStage14, _slotStage14Size);
-            break;
-        case 5:
-            _timestampStage1Sensor = millis();
-            _stage1SlotFlashing = 5;
-            lightSlot(0, _slotStage15, _slotStage15Size);
-            break;
-        case 6:
-            _timestampStage1Sensor = millis();
-            _stage1SlotFlashing = 6;
-            lightSlot(0, _slotStage16, _slotStage16Size);
-            break;
-        case 7:
-            _timestampStage1Sensor = millis();
-            _stage1SlotFlashing = 7;
-            lightSlot(0, _slotStage17, _slotStage17Size);
-            break;
+        layer.timestampStep = curTime;
+        if (!stepLayer(layer))
+        {
+            layer.kind = LAYER_NONE;
+            continue;
+        }
 
-        //STAGE 2
-        case 8:
-            _timestampStage2Sensor = millis();
-            _stage2SlotFlashing = 1;
-            lightSlot(1, _slotStage21, _slotStage21Size);
-            break;
-        case 9:
-            _timestampStage2Sensor = millis();
-            _stage2SlotFlashing = 2;
-            lightSlot(1, _slotStage22, _slotStage22Size);
-            break;
-        case 10:
-            _timestampStage2Sensor = millis();
-            _stage2SlotFlashing = 3;
-            lightSlot(1, _slotStage23, _slotStage23Size);
-            break;
-        case 11:
-            _timestampStage2Sensor = millis();
-            _stage2SlotFlashing = 4;
-            lightSlot(1, _slotStage24, _slotStage24Size);
-            break;
-        case 12:
-            _timestampStage2Sensor = millis();
-            _stage2SlotFlashing = 5;
-            lightSlot(1, _slotStage25, _slotStage25Size);
-            break;
+        if (layer.priority == PRIORITY_PATTERN)
+            drawLayer(layer);
+        else
+            _stripsDirty |= 1 << layer.strip;
     }
 
-}
-
-void showSlot(byte slot)
-{
-    switch (slot)
-    { 
-        //STAGE 1
-        case 1:
-            flashSlot(0, _slotStage11, _slotStage11Size);
-            break;
-        case 2:
-            flashSlot(0, _slotStage12, _slotStage12Size);
-            break;
-        case 3:
-            flashSlot(0, _slotStage13, _slotStage13Size);
-            break;
-        case 4:
-            flashSlot(0, _slotStage14, _slotStage14Size);
-            break;
-        case 5:
-            flashSlot(0, _slotStage15, _slotStage15Size);
-            break;
-        case 6:
-            flashSlot(0, _slotStage16, _slotStage16Size);
-            break;
-        case 7:
-            flashSlot(0, _slotStage17, _slotStage17Size);
-            break;
-
-        //STAGE 2
-        case 8:
-            flashSlot(1, _slotStage21, _slotStage21Size);
-            break;
-        case 9:
-            flashSlot(1, _slotStage22, _slotStage22Size);
-            break;
-        case 10:
-            flashSlot(1, _slotStage23, _slotStage23Size);
-            break;
-        case 11:
-            flashSlot(1, _slotStage24, _slotStage24Size);
-            break;
-        case 12:
-            flashSlot(1, _slotStage25, _slotStage25Size);
-            break;
-    }
-}
+    //strips whose overlay ended need one more frame without it
+    _stripsDirty |= _overlayStrips & ~overlays;
+    _overlayStrips = overlays;
 
-void flashSlot(int controller, byte ledSlots[], byte slotSize)
-{
-    for(byte flashes = 0; flashes < 5; flashes++)
+    for (byte strip = 0; strip < NUM_STRIPS; strip++)
     {
-        
-        lightSlot(controller, ledSlots, slotSize);
-        delay(100);
-        setAll(controller, 0, 0, 0);
-        delay(100);
+        if (_stripsDirty & (1 << strip))
+            composeStrip(strip);
     }
 }
 
-
-void lightSlot(int controller, byte ledSlots[], byte slotSize)
+//copy the base out and draw the overlays on top
+void composeStrip(byte strip)
 {
-    CRGB *ledArray = leds_stage_1;
-    switch (controller)
-    {
-        case 1:
-            ledArray = leds_stage_2;
-            break;
-        default:
-            ledArray = leds_stage_1;
-            break;
-    }
+    if (strip)
+        memcpy(leds_stage_2, leds_stage_2_base, sizeof(leds_stage_2));
+    else
+        memcpy(leds_stage_1, leds_stage_1_base, sizeof(leds_stage_1));
 
-    for(byte i = 0; i < slotSize; i++)
+    CRGB *out = strip ? leds_stage_2 : leds_stage_1;
+    for (byte i = 0; i < _maxLayers; i++)
     {
-        setPixel(ledArray[ledSlots[i]], _redColor, _greenColor, _blueColor);
-    }
+        EffectLayer &layer = _layers[i];
+        if (layer.kind == LAYER_NONE || layer.priority != PRIORITY_OVERLAY || layer.strip != strip || !layer.on)
+            continue;
 
-    controllers[controller]->showLeds(BRIGHTNESS);
+        for (byte p = 0; p < layer.length; p++)
+        {
+            byte led = getLayerLed(layer, p);
+            setPixel(out[led], _redColor, _greenColor, _blueColor);
+        }
+    }
 }
 
-
 void setAll(int controller, byte red, byte green, byte blue)
 {
     switch (controller)
     {
         case 1:
             for(int i = 0; i < NUM_LEDS_STAGE_2; i++ )
-                setPixel(leds_stage_2[i], red, green, blue); 
+                setPixel(leds_stage_2_base[i], red, green, blue); 
             
             break;
         default:
             for(int i = 0; i < NUM_LEDS_STAGE_1; i++ )
-                    setPixel(leds_stage_1[i], red, green, blue); 
+                    setPixel(leds_stage_1_base[i], red, green, blue); 
             
             break;
     }
 
-    controllers[controller]->showLeds(BRIGHTNESS);
+    markStripDirty(controller);
 }
 
 void showStrip() {
   FastLED.show();
 }
 
+void markStripDirty(int controller)
+{
+    _stripsDirty |= 1 << controller;
+}
+
+//hand the strips that changed this frame to the push scheduler
+void queueDirtyStrips()
+{
+    for (byte i = 0; i < NUM_STRIPS; i++)
+    {
+        if (_stripsDirty & (1 << i))
+            _ledPush.markDirty(i);
+    }
+    _stripsDirty = 0;
+}
+
+//a push blocks interrupts, hold it while a frame is coming in on either port
+void showNextStrip()
+{
+    if (_mainLink.isReceiving() || usbController.available())
+        _ledPush.noteActivity();
+
+    int strip = _ledPush.nextPush(millis());
+    if (strip >= 0)
+        controllers[strip]->showLeds(BRIGHTNESS);
+}
+
 void setPixel(CRGB &pixel, byte red, byte green, byte blue) {
   pixel.r = red;
   pixel.g = green;
@@ -1,16 +1,37 @@
-unsigned long _scoreSensor1Activated       = 0; //Time the sensor was tripped
-unsigned long _scoreSensor2Activated       = 0;
-unsigned long _scoreSensor3Activated       = 0;
-unsigned long _scoreSensor4Activated       = 0;
-unsigned long _scoreSensor5Activated       = 0;
-unsigned long _scoreSensor6Activated       = 0;
-unsigned long _scoreSensor7Activated       = 0;
-unsigned long _scoreSensorBallRtnActivated = 0;
-bool _scoreSensor7CanTriggerAgain = true;
-int _sensor7GapTime = 0;
-unsigned long _sensor7FirstActiveTime = 0;
-unsigned long _loopCount = 0;
-bool isLow = false;
+//score sensors by bit, bit n is sensor n + 1 (1-6, 7 ball stop, 8 ball return)
+const byte _scoreSensorPins[8] = {
+    PIN_SCORE_SENSOR_1, PIN_SCORE_SENSOR_2, PIN_SCORE_SENSOR_3, PIN_SCORE_SENSOR_4,
+    PIN_SCORE_SENSOR_5, PIN_SCORE_SENSOR_6, PIN_SCORE_SENSOR_BALL_STOP, PIN_SCORE_SENSOR_BALL_RTN
+};
+#define SCORE_BIT_5         0x10
+#define SCORE_BIT_6         0x20
+#define SCORE_BIT_BALL_STOP 0x40
+#define SCORE_BIT_BALL_RTN  0x80
+
+//the score pins have no pin change interrupts, a timer samples them and queues every change
+#define SCORE_RING_SIZE 16 //power of two
+
+struct ScoreEdge
+{
+    byte levels; //pin levels after the change
+    byte changed; //bits that changed
+    unsigned long time; //micros when the timer saw it
+};
+
+volatile ScoreEdge _scoreRing[SCORE_RING_SIZE];
+volatile byte _scoreRingHead = 0; //only the timer interrupt writes this
+volatile byte _scoreRingTail = 0; //only loop() writes this
+volatile unsigned int _scoreRingOverflows = 0;
+volatile byte _scorePinLevels = 0xFF; //last levels pushed to the ring, idle is high
+
+const byte _maxScorePorts = 3;
+volatile uint8_t *_scorePorts[_maxScorePorts];
+byte _scorePortCount = 0;
+byte _scorePortIndex[8]; //which of _scorePorts each sensor is on
+byte _scorePortMask[8];
+
+SensorClassifier<8> _scoreClassifier; //judges the edges in micros, reports score slots
+unsigned int _scoreOverflowsReported = 0;
 
 void initScoring()
 {
@@ -34,6 +55,86 @@ void initScoring()
     pinMode(PIN_SCORE_ENABLE_BALL_STOP, OUTPUT);
     pinMode(PIN_SCORE_ENABLE_BALL_RTN, OUTPUT);
 
+    for (byte i = 0; i < 8; i++)
+        _scorePortIndex[i] = registerScorePort(_scoreSensorPins[i], _scorePortMask[i]);
+
+    //5 and 6 alone are the 10K slots, both at once is the 5000 slot
+    _scoreClassifier.setSensor(0, SCORE_SLOT_1000, 0, 0);
+    _scoreClassifier.setSensor(1, SCORE_SLOT_2000, 0, 0);
+    _scoreClassifier.setSensor(2, SCORE_SLOT_3000, 0, 0);
+    _scoreClassifier.setSensor(3, SCORE_SLOT_4000, 0, 0);
+    _scoreClassifier.setSensor(4, SCORE_SLOT_10K_RIGHT, 0, 0);
+    _scoreClassifier.setSensor(5, SCORE_SLOT_10K_LEFT, 0, 0);
+    _scoreClassifier.setSensor(6, SCORE_SLOT_BALL_STOP, _ballStopMinPulse * 1000UL, 0);
+    _scoreClassifier.setSensor(7, SCORE_SLOT_RETURN, 0, 0);
+    _scoreClassifier.addCoincidence(SCORE_BIT_5 | SCORE_BIT_6, 0, SCORE_SLOT_5000);
+    applyScoringTimes();
+    _scorePinLevels = sampleScorePins();
+
+    //timer 2 compare match every 248us, clk/64 is 4us a tick
+    noInterrupts();
+    TCCR2A = _BV(WGM21); //CTC
+    TCCR2B = _BV(CS22); //clk/64
+    TCNT2 = 0;
+    OCR2A = 61;
+    TIMSK2 = _BV(OCIE2A);
+    interrupts();
+}
+
+//remember which register and bit a pin lives on, returns its index in _scorePorts
+byte registerScorePort(byte pin, byte &mask)
+{
+    volatile uint8_t *port = portInputRegister(digitalPinToPort(pin));
+    mask = digitalPinToBitMask(pin);
+
+    for (byte i = 0; i < _scorePortCount; i++)
+    {
+        if (_scorePorts[i] == port)
+            return i;
+    }
+
+    if (_scorePortCount >= _maxScorePorts) //out of room, fall back to sharing the last slot
+        return _maxScorePorts - 1;
+
+    _scorePorts[_scorePortCount] = port;
+    return _scorePortCount++;
+}
+
+//read each port once and pack the sensors into a byte, bit n is sensor n + 1
+byte sampleScorePins()
+{
+    byte ports[_maxScorePorts];
+    for (byte i = 0; i < _scorePortCount; i++)
+        ports[i] = *_scorePorts[i];
+
+    byte levels = 0;
+    for (byte i = 0; i < 8; i++)
+    {
+        if (ports[_scorePortIndex[i]] & _scorePortMask[i])
+            levels |= 1 << i;
+    }
+    return levels;
+}
+
+ISR(TIMER2_COMPA_vect)
+{
+    byte levels = sampleScorePins();
+    byte changed = levels ^ _scorePinLevels;
+    if (!changed)
+        return;
+
+    byte next = (_scoreRingHead + 1) & (SCORE_RING_SIZE - 1);
+    if (next == _scoreRingTail)
+    {
+        _scoreRingOverflows++; //levels aren't updated so the change is queued again once there's room
+        return;
+    }
+
+    _scoreRing[_scoreRingHead].levels = levels;
+    _scoreRing[_scoreRingHead].changed = changed;
+    _scoreRing[_scoreRingHead].time = micros();
+    _scoreRingHead = next;
+    _scorePinLevels = levels;
 }
 
 void setScoring(int scoreSlot, bool isEnabled)
@@ -105,250 +206,78 @@ void setScoring(int scoreSlot, bool isEnabled)
 }
 
 
+//sensors the current game is looking at, same bit order as _scoreSensorPins
+byte getCheckedScoreSensors()
+{
+    byte checked = 0;
+    if (_checkScoringSensor1) checked |= 0x01;
+    if (_checkScoringSensor2) checked |= 0x02;
+    if (_checkScoringSensor3) checked |= 0x04;
+    if (_checkScoringSensor4) checked |= 0x08;
+    if (_checkScoringSensor5) checked |= SCORE_BIT_5;
+    if (_checkScoringSensor6) checked |= SCORE_BIT_6;
+    if (_checkScoringSensor7) checked |= SCORE_BIT_BALL_STOP;
+    if (_checkScoringSensor8) checked |= SCORE_BIT_BALL_RTN;
+    return checked;
+}
+
+//push the ms settings into the classifier, call again when one of them changes
+void applyScoringTimes()
+{
+    for (byte i = 0; i < 6; i++)
+        _scoreClassifier.setHoldOff(i, _sensorActivationDelay * 1000UL);
+    _scoreClassifier.setHoldOff(6, _ballStopTriggerDuration * 1000UL);
+    _scoreClassifier.setHoldOff(7, 200 * 1000UL);
+    _scoreClassifier.setWindow(0, _scoreComboWindow * 1000UL);
+}
+
+//work through the edges the timer captured, everything is judged by when the timer saw it
 void checkScoreSensors()
 {
     static unsigned long curTime = 0;
     curTime = millis();
-    bool hasFive = false; //five and six combine == the 5000 sensor, use these vars to do a check against both sensors
-    bool hasSix = false;
-
-    //Check the ball return stop to see if a ball is passing
-    int scorePin7 = digitalReadFast(PIN_SCORE_SENSOR_BALL_STOP);
+    bool isScoringSettled = curTime - _timestampScoringEnabled >= _scoreEnableWaitTime; //turning sensors on trips some of them
+    byte checked = getCheckedScoreSensors();
 
-    if (_checkScoringSensor7 && scorePin7 == _scoreActivated)
+    while (_scoreRingTail != _scoreRingHead)
     {
-        if (!isLow)
-        {
-            if (_isDebugMode)
-            {
-                debugString("#### VAL CHANGE - HIGH LOOPS COMPLETED #### ");
-                debugInt(_loopCount);
-                debugLine("");
-                _loopCount = 0;
-            }
-        }
-        _loopCount++;
-        isLow = true;
-    } else {
-        if (isLow)
-        {
-            if (_isDebugMode)
-            {
-                debugString("#### VAL CHANGE - LOW LOOPS COMPLETED #### ");
-                debugInt(_loopCount);
-                debugLine("");
-                _loopCount = 0;
-            }
-        }
-        _loopCount++;
-        isLow = false;
-    }
-    if (_checkScoringSensor7 && scorePin7 == _scoreActivated && isLow && _loopCount > 100)
-    {
-        
-        if (_isDebugMode && curTime - 10 > _scoreSensor7Activated)
-        {
-            _sensor7GapTime += curTime - _scoreSensor7Activated;
-            debugString("-------- ACTIVE ---------- ");
-            debugLong(curTime);
-            debugString(" - ");
-            debugInt(curTime - _scoreSensor7Activated);
-            debugLine("");
-            if (_sensor7GapTime > _ballStopTriggerDuration)
-            {
-                debugString("-------- GAP TIME TRIGGER ---------- ");
-                debugLong(curTime);
-                debugString(" - ");
-                debugInt(_sensor7GapTime);
-                debugLine("");
-                _sensor7GapTime = 0;
-            }
-        }
-        
-        if (curTime - _ballStopTriggerDuration > _scoreSensor7Activated && _scoreSensor7CanTriggerAgain)
-        {
-            _sensor7FirstActiveTime = curTime;
-            _scoreSensor7CanTriggerAgain = false;
-            tallyScore(SCORE_SLOT_BALL_STOP);
-        }
-        _scoreSensor7Activated = curTime;
-    } else if (scorePin7 != _scoreActivated && !_scoreSensor7CanTriggerAgain && !isLow && _loopCount > 100)
-    {
-        // require that we're not reading activated
-        // require that the sensor is set to no trigger allowed
-        if (_isDebugMode)
-        {
-            debugString("-------- DEACTIVATED ---------- ");
-            debugLong(curTime);
-            debugString(" - ");
-            debugLong(curTime - _sensor7FirstActiveTime);
-            debugLine("");
-        }
-
-        _sensor7GapTime = 0;
-        _scoreSensor7CanTriggerAgain = true;
-    }
-
-    // We have a delay before we can keep track of any score sensors other than the one above
-    if (curTime - _timestampScoringEnabled < _scoreEnableWaitTime)
-        return;
+        byte levels = _scoreRing[_scoreRingTail].levels;
+        byte changed = _scoreRing[_scoreRingTail].changed & checked;
+        unsigned long time = _scoreRing[_scoreRingTail].time;
+        _scoreRingTail = (_scoreRingTail + 1) & (SCORE_RING_SIZE - 1);
 
-    // ####################
-    // #      SLOT 1      #
-    // ####################
-
-    if (_checkScoringSensor1 && digitalReadFast(PIN_SCORE_SENSOR_1) == _scoreActivated)
-    {
-        if (curTime - _sensorActivationDelay > _scoreSensor1Activated)
+        byte active = _scoreActivated ? levels : ~levels;
+        for (byte i = 0; i < 8; i++)
         {
-            tallyScore(SCORE_SLOT_1000);
+            byte bit = 1 << i;
+            if (changed & bit)
+                _scoreClassifier.sample(i, active & bit, time);
         }
-        _scoreSensor1Activated = curTime;
-    }
 
-    // ####################
-    // #      SLOT 2      #
-    // ####################
-
-    if (_checkScoringSensor2 && digitalReadFast(PIN_SCORE_SENSOR_2) == _scoreActivated)
-    {
-        if (curTime - _sensorActivationDelay > _scoreSensor2Activated)
+        if ((changed & SCORE_BIT_BALL_STOP) && _isDebugMode)
         {
-            tallyScore(SCORE_SLOT_2000);
-        }
-
-        _scoreSensor2Activated = curTime;
-    }
-
-    // ####################
-    // #      SLOT 3      #
-    // ####################
-
-    if (_checkScoringSensor3 && digitalReadFast(PIN_SCORE_SENSOR_3) == _scoreActivated)
-    {
-        if (curTime - _sensorActivationDelay > _scoreSensor3Activated)
-        {
-
-            tallyScore(SCORE_SLOT_3000);
-        }
-        _scoreSensor3Activated = curTime;
-    }
-
-    // ####################
-    // #      SLOT 4      #
-    // ####################
-
-    if (_checkScoringSensor4 && digitalReadFast(PIN_SCORE_SENSOR_4) == _scoreActivated)
-    {
-        if (curTime - _sensorActivationDelay > _scoreSensor4Activated)
-        {
-
-            tallyScore(SCORE_SLOT_4000);
-        }
-        _scoreSensor4Activated = curTime;
-    }
-
-    // ####################
-    // #      SLOT 5      #
-    // ####################
-
-    if (_checkScoringSensor5 && digitalReadFast(PIN_SCORE_SENSOR_5) == _scoreActivated)
-    {
-        if (curTime - _sensorActivationDelay > _scoreSensor5Activated)
-        {
-            debugString(" ---------- SCORE 5 --------- ");
-            debugLong(curTime);
+            debugString(active & SCORE_BIT_BALL_STOP ? "-------- ACTIVE ---------- " : "-------- DEACTIVATED ---------- ");
+            debugLong(time);
             debugLine("");
-            hasFive = true;
-            unsigned long extraCurTime = millis();
-            for(int i = 0; i < _maxSensorRechecks; i++)
-            {
-                extraCurTime = millis();
-                if (_checkScoringSensor6 && digitalReadFast(PIN_SCORE_SENSOR_6) == _scoreActivated)
-                {
-                    if (extraCurTime - _sensorActivationDelay > _scoreSensor6Activated)
-                    {
-                        debugString(" ---------- SCORE 6 INTERIOR --------- ");
-                        debugLong(extraCurTime);
-                        debugString(" - ");
-                        debugInt(i);
-                        debugLine("");
-                        hasSix = true;
-                        _scoreSensor6Activated = extraCurTime;
-                        break;
-                    }
-                    _scoreSensor6Activated = extraCurTime;
-                }
-            }
         }
-        _scoreSensor5Activated = curTime;
     }
+    _scoreClassifier.poll(micros());
 
-    // ####################
-    // #      SLOT 6      #
-    // ####################
-
-    if (_checkScoringSensor6 && digitalReadFast(PIN_SCORE_SENSOR_6) == _scoreActivated)
+    if (_scoreRingOverflows != _scoreOverflowsReported)
     {
-        if (curTime - _sensorActivationDelay > _scoreSensor6Activated)
-        {
-            debugString(" ---------- SCORE 6 --------- ");
-            debugLong(curTime);
-            debugLine("");
-            hasSix = true;
-            unsigned long extraCurTime = millis();
-            for(int i = 0; i < _maxSensorRechecks; i++)
-            {
-                extraCurTime = millis();
-                if (_checkScoringSensor5 && digitalReadFast(PIN_SCORE_SENSOR_5) == _scoreActivated)
-                {
-                    
-                    if (extraCurTime - _sensorActivationDelay > _scoreSensor5Activated)
-                    {
-                        debugString(" ---------- SCORE 5 INTERIOR --------- ");
-                        debugLong(extraCurTime);
-                        debugString(" - ");
-                        debugInt(i);
-                        debugLine("");
-                        hasFive = true;
-                        _scoreSensor5Activated = extraCurTime;
-                        break;
-                    }
-                    _scoreSensor5Activated = extraCurTime;
-
-                }
-            }
-        }
-        _scoreSensor6Activated = curTime;
+        _scoreOverflowsReported = _scoreRingOverflows;
+        debugString("score edges delayed ");
+        debugInt(_scoreOverflowsReported);
+        debugLine("");
     }
 
-    // ########################
-    // #      SLOT 5 & 6      #
-    // ########################
-
-    if (hasFive && hasSix)
+    while (_scoreClassifier.available())
     {
-        tallyScore(SCORE_SLOT_5000);
-    } else if (hasFive)
-    {
-        tallyScore(SCORE_SLOT_10K_RIGHT);
-    } else if (hasSix)
-    {
-        tallyScore(SCORE_SLOT_10K_LEFT);
-    }
+        int scoreSlot = _scoreClassifier.read();
 
-
-    // ####################
-    // #      SLOT 8      #
-    // ####################
-
-    if (_checkScoringSensor8 && digitalReadFast(PIN_SCORE_SENSOR_BALL_RTN) == _scoreActivated)
-    {
-        if (curTime - 200 > _scoreSensorBallRtnActivated)
-        {
-            tallyScore(SCORE_SLOT_RETURN);
-        }
-        _scoreSensorBallRtnActivated = curTime;
+        //the ball stop counts even before scoring settles
+        if (isScoringSettled || scoreSlot == SCORE_SLOT_BALL_STOP)
+            tallyScore(scoreSlot);
     }
 }
 
@@ -0,0 +1,212 @@
+#ifndef SensorClassifier_h
+#define SensorClassifier_h
+
+#include "Arduino.h"
+
+#define SENSOR_CLASSIFIER_MAX_RULES 2 //coincidence rules per classifier
+#define SENSOR_CLASSIFIER_QUEUE 8 //hits waiting to be read, power of two
+
+/**
+ * Turns raw sensor levels into hits.
+ *
+ * Feed it levels with sample(), either every loop or only when a sensor changes, and read hits back
+ * with read(). Times are in whatever unit the caller feeds it, millis or micros, as long as it's the
+ * same everywhere.
+ *
+ *  minPulse - a sensor has to stay active this long before it counts, 0 counts the leading edge
+ *  holdOff - a sensor has to be clear this long after a hit before it can count again
+ *  coincidence - sensors in a rule's mask that all hit within its window report the rule's code
+ *                instead of their own, any that hit alone report their own once the window passes
+ *
+ * Each sensor and rule reports the code given to it, typically an event or a score slot.
+ */
+template <byte SENSORS>
+class SensorClassifier
+{
+  public:
+    SensorClassifier()
+    {
+        _ruleCount = 0;
+        _queueHead = 0;
+        _queueCount = 0;
+        for (byte i = 0; i < SENSORS; i++)
+        {
+            _sensors[i].code = i;
+            _sensors[i].minPulse = 0;
+            _sensors[i].holdOff = 0;
+            _sensors[i].state = STATE_CLEAR;
+            _sensors[i].lastCounted = false;
+        }
+    }
+
+    //how a sensor is judged and what it reports
+    void setSensor(byte sensor, int code, unsigned long minPulse, unsigned long holdOff)
+    {
+        _sensors[sensor].code = code;
+        _sensors[sensor].minPulse = minPulse;
+        _sensors[sensor].holdOff = holdOff;
+    }
+
+    void setHoldOff(byte sensor, unsigned long holdOff)
+    {
+        _sensors[sensor].holdOff = holdOff;
+    }
+
+    //sensors in mask hitting within window of each other report code, false if there's no room for the rule
+    bool addCoincidence(unsigned int mask, unsigned long window, int code)
+    {
+        if (_ruleCount >= SENSOR_CLASSIFIER_MAX_RULES)
+            return false;
+
+        Rule &rule = _rules[_ruleCount++];
+        rule.mask = mask;
+        rule.window = window;
+        rule.code = code;
+        rule.seen = 0;
+        return true;
+    }
+
+    void setWindow(byte rule, unsigned long window)
+    {
+        _rules[rule].window = window;
+    }
+
+    //level of a sensor at time
+    void sample(byte sensor, bool active, unsigned long time)
+    {
+        Sensor &s = _sensors[sensor];
+        if (!active)
+        {
+            if (s.state != STATE_CLEAR)
+            {
+                s.lastCounted = s.state == STATE_COUNTED; //a pulse still pending here was too short, it doesn't hold off the next
+                s.state = STATE_CLEAR;
+                s.lastActive = time;
+            }
+            return;
+        }
+
+        if (s.state == STATE_CLEAR)
+        {
+            if (s.lastCounted && time - s.lastActive <= s.holdOff)
+                s.state = STATE_COUNTED; //same object or bounce, wait for it to clear
+            else
+            {
+                s.state = STATE_PENDING;
+                s.pulseStart = time;
+            }
+        }
+        s.lastActive = time;
+
+        if (s.state == STATE_PENDING && time - s.pulseStart >= s.minPulse)
+        {
+            s.state = STATE_COUNTED;
+            hit(sensor, s.pulseStart);
+        }
+    }
+
+    //confirm pulses still held and close coincidence windows that have run out, call every loop
+    void poll(unsigned long now)
+    {
+        for (byte i = 0; i < SENSORS; i++)
+        {
+            if (_sensors[i].state == STATE_PENDING)
+                sample(i, true, now);
+        }
+
+        for (byte r = 0; r < _ruleCount; r++)
+        {
+            Rule &rule = _rules[r];
+            if (!rule.seen || now - rule.start < rule.window)
+                continue;
+
+            for (byte i = 0; i < SENSORS; i++)
+            {
+                if (rule.seen & (1 << i))
+                    push(_sensors[i].code);
+            }
+            rule.seen = 0;
+        }
+    }
+
+    byte available()
+    {
+        return _queueCount;
+    }
+
+    //next hit code, -1 if there isn't one
+    int read()
+    {
+        if (!_queueCount)
+            return -1;
+
+        int code = _queue[_queueHead];
+        _queueHead = (_queueHead + 1) & (SENSOR_CLASSIFIER_QUEUE - 1);
+        _queueCount--;
+        return code;
+    }
+
+  private:
+    enum SensorState { STATE_CLEAR, STATE_PENDING, STATE_COUNTED };
+
+    struct Sensor
+    {
+        int code;
+        unsigned long minPulse;
+        unsigned long holdOff;
+        byte state;
+        bool lastCounted; //the last pulse counted or was held off, only then does hold-off apply
+        unsigned long pulseStart; //leading edge of the pulse being judged
+        unsigned long lastActive; //last time the sensor was seen active, or when it cleared
+    };
+
+    struct Rule
+    {
+        unsigned int mask;
+        unsigned long window;
+        int code;
+        unsigned int seen; //sensors in the mask that hit since start
+        unsigned long start; //when the first of them hit
+    };
+
+    Sensor _sensors[SENSORS];
+    Rule _rules[SENSOR_CLASSIFIER_MAX_RULES];
+    byte _ruleCount;
+    int _queue[SENSOR_CLASSIFIER_QUEUE];
+    byte _queueHead;
+    byte _queueCount;
+
+    void hit(byte sensor, unsigned long time)
+    {
+        unsigned int bit = 1 << sensor;
+        for (byte r = 0; r < _ruleCount; r++)
+        {
+            Rule &rule = _rules[r];
+            if (!(rule.mask & bit))
+                continue;
+
+            if (!rule.seen)
+                rule.start = time;
+            rule.seen |= bit;
+            if (rule.seen == rule.mask)
+            {
+                push(rule.code);
+                rule.seen = 0;
+            }
+            return;
+        }
+
+        push(_sensors[sensor].code);
+    }
+
+    void push(int code)
+    {
+        if (_queueCount >= SENSOR_CLASSIFIER_QUEUE)
+            return; //oldest hits win, nobody is reading
+
+        _queue[(_queueHead + _queueCount) & (SENSOR_CLASSIFIER_QUEUE - 1)] = code;
+        _queueCount++;
+    }
+};
+
+#endif
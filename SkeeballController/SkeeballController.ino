@@ -1,21 +1,27 @@
 #include "Defines.h"
 #include <Wire.h>
 #include "DigitalWriteFast.h"
+#include "SerialLink.h"
+#include "LoopProfiler.h"
+#include "SensorClassifier.h"
 
 HardwareSerial &shooterController = Serial1;
 HardwareSerial &displayController = Serial2;
 HardwareSerial &wifiController = Serial3;
 
+SerialLink _shooterLink(shooterController); //framed link to the shooter, the display keeps RTS/CTS until its firmware has SerialLink
+
 
 bool _isDebugMode = false;
 
 byte curMsgId = 0;
 
-const char RTS = '{'; //request to send data
+const char RTS = '{'; //request to send data, usb terminal and display
 const char CS = '}'; // complete send data
 const char CTS = '!'; //clear to send data
 
-int _maxSensorRechecks = 20000; //how many times to check the 5/6 score sensors for a double trigger
+int _scoreComboWindow = 20; //ms to wait for the other 5/6 score sensor before calling it a single
+const int _scoreComboWindowMax = 500; //longer and a single in 5 or 6 is reported late enough to notice
 
 const bool _scoreActivated = LOW; //Pin status when ball passes in front of it
 int _sensorActivationDelay = 500; //how long to wait before sensing another activation
@@ -45,16 +51,30 @@ int _ballReleaseDelay = 0; //how long to hold the release open
 unsigned long _timestampScoringEnabled = 0;
 int _scoreEnableWaitTime = 2000;
 int _ballStopTriggerDuration = 50;
+int _ballStopMinPulse = 5; //ms the ball stop sensor has to stay active to count a ball, a sample or two of noise doesn't
 bool _ballReleasedRemotely = false;
 
 
 byte _ledSlotControllerId = 0x10;
 
+//loop() stages timed by the profiler, see the perf command
+#define PERF_SCORING    0
+#define PERF_RELEASE    1
+#define PERF_BUTTONS    2
+#define PERF_FLAP       3
+#define PERF_TERMINAL   4
+#define PERF_SHOOTER    5
+#define PERF_DISPLAY    6
+#define PERF_WIFI       7
+const char *const _perfStageNames[] = { "scoring", "release", "buttons", "flap", "terminal", "shooter", "display", "wifi" };
+LoopProfiler _profiler(_perfStageNames, 8);
+
 void setup() {
     Wire.begin(); //begin as master
     Serial.begin(115200);
     shooterController.begin(115200);
     displayController.begin(115200);
+    _shooterLink.setReceiveHandler(handleShooterMessage);
     wifiController.begin(115200);
     initScoring();
     initExternalButtons();
@@ -66,16 +86,26 @@ void setup() {
 }
 
 void loop() {
+    _profiler.beginLoop();
    
     checkScoreSensors();
+    _profiler.mark(PERF_SCORING);
     checkBallRelease();
+    _profiler.mark(PERF_RELEASE);
     checkExternalButtons();
+    _profiler.mark(PERF_BUTTONS);
     checkFlapStuff();
+    _profiler.mark(PERF_FLAP);
     handleTerminalSerialCommands();
+    _profiler.mark(PERF_TERMINAL);
     handleShooterSerialCommands();
+    _profiler.mark(PERF_SHOOTER);
     handleDisplaySerialCommands();
+    _profiler.mark(PERF_DISPLAY);
     handleWiFiSerialCommands(); 
-    
+    _profiler.mark(PERF_WIFI);
+
+    _profiler.endLoop();
 }
 
 
@@ -108,8 +138,8 @@ void handleTerminalCommand(char incomingData[])
     memset(argument6, 0, sizeof(argument6));
     */
 
-    //simplistic approach
-    sscanf(incomingData, "%s %s %s %s %s %s %s %s %s %s %s", sequence, command, argument, argument2, argument3, argument4, argument5, argument6, argument7, argument8, argument9);
+    //simplistic approach, arguments keep old values when not sent so check the count
+    int fieldCount = sscanf(incomingData, "%s %s %s %s %s %s %s %s %s %s %s", sequence, command, argument, argument2, argument3, argument4, argument5, argument6, argument7, argument8, argument9);
 
 
 
@@ -120,6 +150,26 @@ void handleTerminalCommand(char incomingData[])
         
         sprintf(outputData, "%i %i", _ballsReleased, _localModeBallTrackerCount);
         sendFormattedResponse(EVENT_INFO, sequence, outputData);
+    } else if (strcmp(command,"perf") == 0) { //loop timing: "perf on|off" to run the profiler, "perf" for the whole loop, "perf n" for stage n
+
+        if (strcmp(argument,"on") == 0 || strcmp(argument,"off") == 0)
+        {
+            _profiler.setEnabled(strcmp(argument,"on") == 0);
+            sprintf(outputData, "%i", _profiler.isEnabled());
+        }
+        else
+        {
+            byte stage = fieldCount > 2 ? atoi(argument) : _profiler.getStageCount();
+            if (!_profiler.format(stage, outputData, 100))
+                sprintf(outputData, "%i", _profiler.getStageCount());
+        }
+        sendFormattedResponse(EVENT_INFO, sequence, outputData);
+
+    } else if (strcmp(command,"perfreset") == 0) { //clear loop timing stats
+
+        _profiler.reset();
+        sendFormattedResponse(EVENT_INFO, sequence, "");
+
     } else if (strcmp(command,"dbg") == 0) { //enable debug output
 
         _isDebugMode = strcmp(argument,"1") == 0;
@@ -152,16 +202,23 @@ void handleTerminalCommand(char incomingData[])
         sendFormattedResponse(EVENT_INFO, sequence, outputData);
 
     } else if ((strcmp(command,"ah") == 0) || // auto home
+              (strcmp(command,"homeall") == 0) || // auto home every stepper at once
               (strcmp(command,"sh") == 0)  || // set home
               (strcmp(command,"sa") == 0)  || // set acceleration
+              (strcmp(command,"sj") == 0)  || // s-curve ramps
               (strcmp(command,"ss") == 0) ||  // set speed
               (strcmp(command,"sl") == 0) ||  // set limits
               (strcmp(command,"mt") == 0) ||  // move to
+              (strcmp(command,"rt") == 0) ||  // retarget a running move
+              (strcmp(command,"jog") == 0) || // jog at a speed
+              (strcmp(command,"mq") == 0) ||  // queue coordinated moves
+              (strcmp(command,"mqx") == 0) || // abort queued moves
               (strcmp(command,"tr") == 0) ||  // turn right
               (strcmp(command,"tl") == 0) ||  // turn left
               (strcmp(command,"l") == 0) ||   // move left
               (strcmp(command,"r") == 0) ||   // move right
               (strcmp(command,"gl") == 0) ||  // get location
+              (strcmp(command,"cal") == 0) || // stored limits and warm boot
               (strcmp(command,"ws") == 0))    // wheel speed
     {
 
@@ -169,54 +226,46 @@ void handleTerminalCommand(char incomingData[])
 
     } else if (strcmp(command, "sls") == 0) // score led show
     {
-        int slot = atoi(argument);
-        int r = atoi(argument2);
-        int g = atoi(argument3);
-        int b = atoi(argument4);
-        
-        Wire.beginTransmission(0x10);
-        Wire.write(0xFE); //header start
-        Wire.write(0x01); //command
-        Wire.write(0x01); //header end
-        Wire.write(slot);
-        Wire.write(r);
-        Wire.write(g);
-        Wire.write(b);
-        Wire.endTransmission();
+        byte args[] = { (byte)atoi(argument), (byte)atoi(argument2), (byte)atoi(argument3), (byte)atoi(argument4) }; //slot r g b
+        sendSlotLightCommand(0x01, args, sizeof(args));
         
         sendFormattedResponse(EVENT_INFO, sequence, argument);
     } else if (strcmp(command, "slss") == 0) // score led show strobe
     {
+        //slot r g b r2 g2 b2 strobeCount strobeDelay
+        byte args[] = { (byte)atoi(argument), (byte)atoi(argument2), (byte)atoi(argument3), (byte)atoi(argument4),
+            (byte)atoi(argument5), (byte)atoi(argument6), (byte)atoi(argument7), (byte)atoi(argument8), (byte)atoi(argument9) };
+        sendSlotLightCommand(0x04, args, sizeof(args));
         
-        
-        int slot = atoi(argument);
-        int r = atoi(argument2);
-        int g = atoi(argument3);
-        int b = atoi(argument4);
+        sendFormattedResponse(EVENT_INFO, sequence, argument);
+    } else if (strcmp(command, "slm") == 0) // score led show, many slots, argument is a mask with a bit per slot
+    {
+        byte args[] = { (byte)atoi(argument), (byte)atoi(argument2), (byte)atoi(argument3), (byte)atoi(argument4) }; //mask r g b
+        sendSlotLightCommand(0x05, args, sizeof(args));
 
-        int r2 = atoi(argument5);
-        int g2 = atoi(argument6);
-        int b2 = atoi(argument7);
+        sendFormattedResponse(EVENT_INFO, sequence, argument);
+    } else if (strcmp(command, "slsm") == 0) // score led show strobe, many slots
+    {
+        //mask r g b r2 g2 b2 strobeCount strobeDelay
+        byte args[] = { (byte)atoi(argument), (byte)atoi(argument2), (byte)atoi(argument3), (byte)atoi(argument4),
+            (byte)atoi(argument5), (byte)atoi(argument6), (byte)atoi(argument7), (byte)atoi(argument8), (byte)atoi(argument9) };
+        sendSlotLightCommand(0x06, args, sizeof(args));
 
-        int sc = atoi(argument8);
-        int sd = atoi(argument9);
-        
-        Wire.beginTransmission(0x10);
-        Wire.write(0xFE); //header start
-        Wire.write(0x04); //command
-        Wire.write(0x01); //header end
-        Wire.write(slot);
-        Wire.write(r);
-        Wire.write(g);
-        Wire.write(b);
-        Wire.write(r2);
-        Wire.write(g2);
-        Wire.write(b2);
-        Wire.write(sc);
-        Wire.write(sd);
-        Wire.endTransmission();
-        
         sendFormattedResponse(EVENT_INFO, sequence, argument);
+    } else if (strcmp(command, "slstat") == 0) // score led controller stats
+    {
+        //dropped,invalid,deferred,forced
+        unsigned int counters[4] = { 0, 0, 0, 0 };
+        if (Wire.requestFrom(_ledSlotControllerId, (byte)sizeof(counters)) == sizeof(counters))
+        {
+            for (byte i = 0; i < 4; i++)
+            {
+                counters[i] = Wire.read();
+                counters[i] |= Wire.read() << 8;
+            }
+        }
+        sprintf(outputData, "%u,%u,%u,%u", counters[0], counters[1], counters[2], counters[3]);
+        sendFormattedResponse(EVENT_INFO, sequence, outputData);
     } else if (strcmp(command, "flap") == 0) // flap up
     {
         int dir = atoi(argument);
@@ -254,14 +303,22 @@ void handleTerminalCommand(char incomingData[])
     } else if (strcmp(command, "bst") == 0)
     {
         _ballStopTriggerDuration = atoi(argument);
+        applyScoringTimes();
         sendFormattedResponse(EVENT_INFO, sequence, argument);
     } else if (strcmp(command, "lights") == 0)
     {
         digitalWrite(PIN_LIGHTS, atoi(argument));
         sendFormattedResponse(EVENT_INFO, sequence, argument);
-    } else if (strcmp(command, "ml") == 0)
+    } else if (strcmp(command, "cw") == 0) // 5/6 combo window in ms, replies with the window in use
     {
-        _maxSensorRechecks = atoi(argument);
+        int window = atoi(argument);
+        if (window >= 0 && window <= _scoreComboWindowMax)
+        {
+            _scoreComboWindow = window;
+            applyScoringTimes();
+        }
+        itoa(_scoreComboWindow, outputData, 10);
+        sendFormattedResponse(EVENT_INFO, sequence, outputData);
     } else if (strcmp(command, "d") == 0)
     {
          sscanf(incomingData, "%s %s %[^\n]", sequence, command, outputData);
@@ -384,6 +441,17 @@ void sendFormattedResponse(int event, char sequence[], char response[])
 }
 
 
+//one i2c transaction to the slot light controller: header, command, args
+void sendSlotLightCommand(byte command, byte args[], byte count)
+{
+    Wire.beginTransmission(_ledSlotControllerId);
+    Wire.write(0xFE); //header start
+    Wire.write(command);
+    Wire.write(0x01); //header end
+    Wire.write(args, count);
+    Wire.endTransmission();
+}
+
 void debugLine(char* message)
 {
     if (_isDebugMode)
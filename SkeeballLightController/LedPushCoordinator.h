@@ -0,0 +1,44 @@
+#ifndef LedPushCoordinator_h
+#define LedPushCoordinator_h
+
+#include "Arduino.h"
+
+/**
+ * Decides when LED strips go out so pushes don't land on top of incoming bus traffic.
+ *
+ * A WS2812 push runs with interrupts off, about 30us per led, and anything arriving on serial or i2c
+ * while it runs can be lost. Strips are marked dirty as they're drawn and nextPush() hands back one
+ * strip per time slot, never two back to back. Call noteActivity() whenever a bus is busy, it's
+ * safe from an interrupt; pushes wait until the bus has been quiet for quietTime, but never longer
+ * than maxHold so the lights can't be starved by a chatty bus. Times are millis.
+ */
+class LedPushCoordinator
+{
+  public:
+    LedPushCoordinator(byte stripCount, unsigned int slotInterval, unsigned int quietTime, unsigned int maxHold);
+    void markDirty(byte strip);
+    void noteActivity(); //a bus is busy right now, call from loop or an interrupt
+    int nextPush(unsigned long now); //strip to show now, -1 if nothing should go out
+    unsigned int getPushes(); //strips pushed
+    unsigned int getDeferred(); //pushes held back for bus traffic
+    unsigned int getForced(); //pushes that went out after maxHold with the bus still busy
+    void resetCounters();
+
+  private:
+    byte _stripCount;
+    byte _dirty; //bit per strip
+    byte _nextStrip; //where the round robin picks up
+    unsigned int _slotInterval;
+    unsigned int _quietTime;
+    unsigned int _maxHold;
+    unsigned long _lastPush;
+    volatile unsigned long _lastActivity;
+    bool _holding; //a push is due and waiting on the bus
+    unsigned long _holdStart;
+
+    unsigned int _pushes;
+    unsigned int _deferred;
+    unsigned int _forced;
+};
+
+#endif
@@ -41,6 +41,21 @@
     e.g. strube 5k slot 6 times, alternate between blue and red
     0xFE 0x01 0x01 0x04 0x00 0x00 0xFF 0xFF 0x00 0x00 0x15 0x60
 
+    Command - Show Slots: headerStart command headerEnd slotMask red green blue
+    slotMask has a bit per slot, bit 0 = slot 0
+    e.g. light every slot green
+    0xFE 0x05 0x01 0x7F 0x00 0xFF 0x00
+
+    Command - Strobe Slots: headerStart command headerEnd slotMask red green blue red2 green2 blue2 strobeCount strobeDelay
+    e.g. strobe 1000 and 2000 10 times between red and off
+    0xFE 0x06 0x01 0x03 0xFF 0x00 0x00 0x00 0x00 0x00 0x0A 0x60
+
+    Commands are queued as they arrive, up to _commandQueueSize can wait for loop() to run them.
+
+    Request - Stats: reading 8 bytes returns four little endian counters
+    commands dropped because the queue was full, commands with a bad header,
+    shows deferred for i2c traffic, shows forced out while traffic kept coming
+
 
 */
 
@@ -48,6 +63,7 @@
 #include <avr/wdt.h>
 #include <Wire.h>
 #include "FastLED.h"
+#include "LedPushCoordinator.h"
 
 
 #if defined(FASTLED_VERSION) && (FASTLED_VERSION < 3001000)
@@ -80,13 +96,28 @@ const byte _commandScoreSlot = 0x01; // Light a single slot
 const byte _commandSpiralSlot = 0x02; // Spiral lights around a slot endlessly
 const byte _commandFullPattern = 0x03; // Pattern that applies to all slots
 const byte _commandStrobeSlot = 0x04; // Strobe a single slot
+const byte _commandShowSlots = 0x05; // Light every slot in a mask
+const byte _commandStrobeSlots = 0x06; // Strobe every slot in a mask
 
-byte _commandBuffer[20];
+//the receive handler runs in the i2c interrupt, it only fills the next free entry, loop() empties them
+const byte _commandQueueSize = 4;
+const byte _commandLength = 20; //command byte plus args
+volatile byte _commandQueue[_commandQueueSize][_commandLength];
+volatile byte _commandQueueHead = 0; //next to run, only loop() moves it
+volatile byte _commandQueueTail = 0; //next free, only the interrupt moves it
+volatile byte _commandQueueCount = 0;
+
+volatile unsigned int _commandsDropped = 0; //queue was full
+volatile unsigned int _commandsInvalid = 0; //header didn't check out
+
+//a show blocks interrupts for ~3.5ms, wait for the master to go quiet before starting one
+LedPushCoordinator _ledPush(1, 1000 / FRAMES_PER_SECOND, 4, 50);
 
 void setup() {
 
     Wire.begin(0x10);
     Wire.onReceive(handleComms);
+    Wire.onRequest(handleStatsRequest);
     
 
     // tell FastLED about the LED strip configuration
@@ -108,8 +139,12 @@ void setup() {
 void loop() {
     wdt_enable(WDTO_8S);
 
-    runStrobes();
     executeCommandBuffer();
+    runStrobes();
+
+    //everything since the last show goes out in one, once the bus is quiet
+    if (_ledPush.nextPush(millis()) >= 0)
+        showStrip();
 
     // send the 'leds' array out to the actual LED strip
     //showStrip();
@@ -120,23 +155,48 @@ void loop() {
 
 void executeCommandBuffer()
 {
-    if (_commandBuffer[0] != 0xFF)
-        return;
-    
-    switch (_commandBuffer[1])
+    while (_commandQueueCount)
     {
-        case _commandScoreSlot:
-            showSlot(_commandBuffer[2], _commandBuffer[3], _commandBuffer[4], _commandBuffer[5]);
-            break;
-        case _commandStrobeSlot:
-            strobeSlot(_commandBuffer[2], _commandBuffer[3], _commandBuffer[4], _commandBuffer[5], _commandBuffer[6], _commandBuffer[7], _commandBuffer[8], _commandBuffer[9], _commandBuffer[10]);
-            break;
+        volatile byte *command = _commandQueue[_commandQueueHead];
+        byte args[_commandLength - 1];
+        for (byte i = 0; i < sizeof(args); i++)
+            args[i] = command[i + 1];
+
+        switch (command[0])
+        {
+            case _commandScoreSlot:
+                showSlot(args[0], args[1], args[2], args[3]);
+                break;
+            case _commandStrobeSlot:
+                strobeSlot(args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8]);
+                break;
+            case _commandShowSlots:
+                for (byte slot = 0; slot < 7; slot++)
+                {
+                    if (args[0] & (1 << slot))
+                        showSlot(slot, args[1], args[2], args[3]);
+                }
+                break;
+            case _commandStrobeSlots:
+                for (byte slot = 0; slot < 7; slot++)
+                {
+                    if (args[0] & (1 << slot))
+                        strobeSlot(slot, args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8]);
+                }
+                break;
+        }
+
+        _commandQueueHead = (_commandQueueHead + 1) % _commandQueueSize;
+        noInterrupts();
+        _commandQueueCount--;
+        interrupts();
     }
-    _commandBuffer[0] = 0;
 }
 
 void handleComms(int bytesRecv)
 {
+    _ledPush.noteActivity();
+
     int command = 0;
     while (Wire.available())
     {
@@ -151,23 +211,47 @@ void handleComms(int bytesRecv)
                 while(Wire.available())
                     Wire.read();
 
+                _commandsInvalid++;
                 break;
             }
             command = commandByte;
         }
-        int idx = 2;
-        memset(_commandBuffer, 0, sizeof(_commandBuffer));
-        _commandBuffer[0] = 0xFF; //we have a command ready
-        _commandBuffer[1] = command;
-        while(idx < sizeof(_commandBuffer)) //read up to 20 bytes
+
+        if (_commandQueueCount >= _commandQueueSize) //full, this one is lost
         {
-            if (!Wire.available()) { return; }
-            _commandBuffer[idx++] = Wire.read();
+            while(Wire.available())
+                Wire.read();
+            _commandsDropped++;
+            return;
         }
+
+        volatile byte *entry = _commandQueue[_commandQueueTail];
+        byte idx = 1;
+        entry[0] = command;
+        while(idx < _commandLength && Wire.available()) //read up to 19 args
+            entry[idx++] = Wire.read();
+        while(idx < _commandLength)
+            entry[idx++] = 0;
+
+        _commandQueueTail = (_commandQueueTail + 1) % _commandQueueSize;
+        _commandQueueCount++; //we're in the interrupt, nothing can get between
+        return;
     }
 }
 
 
+//master asked for stats, runs in the i2c interrupt
+void handleStatsRequest()
+{
+    unsigned int counters[] = { _commandsDropped, _commandsInvalid, _ledPush.getDeferred(), _ledPush.getForced() };
+    byte data[sizeof(counters)];
+    for (byte i = 0; i < 4; i++)
+    {
+        data[i * 2] = counters[i] & 0xFF;
+        data[i * 2 + 1] = counters[i] >> 8;
+    }
+    Wire.write(data, sizeof(data));
+}
 
 void runStrobes()
 {
@@ -224,7 +308,7 @@ void showSlot(byte slot, byte r, byte g, byte b)
     
     for(int slot = slotStart; slot < slotStart + _slotLedCount; slot++)
         setPixel(slot, r, g, b);
-    showStrip();
+    _ledPush.markDirty(0);
 }
 
 void showStrip() {
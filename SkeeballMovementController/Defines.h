@@ -4,6 +4,13 @@
 #define STEPPER_HOME_LIMIT 1
 #define STEPPER_END_LIMIT 2
 
+#define STEP_PULSE_MICROS 15 //we have to hold step high for at least 5us but we do a little longer just in case
+#define TIMER_TICK_MICROS 4 //Timer1 runs with a /64 prescaler when driving steppers
+#define TIMER_MIN_TICKS 25 //never schedule timer steps closer than 100uS apart
+#define TIMER_PULSE_TICKS ((STEP_PULSE_MICROS + TIMER_TICK_MICROS - 1) / TIMER_TICK_MICROS) //step pulse in timer ticks, also the soonest a compare is scheduled
+#define RAMP_TABLE_SIZE 32 //entries in the precomputed accel/decel interval table
+#define JOG_RUN_STEPS 1000000l //how far a jog aims when the axis has no soft limits
+
 #define EVENT_INFO              900 //generic info
 #define EVENT_PONG              101 //generic info
 #define EVENT_MOVE_COMPLETE     400 //movement given is complete
@@ -15,6 +22,8 @@
 #define EVENT_HOMING_COMPLETE   406
 #define EVENT_MOVE_STARTED      407 //movement given started
 #define EVENT_STARTUP           408 //movement given started
+#define EVENT_QUEUE_COMPLETE    409 //all queued coordinated moves finished
+#define EVENT_HOMING_ALL_COMPLETE 410 //homeall finished, result and ms per stepper
 
 
 #define PIN_03 3
@@ -0,0 +1,50 @@
+#ifndef FastStepperController_h
+#define FastStepperController_h
+
+#include "Arduino.h"
+#include "StepperController.h"
+#include "DigitalWriteFast.h"
+
+/**
+ * StepperController with its pins fixed at compile time. Step pulses and limit reads resolve to a single
+ * port instruction with no pin lookup, and the Timer1 ISR is built around them with no virtual calls.
+ * Use -1 for a missing home or end switch.
+ */
+template <int StepPin, int DirPin, int EnablePin, int HomePin, int EndPin>
+class FastStepperController : public StepperController
+{
+  public:
+    FastStepperController() : StepperController(StepPin, DirPin, EnablePin, HomePin, EndPin)
+    {
+    }
+
+  protected:
+    friend class StepperController; //timerStep() calls the pin functions below directly
+
+    void onTimerStep()
+    {
+        this->timerStep(this);
+    }
+
+    void stepPinHigh()
+    {
+        digitalWriteFast(StepPin, HIGH);
+    }
+
+    void stepPinLow()
+    {
+        digitalWriteFast(StepPin, LOW);
+    }
+
+    int readHomeSwitch()
+    {
+        return digitalReadFast(HomePin < 0 ? 0 : HomePin) ? HIGH : LOW;
+    }
+
+    int readEndSwitch()
+    {
+        return digitalReadFast(EndPin < 0 ? 0 : EndPin) ? HIGH : LOW;
+    }
+};
+
+#endif
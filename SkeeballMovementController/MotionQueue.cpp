@@ -0,0 +1,215 @@
+#include "Arduino.h"
+#include "Defines.h"
+#include "MotionQueue.h"
+
+
+MotionQueue::MotionQueue(StepperController *axisA, StepperController *axisB)
+{
+    _axisA = axisA;
+    _axisB = axisB;
+    _head = 0;
+    _count = 0;
+    _running = false;
+    _handedOff = false;
+    _master = 0;
+    _queueCompleteEventFunction = 0;
+}
+
+void MotionQueue::setEventQueueComplete(void (*eventFunction)())
+{
+    _queueCompleteEventFunction = eventFunction;
+}
+
+bool MotionQueue::add(long targetA, long targetB, unsigned int duration)
+{
+    if (_count >= MOTION_QUEUE_SIZE)
+        return false;
+    if (!_axisA->isWithinLimits(targetA) || !_axisB->isWithinLimits(targetB))
+        return false; //the follower would be stopped at its limit and the rest of the batch dropped
+
+    MotionSegment *segment = &_segments[(_head + _count) % MOTION_QUEUE_SIZE];
+    segment->targetA = targetA;
+    segment->targetB = targetB;
+    segment->duration = duration;
+    _count++;
+    return true;
+}
+
+void MotionQueue::clear()
+{
+    _count = 0;
+    if (!_running)
+        return;
+
+    if (_master && _master->isRunning())
+        _master->stop();
+    this->finish();
+}
+
+bool MotionQueue::isRunning()
+{
+    return _running;
+}
+
+byte MotionQueue::count()
+{
+    return _count;
+}
+
+void MotionQueue::run()
+{
+    if (!_running)
+    {
+        if (_count == 0)
+            return;
+
+        //the queue owns both axes until it empties, single move events would be noise
+        _savedSpeedA = _axisA->getMaxSpeed();
+        _savedSpeedB = _axisB->getMaxSpeed();
+        _axisA->setEventsEnabled(false);
+        _axisB->setEventsEnabled(false);
+        _running = true;
+        this->startSegment();
+        return;
+    }
+
+    if (_master)
+    {
+        //the master has carried on into the segment we handed it
+        if (_handedOff && !_master->hasNextMove())
+        {
+            _handedOff = false;
+            long fromA = _current.targetA;
+            long fromB = _current.targetB;
+            this->popSegment();
+            this->setDeltas(_current.targetA - fromA, _current.targetB - fromB);
+            if (_master->isRunning())
+                this->handOff();
+        }
+        if (_master->isRunning())
+            return;
+
+        //stopped short, something hit a limit so the rest of the batch is meaningless
+        if (_axisA->getPosition() != _current.targetA || _axisB->getPosition() != _current.targetB)
+        {
+            _count = 0;
+            this->finish();
+            return;
+        }
+    } else if (millis() - _dwellStart < _current.duration) {
+        return;
+    }
+
+    if (_count == 0)
+        this->finish();
+    else
+        this->startSegment();
+}
+
+void MotionQueue::startSegment()
+{
+    this->popSegment();
+
+    long deltaA = _current.targetA - _axisA->getPosition();
+    long deltaB = _current.targetB - _axisB->getPosition();
+
+    if (deltaA == 0 && deltaB == 0) //nothing to move, wait out the duration
+    {
+        _master = 0;
+        _dwellStart = millis();
+        return;
+    }
+
+    this->setDeltas(deltaA, deltaB);
+    StepperController *follower = _masterIsA ? _axisB : _axisA;
+    long target = _masterIsA ? _current.targetA : _current.targetB;
+    int speed = _masterIsA ? _savedSpeedA : _savedSpeedB;
+
+    //cruise speed that covers the travel in the requested time, never faster than the axis is set for
+    if (_current.duration > 0)
+    {
+        long wanted = (labs(_masterDelta) * 1000l) / (long)_current.duration;
+        if (wanted < 1)
+            wanted = 1;
+        if (wanted < speed)
+            speed = (int)wanted;
+    }
+    if (speed != _master->getMaxSpeed())
+        _master->setMaxSpeed(speed);
+
+    if (_followerDelta != 0)
+    {
+        follower->setDirection(_followerDelta > 0 ? DIRECTION_FORWARD : DIRECTION_REVERSE);
+        follower->disableController(0); //enable the follower, the master enables itself on start
+        _master->setFollower(follower, _followerDelta);
+    }
+    _master->moveTo(target);
+    this->handOff();
+}
+
+void MotionQueue::popSegment()
+{
+    _current = _segments[_head];
+    _head = (_head + 1) % MOTION_QUEUE_SIZE;
+    _count--;
+}
+
+void MotionQueue::setDeltas(long deltaA, long deltaB)
+{
+    _masterIsA = labs(deltaA) >= labs(deltaB);
+    _master = _masterIsA ? _axisA : _axisB;
+    _masterDelta = _masterIsA ? deltaA : deltaB;
+    _followerDelta = _masterIsA ? deltaB : deltaA;
+}
+
+/**
+ * Lookahead. A full speed segment followed by another on the same master axis is handed over while the
+ * master is still running, so it reaches the join at speed and carries straight on. Only when neither axis
+ * turns round at the join, a reversal needs a stop.
+ */
+void MotionQueue::handOff()
+{
+    if (_count == 0 || _current.duration != 0 || !_master->isRunning())
+        return;
+
+    MotionSegment *next = &_segments[_head];
+    if (next->duration != 0)
+        return; //slower segment, its cruise speed needs a fresh ramp
+
+    long nextA = next->targetA - _current.targetA;
+    long nextB = next->targetB - _current.targetB;
+    bool nextMasterIsA = labs(nextA) >= labs(nextB);
+    long nextMasterDelta = nextMasterIsA ? nextA : nextB;
+    long nextFollowerDelta = nextMasterIsA ? nextB : nextA;
+    if (nextMasterIsA != _masterIsA || nextMasterDelta == 0 || (nextMasterDelta > 0) != (_masterDelta > 0))
+        return;
+    if (nextFollowerDelta != 0 && _followerDelta != 0 && (nextFollowerDelta > 0) != (_followerDelta > 0))
+        return;
+
+    StepperController *follower = _masterIsA ? _axisB : _axisA;
+    if (nextFollowerDelta != 0 && _followerDelta == 0)
+    {
+        //follower sits still for the rest of this segment, safe to point it now
+        follower->setDirection(nextFollowerDelta > 0 ? DIRECTION_FORWARD : DIRECTION_REVERSE);
+        follower->disableController(0);
+    }
+    _master->setNextMove(nextMasterDelta, follower, nextFollowerDelta);
+    _handedOff = true;
+}
+
+void MotionQueue::finish()
+{
+    _running = false;
+    _handedOff = false;
+    _master = 0;
+
+    if (_axisA->getMaxSpeed() != _savedSpeedA)
+        _axisA->setMaxSpeed(_savedSpeedA);
+    if (_axisB->getMaxSpeed() != _savedSpeedB)
+        _axisB->setMaxSpeed(_savedSpeedB);
+    _axisA->setEventsEnabled(true);
+    _axisB->setEventsEnabled(true);
+
+    if (_queueCompleteEventFunction)
+        (*_queueCompleteEventFunction)();
+}
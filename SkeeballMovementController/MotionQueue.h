@@ -0,0 +1,58 @@
+#ifndef MotionQueue_h
+#define MotionQueue_h
+
+#include "Arduino.h"
+#include "StepperController.h"
+
+#define MOTION_QUEUE_SIZE 8 //how many segments can be waiting
+
+struct MotionSegment
+{
+    long targetA; //absolute position for the first axis
+    long targetB; //absolute position for the second axis
+    unsigned int duration; //ms the segment should take at cruise speed, 0 = as fast as allowed
+};
+
+/**
+ * Runs a batch of two axis targets back to back. For each segment the axis with the longer travel runs
+ * its motion profile and steps the other axis alongside it so both arrive together. A segment with no
+ * travel is a dwell for its duration. Segments that carry on the same way at full speed are handed to
+ * the running axis before it arrives so it never stops in between.
+ */
+class MotionQueue
+{
+  public:
+    MotionQueue(StepperController *axisA, StepperController *axisB);
+    bool add(long targetA, long targetB, unsigned int duration); //queue a segment, false if the queue is full or a target is outside the soft limits
+    void clear(); //drop anything queued and stop the axes
+    void run(); //call every loop, starts the next segment once the current one is done
+    bool isRunning(); //true while segments are being executed
+    byte count(); //how many segments are waiting
+    void setEventQueueComplete(void (*eventFunction)());
+
+  private:
+    StepperController *_axisA;
+    StepperController *_axisB;
+    MotionSegment _segments[MOTION_QUEUE_SIZE];
+    byte _head; //next segment to run
+    byte _count; //segments waiting
+    bool _running; //executing a segment
+    MotionSegment _current; //segment being executed
+    StepperController *_master; //axis running the profile for the current segment, 0 for a dwell
+    bool _masterIsA; //axis A is the master for the current segment
+    long _masterDelta; //master travel over the current segment
+    long _followerDelta; //follower travel over the current segment
+    bool _handedOff; //the next segment has been given to the running master, still at _head until it starts
+    unsigned long _dwellStart; //when the current dwell started
+    int _savedSpeedA; //max speed to restore once the queue finishes
+    int _savedSpeedB;
+
+    void startSegment();
+    void popSegment(); //take the segment at _head as the current one
+    void setDeltas(long deltaA, long deltaB); //pick the master for the current segment's travel
+    void handOff(); //give the next segment to the running master if it can carry straight on
+    void finish();
+    void (*_queueCompleteEventFunction)(); //execute when every queued segment has run
+};
+
+#endif
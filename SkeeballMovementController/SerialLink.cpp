@@ -0,0 +1,387 @@
+#include "SerialLink.h"
+
+SerialLink::SerialLink(Stream &port)
+{
+    _port = &port;
+    _receiveHandler = 0;
+
+    _txHead = 0;
+    _txCount = 0;
+    _nextSeq = 0;
+    _synced = false;
+    for (byte i = 0; i < SERIAL_LINK_QUEUE; i++)
+        _tx[i].state = TX_FREE;
+
+    _rxHead = 0;
+    _expectedSeq = 0;
+    _rxSynced = false;
+    _rxSyncSession = false;
+    _rxSyncBase = 0;
+    _rxSyncAt = 0;
+    _rxState = RX_SOF;
+    for (byte i = 0; i < SERIAL_LINK_WINDOW; i++)
+    {
+        _rx[i].filled = false;
+        _rxCrc[i] = 0;
+    }
+
+    _dropped = 0;
+    _failed = 0;
+    _crcErrors = 0;
+}
+
+void SerialLink::setReceiveHandler(void (*handler)(char message[]))
+{
+    _receiveHandler = handler;
+}
+
+bool SerialLink::send(const char message[])
+{
+    if (_txCount >= SERIAL_LINK_QUEUE)
+    {
+        _dropped++;
+        return false;
+    }
+
+    TxSlot &slot = _tx[(_txHead + _txCount) % SERIAL_LINK_QUEUE];
+    _txCount++;
+
+    byte len = 0;
+    while (message[len] && len < SERIAL_LINK_MAX_PAYLOAD)
+    {
+        slot.data[len] = message[len];
+        len++;
+    }
+    slot.len = len;
+    slot.state = TX_QUEUED;
+
+    transmitQueued();
+    return true;
+}
+
+void SerialLink::poll()
+{
+    readPort();
+    retransmit();
+    transmitQueued();
+}
+
+byte SerialLink::pending()
+{
+    return _txCount;
+}
+
+bool SerialLink::isReceiving()
+{
+    return _rxState != RX_SOF || _port->available();
+}
+
+unsigned int SerialLink::getDropped()
+{
+    return _dropped;
+}
+
+unsigned int SerialLink::getFailed()
+{
+    return _failed;
+}
+
+unsigned int SerialLink::getCrcErrors()
+{
+    return _crcErrors;
+}
+
+byte SerialLink::crc8(byte crc, byte data)
+{
+    crc ^= data;
+    for (byte i = 0; i < 8; i++)
+        crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    return crc;
+}
+
+/*
+
+Sending
+
+*/
+
+//oldest seq still waiting on an ack, or the next seq if nothing is in flight
+byte SerialLink::baseSeq()
+{
+    for (byte i = 0; i < _txCount; i++)
+    {
+        TxSlot &slot = _tx[(_txHead + i) % SERIAL_LINK_QUEUE];
+        if (slot.state == TX_SENT)
+            return slot.seq;
+    }
+    return _nextSeq;
+}
+
+void SerialLink::transmit(TxSlot &slot)
+{
+    byte frame[SERIAL_LINK_MAX_PAYLOAD + 6];
+    byte len = 0;
+
+    frame[len++] = SERIAL_LINK_SOF;
+    frame[len++] = _synced ? SERIAL_LINK_DATA : SERIAL_LINK_DATA | SERIAL_LINK_SYNC;
+    frame[len++] = slot.seq;
+    frame[len++] = baseSeq();
+    frame[len++] = slot.len;
+    for (byte i = 0; i < slot.len; i++)
+        frame[len++] = slot.data[i];
+
+    byte crc = 0;
+    for (byte i = 1; i < len; i++)
+        crc = crc8(crc, frame[i]);
+    frame[len++] = crc;
+
+    _port->write(frame, len);
+    slot.sentAt = millis();
+}
+
+//put queued messages on the wire while the window has room
+void SerialLink::transmitQueued()
+{
+    for (byte i = 0; i < _txCount; i++)
+    {
+        TxSlot &slot = _tx[(_txHead + i) % SERIAL_LINK_QUEUE];
+        if (slot.state != TX_QUEUED)
+            continue;
+
+        if ((byte)(_nextSeq - baseSeq()) >= SERIAL_LINK_WINDOW)
+            return;
+
+        slot.seq = _nextSeq++;
+        slot.retries = 0;
+        slot.state = TX_SENT;
+        transmit(slot);
+    }
+}
+
+//resend anything that hasn't been acked in time, give up after enough tries
+void SerialLink::retransmit()
+{
+    for (byte i = 0; i < _txCount; i++)
+    {
+        TxSlot &slot = _tx[(_txHead + i) % SERIAL_LINK_QUEUE];
+        if (slot.state != TX_SENT || millis() - slot.sentAt < SERIAL_LINK_RETRY_MS)
+            continue;
+
+        if (slot.retries >= SERIAL_LINK_MAX_RETRIES)
+        {
+            slot.state = TX_FREE; //the next frame's base tells the other end to skip it
+            _failed++;
+            continue;
+        }
+
+        slot.retries++;
+        transmit(slot);
+    }
+    releaseHead();
+}
+
+void SerialLink::handleAck(byte seq)
+{
+    _synced = true;
+    for (byte i = 0; i < _txCount; i++)
+    {
+        TxSlot &slot = _tx[(_txHead + i) % SERIAL_LINK_QUEUE];
+        if (slot.state == TX_SENT && slot.seq == seq)
+        {
+            slot.state = TX_FREE;
+            break;
+        }
+    }
+    releaseHead();
+}
+
+//acks can arrive out of order, only free slots off the front of the ring
+void SerialLink::releaseHead()
+{
+    while (_txCount && _tx[_txHead].state == TX_FREE)
+    {
+        _txHead = (_txHead + 1) % SERIAL_LINK_QUEUE;
+        _txCount--;
+    }
+}
+
+/*
+
+Receiving
+
+*/
+
+void SerialLink::sendAck(byte seq)
+{
+    byte frame[6];
+    frame[0] = SERIAL_LINK_SOF;
+    frame[1] = SERIAL_LINK_ACK;
+    frame[2] = seq;
+    frame[3] = _expectedSeq;
+    frame[4] = 0;
+
+    byte crc = 0;
+    for (byte i = 1; i < 5; i++)
+        crc = crc8(crc, frame[i]);
+    frame[5] = crc;
+
+    _port->write(frame, 6);
+}
+
+//byte at a time state machine, only reads what is already buffered
+void SerialLink::readPort()
+{
+    while (_port->available())
+    {
+        byte b = _port->read();
+        switch (_rxState)
+        {
+        case RX_SOF:
+            if (b == SERIAL_LINK_SOF)
+            {
+                _frameCrc = 0;
+                _rxState = RX_TYPE;
+            }
+            break;
+        case RX_TYPE:
+            _frameType = b;
+            _frameCrc = crc8(_frameCrc, b);
+            _rxState = RX_SEQ;
+            break;
+        case RX_SEQ:
+            _frameSeq = b;
+            _frameCrc = crc8(_frameCrc, b);
+            _rxState = RX_BASE;
+            break;
+        case RX_BASE:
+            _frameBase = b;
+            _frameCrc = crc8(_frameCrc, b);
+            _rxState = RX_LEN;
+            break;
+        case RX_LEN:
+            if (b > SERIAL_LINK_MAX_PAYLOAD) //can't be a real frame, look for the next start byte
+            {
+                _crcErrors++;
+                _rxState = RX_SOF;
+                break;
+            }
+            _frameLen = b;
+            _frameIdx = 0;
+            _frameCrc = crc8(_frameCrc, b);
+            _rxState = b ? RX_PAYLOAD : RX_CRC;
+            break;
+        case RX_PAYLOAD:
+            _frame[_frameIdx++] = b;
+            _frameCrc = crc8(_frameCrc, b);
+            if (_frameIdx >= _frameLen)
+                _rxState = RX_CRC;
+            break;
+        case RX_CRC:
+            _rxState = RX_SOF;
+            if (b != _frameCrc)
+            {
+                _crcErrors++;
+                break;
+            }
+            handleFrame();
+            break;
+        }
+    }
+}
+
+void SerialLink::handleFrame()
+{
+    byte type = _frameType & ~SERIAL_LINK_SYNC;
+    if (type == SERIAL_LINK_ACK)
+        handleAck(_frameSeq);
+    else if (type == SERIAL_LINK_DATA)
+        handleData(_frameSeq, _frameBase, _frameType & SERIAL_LINK_SYNC);
+}
+
+void SerialLink::handleData(byte seq, byte base, bool sync)
+{
+    //the sender flags its frames until it hears an ack, so a flagged frame after plain ones means it restarted.
+    //While it's flagging, base only moves forward and a frame we already took can only come again as a resend:
+    //the same bytes, inside the sender's retry time. Anything else is the sender starting over
+    bool restarted = false;
+    if (sync)
+    {
+        byte behind = _expectedSeq - seq;
+        if (!_rxSyncSession || (byte)(base - _rxSyncBase) >= 128)
+            restarted = true;
+        else if (behind && behind <= 128)
+            restarted = behind > SERIAL_LINK_WINDOW
+                || _rxCrc[seq % SERIAL_LINK_WINDOW] != _frameCrc
+                || millis() - _rxSyncAt > (unsigned long)SERIAL_LINK_RETRY_MS * (SERIAL_LINK_MAX_RETRIES + 1);
+        _rxSyncBase = base;
+    }
+    _rxSyncSession = sync;
+
+    if (!_rxSynced || restarted)
+    {
+        //we or the other end restarted, take its numbering
+        _rxSynced = true;
+        for (byte i = 0; i < SERIAL_LINK_WINDOW; i++)
+            _rx[i].filled = false;
+        _expectedSeq = base;
+    }
+    else
+    {
+        byte skip = base - _expectedSeq;
+        if (skip && skip < 128) //sender gave up on frames we never got
+            advanceTo(base);
+    }
+
+    byte ahead = seq - _expectedSeq;
+    if (ahead < SERIAL_LINK_WINDOW)
+    {
+        sendAck(seq);
+        RxSlot &slot = _rx[(_rxHead + ahead) % SERIAL_LINK_WINDOW];
+        if (!slot.filled)
+        {
+            _rxCrc[seq % SERIAL_LINK_WINDOW] = _frameCrc;
+            if (sync)
+                _rxSyncAt = millis();
+            memcpy(slot.data, _frame, _frameLen);
+            slot.data[_frameLen] = '\0';
+            slot.len = _frameLen;
+            slot.filled = true;
+        }
+        deliver();
+    }
+    else if ((byte)(_expectedSeq - seq) <= 128)
+    {
+        sendAck(seq); //already delivered, our ack was lost
+    }
+}
+
+//move the window up to seq, delivering anything we had buffered on the way
+void SerialLink::advanceTo(byte seq)
+{
+    while (_expectedSeq != seq)
+    {
+        RxSlot &slot = _rx[_rxHead];
+        _rxHead = (_rxHead + 1) % SERIAL_LINK_WINDOW;
+        _expectedSeq++;
+        if (slot.filled)
+        {
+            slot.filled = false;
+            if (_receiveHandler)
+                _receiveHandler(slot.data);
+        }
+    }
+}
+
+//hand over every message we have in order
+void SerialLink::deliver()
+{
+    while (_rx[_rxHead].filled)
+    {
+        RxSlot &slot = _rx[_rxHead];
+        slot.filled = false;
+        _rxHead = (_rxHead + 1) % SERIAL_LINK_WINDOW;
+        _expectedSeq++;
+        if (_receiveHandler)
+            _receiveHandler(slot.data);
+    }
+}
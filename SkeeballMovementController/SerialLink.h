@@ -0,0 +1,119 @@
+#ifndef SerialLink_h
+#define SerialLink_h
+
+#include "Arduino.h"
+
+//a sketch short on RAM can put its own sizes in SerialLinkConfig.h next to this file
+#if defined(__has_include)
+#if __has_include("SerialLinkConfig.h")
+#include "SerialLinkConfig.h"
+#endif
+#endif
+
+#define SERIAL_LINK_MAX_PAYLOAD 64 //longest message in bytes, longer messages are truncated
+#ifndef SERIAL_LINK_WINDOW
+#define SERIAL_LINK_WINDOW 4 //frames allowed in flight before we wait for an ack, both ends of a link must agree
+#endif
+#ifndef SERIAL_LINK_QUEUE
+#define SERIAL_LINK_QUEUE 6 //messages we can hold, in flight plus waiting for the window
+#endif
+#define SERIAL_LINK_RETRY_MS 300 //resend a frame if it isn't acked in this time
+#define SERIAL_LINK_MAX_RETRIES 5 //give up on a frame after this many resends
+
+#define SERIAL_LINK_SOF 0x7E //start of every frame
+#define SERIAL_LINK_DATA 0x01 //frame carries a message
+#define SERIAL_LINK_ACK 0x02 //frame acknowledges one data frame
+#define SERIAL_LINK_SYNC 0x80 //flag on data frames until the other end acks one, lets it resync after we reboot
+
+/**
+ * Message link between two boards over a serial port.
+ *
+ * Frame: SOF, type, seq, base, len, payload[len], crc8 of type through payload
+ *
+ * Every data frame gets its own ack so only lost frames are resent. Up to SERIAL_LINK_WINDOW frames
+ * can be in flight, anything past that waits in the queue. base is the oldest frame the sender still
+ * has in flight; when the sender gives up on a frame the receiver uses it to skip the gap. Messages
+ * are always delivered in the order they were sent. Call poll() every loop, it never waits on the port.
+ */
+class SerialLink
+{
+  public:
+    SerialLink(Stream &port);
+    bool send(const char message[]); //queue a message, false if the queue is full
+    void poll(); //read what has arrived, deliver messages, resend anything overdue
+    void setReceiveHandler(void (*handler)(char message[])); //called with each message, in order
+    byte pending(); //messages queued or in flight
+    bool isReceiving(); //a frame is partway in or bytes are waiting to be read
+    unsigned int getDropped(); //messages refused because the queue was full
+    unsigned int getFailed(); //messages abandoned after SERIAL_LINK_MAX_RETRIES
+    unsigned int getCrcErrors(); //frames thrown away for a bad crc or length, usually bytes lost on the wire
+
+  private:
+    enum TxState { TX_FREE, TX_QUEUED, TX_SENT };
+    enum RxState { RX_SOF, RX_TYPE, RX_SEQ, RX_BASE, RX_LEN, RX_PAYLOAD, RX_CRC };
+
+    struct TxSlot
+    {
+        byte state;
+        byte seq;
+        byte retries;
+        byte len;
+        unsigned long sentAt;
+        char data[SERIAL_LINK_MAX_PAYLOAD];
+    };
+
+    struct RxSlot
+    {
+        bool filled;
+        byte len;
+        char data[SERIAL_LINK_MAX_PAYLOAD + 1];
+    };
+
+    Stream *_port;
+    void (*_receiveHandler)(char message[]);
+
+    //sending
+    TxSlot _tx[SERIAL_LINK_QUEUE]; //ring, oldest message at _txHead
+    byte _txHead;
+    byte _txCount;
+    byte _nextSeq; //seq for the next frame we put on the wire
+    bool _synced; //the other end has acked something since we started
+
+    //receiving
+    RxSlot _rx[SERIAL_LINK_WINDOW]; //reorder buffer, _rxHead holds _expectedSeq
+    byte _rxHead;
+    byte _expectedSeq; //next seq we deliver
+    bool _rxSynced; //we have taken the other end's numbering since we started
+    bool _rxSyncSession; //the last data frame had SERIAL_LINK_SYNC, the other end hasn't heard an ack yet
+    byte _rxSyncBase; //base of the last SERIAL_LINK_SYNC frame
+    unsigned long _rxSyncAt; //when we last took a new SERIAL_LINK_SYNC frame
+    byte _rxCrc[SERIAL_LINK_WINDOW]; //crc of the frames we took last, by seq, to tell a resend from a new frame
+    byte _rxState;
+    byte _frameType;
+    byte _frameSeq;
+    byte _frameBase;
+    byte _frameLen;
+    byte _frameIdx;
+    byte _frameCrc;
+    char _frame[SERIAL_LINK_MAX_PAYLOAD];
+
+    unsigned int _dropped;
+    unsigned int _failed;
+    unsigned int _crcErrors;
+
+    static byte crc8(byte crc, byte data);
+    void readPort();
+    void handleFrame();
+    void handleAck(byte seq);
+    void handleData(byte seq, byte base, bool sync);
+    void advanceTo(byte seq);
+    void deliver();
+    void sendAck(byte seq);
+    void transmit(TxSlot &slot);
+    void transmitQueued();
+    void retransmit();
+    void releaseHead();
+    byte baseSeq();
+};
+
+#endif
@@ -2,6 +2,10 @@
 #include <Wire.h>
 #include "Defines.h"
 #include "StepperController.h"
+#include "FastStepperController.h"
+#include "MotionQueue.h"
+#include "SerialLink.h"
+#include "CalibrationStore.h"
 #include "DigitalWriteFast.h"
 
 HardwareSerial &clawController = Serial1;
@@ -19,8 +23,10 @@ const int _PAN_Enable = PIN_09;
 const int _PAN_SwPin = PIN_14;
 const int _PAN_SwPin2 = PIN_15;
 
-StepperController stepperLR(_LR_StepPin, _LR_DirPin, _LR_Enable, _LR_SwPin, _LR_SwPin2);
-StepperController stepperPAN(_PAN_StepPin, _PAN_DirPin, _PAN_Enable, _PAN_SwPin, _PAN_SwPin2);
+FastStepperController<_LR_StepPin, _LR_DirPin, _LR_Enable, _LR_SwPin, _LR_SwPin2> stepperLR;
+FastStepperController<_PAN_StepPin, _PAN_DirPin, _PAN_Enable, _PAN_SwPin, _PAN_SwPin2> stepperPAN;
+
+MotionQueue motionQueue(&stepperLR, &stepperPAN); //coordinated LR/PAN moves
 
 
 const byte WHEEL_MOTOR_COMMAND_CLEAR_SAFE_START = 0x83;
@@ -39,26 +45,47 @@ unsigned short _sequence = 0;
 
 byte curMsgId = 0;
 
-const char RTS = '{'; //request to send data
-const char CS = '}'; // complete send data
-const char CTS = '!'; //clear to send data
 
 
 
-const byte _numChars = 32;
+const byte _numChars = 64;
 const byte _numArgChars = 8;
 const char _commandDelimiter = '\n';
 char _incomingCommand[_numChars]; // an array to store the received data from wifi controller
-char _sTerminalIncomingCommand[_numChars]; // an array to store the received data
-char _lastTerminalMessage[_numChars]; //led message
-unsigned long _waitForTerminalAckTimestamp = 0; //time we sent last led message
-byte _waitForTerminalAckCount = 0; //retry counter
+SerialLink _terminalLink(clawController); //framed link to the skeeball controller
+
+//stepper limits kept in EEPROM so a reset doesn't need a run to the end switches
+struct MovementCalibration
+{
+    long limits[2][2]; //upper, lower for LR then PAN
+    bool warmBoot; //home both steppers at boot and trust the stored limits
+};
+
+const byte CALIBRATION_VERSION = 1; //bump when MovementCalibration changes
+const int _memCalibration = 0; //first of the calibration slots, see CalibrationStore
+CalibrationStore _calibration(_memCalibration, sizeof(MovementCalibration), 8, CALIBRATION_VERSION);
+MovementCalibration _calibrationRecord; //what is stored, or would be once both steppers stop
+bool _warmBoot = true; //home at boot with the stored limits
+
+//homeall: every stepper homes at once and one EVENT_HOMING_ALL_COMPLETE reports them together
+const byte HOME_ALL_HOMING = 2; //still looking for the home switch
+const byte HOME_ALL_DONE = 1; //found home and backed off it
+const byte HOME_ALL_STOPPED = 0; //stopped before finding home
+const byte HOME_ALL_TIMEOUT = 3; //gave up after _homeAllTimeout
+StepperController *_homeAllSteppers[] = { &stepperLR, &stepperPAN }; //index + 1 is the stepper id
+const byte _homeAllCount = 2;
+bool _homeAllActive = false;
+unsigned long _homeAllTimeout = 15000; //ms an axis gets to find home
+unsigned long _timestampHomeAllStart = 0;
+byte _homeAllResults[_homeAllCount];
+unsigned long _homeAllTimes[_homeAllCount]; //ms each axis took to finish, or to fail
 
 
 void setup() {
     Serial.begin(115200);
     Wire.begin();
     clawController.begin(115200);
+    _terminalLink.setReceiveHandler(handleTerminalMessage);
     stepperLR.setId(1);
     stepperLR.setLimitTriggerState(HIGH);
     stepperLR.setEventLimitHome(eventHitHomeLimit);
@@ -79,22 +106,143 @@ void setup() {
     stepperPAN.setAccel(9);
     stepperPAN.setMaxSpeed(400);
     stepperPAN.disableController(1);
+
+    //step pulses come from Timer1 so serial and I2C traffic can't stall them
+    stepperLR.attachTimer(0);
+    stepperPAN.attachTimer(1);
+
+    motionQueue.setEventQueueComplete(eventQueueComplete);
+
+    bool warm = loadCalibration() && _warmBoot;
+
     Serial.println("Starting Up");
     delay(1000);
 
-    sendFormattedResponse(EVENT_STARTUP, "0", "");
+    sendFormattedResponse(EVENT_STARTUP, "0", warm ? "1" : "0");
+
+    //limits are already known, the home switches are all that's left to find
+    if (warm)
+    {
+        startHomeAll();
+        sendFormattedResponse(EVENT_HOMING_STARTED, "0", "0");
+    }
 }
 
 void loop() {
     wdt_enable(WDTO_8S);
     handleTerminalSerialCommands();
     runSteppers(); 
+    checkHomeAll();
+    checkCalibration();
+}
+
+void startHomeAll()
+{
+    motionQueue.clear();
+    _homeAllActive = true;
+    _timestampHomeAllStart = millis();
+    for (byte i = 0; i < _homeAllCount; i++)
+    {
+        _homeAllSteppers[i]->getLastHomeCompleted(); //drop a flag left from an earlier home
+        _homeAllSteppers[i]->setEventsEnabled(false); //one event for all of them
+        _homeAllResults[i] = HOME_ALL_HOMING;
+        _homeAllTimes[i] = 0;
+        _homeAllSteppers[i]->autoHome();
+    }
+}
+
+//note each axis as it finishes, fails or runs out of time, report once they all have
+void checkHomeAll()
+{
+    if (!_homeAllActive)
+        return;
+
+    unsigned long elapsed = millis() - _timestampHomeAllStart;
+    bool homing = false;
+    for (byte i = 0; i < _homeAllCount; i++)
+    {
+        if (_homeAllResults[i] != HOME_ALL_HOMING)
+            continue;
+
+        StepperController *stepper = _homeAllSteppers[i];
+        if (stepper->getLastHomeCompleted())
+            _homeAllResults[i] = HOME_ALL_DONE;
+        else if (!stepper->isRunning())
+            _homeAllResults[i] = HOME_ALL_STOPPED;
+        else if (elapsed > _homeAllTimeout)
+        {
+            stepper->stop();
+            stepper->disableController(1);
+            _homeAllResults[i] = HOME_ALL_TIMEOUT;
+        }
+        else
+        {
+            homing = true;
+            continue;
+        }
+        _homeAllTimes[i] = elapsed;
+    }
+
+    if (homing)
+        return;
+
+    _homeAllActive = false;
+    for (byte i = 0; i < _homeAllCount; i++)
+    {
+        _homeAllSteppers[i]->disableController(1); //the per stepper events that would have done this were muted
+        _homeAllSteppers[i]->setEventsEnabled(true);
+    }
+
+    //"result ms" per stepper in id order
+    static char outputData[40];
+    sprintf(outputData, "%i %lu %i %lu", _homeAllResults[0], _homeAllTimes[0], _homeAllResults[1], _homeAllTimes[1]);
+    sendFormattedResponse(EVENT_HOMING_ALL_COMPLETE, "0", outputData);
+}
+
+//restore limits from EEPROM, false if nothing good is stored
+bool loadCalibration()
+{
+    if (!_calibration.load(&_calibrationRecord))
+    {
+        fillCalibration(_calibrationRecord);
+        return false;
+    }
+
+    stepperLR.setLimits(_calibrationRecord.limits[0][0], _calibrationRecord.limits[0][1]);
+    stepperPAN.setLimits(_calibrationRecord.limits[1][0], _calibrationRecord.limits[1][1]);
+    _warmBoot = _calibrationRecord.warmBoot;
+    return true;
+}
+
+void fillCalibration(MovementCalibration &cal)
+{
+    cal.limits[0][0] = stepperLR.getLimitUpper();
+    cal.limits[0][1] = stepperLR.getLimitLower();
+    cal.limits[1][0] = stepperPAN.getLimitUpper();
+    cal.limits[1][1] = stepperPAN.getLimitLower();
+    cal.warmBoot = _warmBoot;
+}
+
+//limits change from the sl command and from runToEnd(), store them once nothing is moving
+void checkCalibration()
+{
+    if (stepperLR.isRunning() || stepperPAN.isRunning())
+        return;
+
+    MovementCalibration cal;
+    fillCalibration(cal);
+    if (memcmp(&cal, &_calibrationRecord, sizeof(cal)) == 0)
+        return;
+
+    _calibrationRecord = cal;
+    _calibration.save(&_calibrationRecord);
 }
 
 void runSteppers()
 {
     stepperLR.step();
     stepperPAN.step();
+    motionQueue.run();
 }
 
 void eventMoveComplete(int stepperId)
@@ -116,6 +264,15 @@ void eventMoveComplete(int stepperId)
     sendFormattedResponse(EVENT_MOVE_COMPLETE, "0", outputData);
 }
 
+void eventQueueComplete()
+{
+    static char outputData[30];
+    stepperLR.disableController(1);
+    stepperPAN.disableController(1);
+    sprintf(outputData, "%ld %ld", stepperLR.getPosition(), stepperPAN.getPosition());
+    sendFormattedResponse(EVENT_QUEUE_COMPLETE, "0", outputData);
+}
+
 void eventHitEndLimit(int stepperId)
 {
     sendEvent(stepperId, EVENT_LIMIT_END);
@@ -160,111 +317,27 @@ Serial/USB Comms
 ##################################
 */
 
-// Do request to send data
-void notifyTerminalControllerMessage()
-{
-    _waitForTerminalAckTimestamp = millis();
-    clawController.print(RTS);
-    clawController.flush();
-}
-
-//Send a message to the serial port, queues message and waits for CTS response
+//Send a message to the serial port, every message is prefixed with our sequence
 void sendTerminalControllerMessage(char message[])
 {
-    notifyTerminalControllerMessage();
-    strncpy(_lastTerminalMessage, message, strlen(message)+1);
-    
-}
-
-//Write data to serial port, terminate with close
-void sendTerminalControllerData(char message[])
-{
-    clawController.print(_sequence);
-    clawController.print(" ");
-    clawController.print(message);
-    clawController.print(CS);
+    char data[SERIAL_LINK_MAX_PAYLOAD + 1];
+    snprintf(data, sizeof(data), "%u %s", _sequence, message);
+    _terminalLink.send(data);
     _sequence++;
 }
 
-
 void handleTerminalSerialCommands()
 {
-    //if we sent a message but didn't receive an ACK then send again
-    if (_waitForTerminalAckTimestamp && millis() - _waitForTerminalAckTimestamp > 300)
-    {
-        _waitForTerminalAckCount++;
-        notifyTerminalControllerMessage();
-    }
-
-    if (_waitForTerminalAckCount > 5) //give up after 5 attempts
-    {
-        _waitForTerminalAckTimestamp = 0;
-        _waitForTerminalAckCount = 0;
-    }
-
-    static byte sidx = 0; //serial cursor
-    static unsigned long startTime = 0; //memory placeholder
-
-    startTime = millis();
-
-    //if we have data, read it
-    while (clawController.available()) //burn through data waiting for start byte
-    {
-        char thisChar = clawController.read();
-        if (thisChar == RTS) //if the other end wants to send data, tell them it's OK
-        {
-            clawController.print(CTS);
-            clawController.flush();
-
-            //reset the index
-            sidx = 0;
-            while (millis() - startTime < 500) //wait up to 300ms for next byte
-            {
-                if (!clawController.available())
-                    continue;
-
-                startTime = millis(); //update received timestamp, allows slow data to come in (manually typing)
-                thisChar = clawController.read();
-                
-                if (thisChar == RTS) //extra rts, burn it off
-                        continue;
-
-                if (thisChar == CS)
-                {
-                    while (clawController.available() > 0) //burns the buffer
-                        clawController.read();
-
-                    _sTerminalIncomingCommand[sidx] = '\0'; //terminate string
-
-                    int eventid = 0;
-                    char data[10];
-                    debugString("Term: ");
-                    debugLine(_sTerminalIncomingCommand);
-
-                    // example: 108 1
-                    handleTerminalCommand(_sTerminalIncomingCommand);
+    _terminalLink.poll();
+}
 
-                    break;
-                } else {
-                    //save our byte
-                    _sTerminalIncomingCommand[sidx] = thisChar;
-                    sidx++;
-                    //prevent overlfow and reset to our last byte
-                    if (sidx >= _numChars) {
-                        sidx = _numChars - 1;
-                    }
-                }
-            }
-            //we either processed data from a successful command or the command timed out
-        }
-        else if (thisChar == CTS)
-        {
-            _waitForTerminalAckTimestamp = 0;
-            _waitForTerminalAckCount = 0;
+void handleTerminalMessage(char message[])
+{
+    debugString("Term: ");
+    debugLine(message);
 
-            sendTerminalControllerData(_lastTerminalMessage);
-        }
-    }
+    // example: 108 1
+    handleTerminalCommand(message);
 }
 
 /*
@@ -300,8 +373,8 @@ void handleTerminalCommand(char incomingData[])
     memset(outputData, 0, sizeof(outputData));
 
 
-    //simplistic approach
-    sscanf(incomingData, "%s %s %s %s %s %s %s %s", sequence, command, argument, argument2, argument3, argument4, argument5, argument6);
+    //simplistic approach, arguments keep old values when not sent so check the count
+    int fieldCount = sscanf(incomingData, "%s %s %s %s %s %s %s %s", sequence, command, argument, argument2, argument3, argument4, argument5, argument6);
 
    /*
 
@@ -313,6 +386,19 @@ void handleTerminalCommand(char incomingData[])
         _isDebugMode = strcmp(argument,"1") == 0;
         sendFormattedResponse(EVENT_INFO, sequence, argument);
 
+    } else if (strcmp(command,"cal") == 0) { //stored limits: "cal warm 0|1" home at boot or not, "cal clear" forget them, reply valid,seq,warm
+
+        if (strcmp(argument,"warm") == 0)
+            _warmBoot = strcmp(argument2,"1") == 0; //saved by checkCalibration()
+        else if (strcmp(argument,"clear") == 0)
+        {
+            _calibration.erase();
+            fillCalibration(_calibrationRecord); //don't write the same limits straight back
+        }
+
+        sprintf(outputData, "%i %u %i", _calibration.isValid(), _calibration.getSequence(), _warmBoot);
+        sendFormattedResponse(EVENT_INFO, sequence, outputData);
+
     } else if (strcmp(command,"ping") == 0) { //pinging
 
         sendFormattedResponse(EVENT_PONG, sequence, argument);
@@ -331,8 +417,20 @@ void handleTerminalCommand(char incomingData[])
         
         sendFormattedResponse(EVENT_INFO, sequence, argument2);
 
+    } else if (strcmp(command,"sj") == 0) // s-curve (jerk limited) ramps on/off
+    {
+
+        bool enabled = strcmp(argument2,"1") == 0;
+        if (strcmp(argument,"1") == 0)
+            stepperLR.setSCurve(enabled);
+        else if (strcmp(argument,"2") == 0)
+            stepperPAN.setSCurve(enabled);
+        
+        sendFormattedResponse(EVENT_INFO, sequence, argument2);
+
     } else if (strcmp(command,"ah") == 0) // auto home
     {
+        motionQueue.clear();
 
         if (strcmp(argument,"1") == 0)
             stepperLR.autoHome();
@@ -341,6 +439,14 @@ void handleTerminalCommand(char incomingData[])
         
         sendFormattedResponse(EVENT_HOMING_STARTED, sequence, argument);
 
+    } else if (strcmp(command,"homeall") == 0) // auto home every stepper at once, optional timeout in ms
+    {
+        if (fieldCount > 2)
+            _homeAllTimeout = atol(argument);
+
+        sendFormattedResponse(EVENT_HOMING_STARTED, sequence, "0");
+        startHomeAll();
+
     } else if (strcmp(command,"sh") == 0) // set home at current location
     {
 
@@ -364,6 +470,7 @@ void handleTerminalCommand(char incomingData[])
 
     } else if (strcmp(command,"mt") == 0) // move to
     {
+        motionQueue.clear();
 
         int location = atoi(argument2);
         if (strcmp(argument,"1") == 0)
@@ -373,6 +480,65 @@ void handleTerminalCommand(char incomingData[])
 
         sendFormattedResponse(EVENT_MOVE_STARTED, sequence, argument);
 
+    } else if (strcmp(command,"rt") == 0) // retarget, like move to but a running move keeps its speed
+    {
+        motionQueue.clear();
+
+        long location = atol(argument2);
+        if (strcmp(argument,"1") == 0)
+            stepperLR.retarget(location);
+        else if (strcmp(argument,"2") == 0)
+            stepperPAN.retarget(location);
+
+        sendFormattedResponse(EVENT_MOVE_STARTED, sequence, argument);
+
+    } else if (strcmp(command,"jog") == 0) // jog at a speed, sign is the direction, 0 slows to a stop
+    {
+        motionQueue.clear();
+
+        int speed = atoi(argument2);
+        if (strcmp(argument,"1") == 0)
+            stepperLR.jog(speed);
+        else if (strcmp(argument,"2") == 0)
+            stepperPAN.jog(speed);
+
+        sendFormattedResponse(EVENT_MOVE_STARTED, sequence, argument);
+
+    } else if (strcmp(command,"mq") == 0) // queue coordinated moves: mq lr pan ms [lr pan ms ...]
+    {
+        //too many arguments for the sscanf above, walk the raw command instead
+        byte queued = 0;
+        byte result = 0;
+        if (strlen(incomingData) >= _numChars - 1)
+        {
+            //the comms buffers upstream stop at _numChars, a command this long may have lost its tail, queue none of it
+            result = 1;
+        } else {
+            strtok(incomingData, " "); //sequence
+            strtok(NULL, " "); //command
+            char *lr = strtok(NULL, " ");
+            while (lr)
+            {
+                char *pan = strtok(NULL, " ");
+                char *ms = strtok(NULL, " ");
+                if (!pan || !ms || !motionQueue.add(atol(lr), atol(pan), atoi(ms)))
+                {
+                    result = 1; //queue full, a target outside the limits or a short segment, the rest is dropped
+                    break;
+                }
+                queued++;
+                lr = strtok(NULL, " ");
+            }
+        }
+
+        sprintf(outputData, "%i %i %i", result, queued, motionQueue.count());
+        sendFormattedResponse(EVENT_MOVE_STARTED, sequence, outputData);
+
+    } else if (strcmp(command,"mqx") == 0) // abort queued moves
+    {
+        sendFormattedResponse(EVENT_INFO, sequence, "");
+        motionQueue.clear();
+
     } else if (strcmp(command,"gl") == 0) // get location
     {
         long pos = 0;
@@ -402,6 +568,7 @@ void handleTerminalCommand(char incomingData[])
     
     else if (strcmp(command,"l") == 0) // move left
     {
+        motionQueue.clear();
         int steps = atoi(argument);
         if (steps == 0)
         {
@@ -418,6 +585,7 @@ void handleTerminalCommand(char incomingData[])
 
     }  else if (strcmp(command,"r") == 0) // move right
     {
+        motionQueue.clear();
         int steps = atoi(argument);
         if (steps == 0)
         {
@@ -438,6 +606,7 @@ void handleTerminalCommand(char incomingData[])
     
     else if (strcmp(command,"tl") == 0) // pan left
     {
+        motionQueue.clear();
         int steps = atoi(argument);
         if (steps == 0)
         {
@@ -454,6 +623,7 @@ void handleTerminalCommand(char incomingData[])
 
     } else if (strcmp(command,"tr") == 0) // pan right
     {
+        motionQueue.clear();
         int steps = atoi(argument) ;
         if (steps == 0)
         {
@@ -540,18 +710,19 @@ void sendFormattedResponse(int event, char sequence[], char response[])
 }
 
 
+//debug text goes to USB, clawController carries the framed link and raw text would corrupt it
 void debugLine(char* message)
 {
     if (_isDebugMode)
     {
-        clawController.println(message);
+        Serial.println(message);
     }
 }
 void debugString(char* message)
 {
     if (_isDebugMode)
     {
-        clawController.print(message);
+        Serial.print(message);
     }
 }
 
@@ -559,7 +730,7 @@ void debugInt(int message)
 {
     if (_isDebugMode)
     {
-        clawController.print(message);
+        Serial.print(message);
     }
 }
 
@@ -567,7 +738,7 @@ void debugByte(byte message)
 {
     if (_isDebugMode)
     {
-        clawController.print(message, HEX);
-        clawController.print(", ");
+        Serial.print(message, HEX);
+        Serial.print(", ");
     }
 }
\ No newline at end of file
@@ -1,8 +1,35 @@
 #include "Arduino.h"
 #include "Defines.h"
 #include "StepperController.h"
-#include "DigitalWriteFast.h"
+#if defined(__AVR__)
+#include <util/atomic.h>
+#else
+//off target (host builds) there is no ISR to race with
+#define ATOMIC_BLOCK(type)
+#define ATOMIC_RESTORESTATE
+#endif
 
+StepperController *StepperController::_timerSteppers[3] = { 0, 0, 0 };
+bool StepperController::_timerStarted = false;
+
+#if defined(__AVR__)
+ISR(TIMER1_COMPA_vect)
+{
+    StepperController::handleTimerInterrupt(0);
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+    StepperController::handleTimerInterrupt(1);
+}
+
+#if defined(OCR1C)
+ISR(TIMER1_COMPC_vect)
+{
+    StepperController::handleTimerInterrupt(2);
+}
+#endif
+#endif
 
 
 
@@ -16,10 +43,58 @@ StepperController::StepperController(int stepPin, int dirPin, int enablePin, int
 
     _direction = DIRECTION_FORWARD; //just to show we have these available
 
+    //globals start zeroed on the board, anything else (host tests) doesn't
+    _stepPosition = 0l;
+    _stepRelativePosition = 0l;
+    _stepsTaken = 0l;
+    stepsWanted = 0l;
+    _stepDelayTime = 0l;
+    _decelerating = false;
+    _autoHomingRunOut = false;
+    _homeSwitchThrown = false;
+    _endSwitchThrown = false;
+    _limitSwitchTriggerValue = LOW;
+    _previousMicros = 0;
+    _lastMicroDiff = 0;
+    _cumulativeMicroDiffs = 0;
+    _timerStepsSeen = 0;
+    _timerCompareRegister = 0;
+    _timerChannelMask = 0;
+    _followerSteps = 0;
+    _followerMasterSteps = 0;
+    _followerError = 0;
+    _followerAdder = 0;
+    _retargetPosition = 0;
+    _homeInputRegister = 0;
+    _endInputRegister = 0;
 
     _acceleration = 20; //default acceleration
+    _maxSpeed = 3000;
     _homed = false;
     _stepPin = stepPin;
+    _stepPort = portOutputRegister(digitalPinToPort(stepPin));
+    _stepPinMask = digitalPinToBitMask(stepPin);
+    if (homePin > -1)
+    {
+        _homeInputRegister = portInputRegister(digitalPinToPort(homePin));
+        _homePinMask = digitalPinToBitMask(homePin);
+    }
+    if (endPin > -1)
+    {
+        _endInputRegister = portInputRegister(digitalPinToPort(endPin));
+        _endPinMask = digitalPinToBitMask(endPin);
+    }
+    _timerDriven = false;
+    _timerHalted = false;
+    _timerLimitHit = false;
+    _timerPulseHigh = false;
+    _timerFollowerPulsed = false;
+    _timerNextStep = 0;
+    _sCurve = false;
+    _rampStep = 0;
+    _speedLimit = 0;
+    _retargetPending = false;
+    _firstStepDelay = 0;
     _dirPin = dirPin;
     _homePin = homePin; //default these so we know when they're actually set
     _endPin = endPin; //default these so we know when they're actually set
@@ -29,6 +104,17 @@ StepperController::StepperController(int stepPin, int dirPin, int enablePin, int
     _lastHomeCompleteFlag = false; //flag tells us when we checked to see if the last home completed
 
     _stepperId = 1;
+    _events = true;
+    _limitSwitchEventHomeFunction = 0;
+    _limitSwitchEventEndFunction = 0;
+    _moveCompleteEventFunction = 0;
+    _autoHomingCompleteFunction = 0;
+    _follower = 0;
+    _holdSpeedAtEnd = false;
+    _nextMovePending = false;
+    _nextSteps = 0;
+    _nextFollower = 0;
+    _nextFollowerSteps = 0;
 
     _limitSwitchBackoffSteps = 40; //how many steps to backoff when auto homing
 
@@ -59,6 +145,234 @@ int StepperController::getId()
     return _stepperId;
 }
 
+void StepperController::setEventsEnabled(bool enabled)
+{
+    _events = enabled;
+}
+
+/**
+ * Coordinated moves: the next move of this stepper also steps the follower, spreading followerSteps evenly
+ * over our steps. Follower direction and enable must already be set. Cleared when the move stops.
+ */
+void StepperController::setFollower(StepperController *follower, long followerSteps)
+{
+    _follower = follower;
+    _followerAdder = (follower && follower->_direction == DIRECTION_FORWARD) ? 1l : -1l;
+    _followerSteps = followerSteps < 0 ? -followerSteps : followerSteps;
+}
+
+/**
+ * Blended moves: when the running move reaches its target carry straight on for steps more without stopping,
+ * stepping follower alongside. The running move stops decelerating into its target and the ramp runs on
+ * from the current speed. steps must head the same way as the running move. The follower's direction and
+ * enable must already be set, so only turn it round if it isn't being stepped by the running move.
+ */
+void StepperController::setNextMove(long steps, StepperController *follower, long followerSteps)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _nextSteps = steps;
+        _nextFollower = followerSteps != 0 ? follower : 0;
+        _nextFollowerSteps = followerSteps;
+        _nextMovePending = true;
+        _holdSpeedAtEnd = true;
+    }
+}
+
+bool StepperController::hasNextMove()
+{
+    bool pending;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pending = _nextMovePending;
+    }
+    return pending;
+}
+
+bool StepperController::isWithinLimits(long position)
+{
+    return _disableLimitChecks || (position <= _upperLimit && position >= _lowerLimit);
+}
+
+/**
+ * At the target, swap in the move from setNextMove(). Runs inside the timer ISR when timer driven.
+ */
+bool StepperController::takeNextMove()
+{
+    if (!_nextMovePending)
+        return false;
+    _nextMovePending = false;
+
+    if (_nextSteps == 0 || (_nextSteps > 0) != (_direction == DIRECTION_FORWARD))
+        return false; //would have to turn round, stop here instead
+
+    stepsWanted = _nextSteps;
+    _stepRelativePosition = 0l;
+    _followerMasterSteps = _nextSteps < 0 ? -_nextSteps : _nextSteps;
+    _followerError = _followerMasterSteps / 2;
+    this->setFollower(_nextFollower, _nextFollowerSteps);
+    _holdSpeedAtEnd = false; //slow into this target unless another move is handed over
+    return true;
+}
+
+bool StepperController::raiseFollower()
+{
+    if (!_follower || _followerMasterSteps <= 0)
+        return false;
+
+    _followerError += _followerSteps;
+    if (_followerError < _followerMasterSteps)
+        return false;
+    _followerError -= _followerMasterSteps;
+
+    _follower->stepPinHigh();
+    _follower->_stepPosition += _followerAdder;
+    return true;
+}
+
+void StepperController::lowerFollower()
+{
+    _follower->stepPinLow();
+}
+
+bool StepperController::followerLimited()
+{
+    if (!_follower)
+        return false;
+
+    int limited = _follower->checkLimitSwitches();
+    return (limited == STEPPER_HOME_LIMIT && _followerAdder < 0) || (limited == STEPPER_END_LIMIT && _followerAdder > 0);
+}
+
+/**
+ * The follower is due a pulse with our next step and it would take it outside its soft limits.
+ * Same test as our own soft limits, the follower never runs its own step() during a coordinated move.
+ */
+bool StepperController::followerBlocked()
+{
+    if (!_follower || _followerMasterSteps <= 0 || _follower->_disableLimitChecks)
+        return false;
+    if (_followerError + _followerSteps < _followerMasterSteps)
+        return false; //no follower pulse this step
+
+    long next = _follower->_stepPosition + _followerAdder;
+    return next > _follower->_upperLimit || next < _follower->_lowerLimit;
+}
+
+/**
+ * Hand step generation to a Timer1 compare channel. Timer1 is switched to normal mode with a /64 prescaler
+ * so PWM on its pins is lost. Must be called from setup(), init() reconfigures Timer1 before that.
+ */
+void StepperController::attachTimer(byte channel)
+{
+#if defined(__AVR__)
+    switch (channel)
+    {
+        case 0:
+            _timerCompareRegister = &OCR1A;
+            _timerChannelMask = _BV(OCIE1A);
+            break;
+        case 1:
+            _timerCompareRegister = &OCR1B;
+            _timerChannelMask = _BV(OCIE1B);
+            break;
+#if defined(OCR1C)
+        case 2:
+            _timerCompareRegister = &OCR1C;
+            _timerChannelMask = _BV(OCIE1C);
+            break;
+#endif
+        default:
+            return;
+    }
+
+    if (!_timerStarted)
+    {
+        TCCR1A = 0; //normal mode, free running 0-0xFFFF
+        TCCR1B = _BV(CS11) | _BV(CS10); // /64 prescaler, 4uS per tick
+        _timerStarted = true;
+    }
+    _timerSteppers[channel] = this;
+    _timerDriven = true;
+#else
+    (void)channel; //no Timer1, stay polled
+#endif
+}
+
+bool StepperController::isTimerDriven()
+{
+    return _timerDriven;
+}
+
+void StepperController::handleTimerInterrupt(byte channel)
+{
+    if (_timerSteppers[channel])
+        _timerSteppers[channel]->onTimerStep();
+}
+
+void StepperController::armTimer()
+{
+#if defined(__AVR__)
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        unsigned long ticks = (unsigned long)_stepDelayTime / TIMER_TICK_MICROS; //0 unless start() was told to wait
+        if (ticks < TIMER_MIN_TICKS)
+            ticks = TIMER_MIN_TICKS;
+        else if (ticks > 0xFFFFul)
+            ticks = 0xFFFFul;
+        _timerHalted = false;
+        _timerLimitHit = false;
+        _timerPulseHigh = false;
+        *_timerCompareRegister = TCNT1 + (uint16_t)ticks;
+        TIFR1 = _timerChannelMask; //clear any stale match
+        TIMSK1 |= _timerChannelMask;
+    }
+#endif
+}
+
+void StepperController::disarmTimer()
+{
+#if defined(__AVR__)
+    bool pulseHigh;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        TIMSK1 &= ~_timerChannelMask;
+        pulseHigh = _timerPulseHigh;
+        _timerPulseHigh = false;
+    }
+
+    //stopped between the two halves of a step, finish the pulse here
+    if (pulseHigh)
+    {
+        delayMicroseconds(STEP_PULSE_MICROS);
+        this->stepPinLow();
+        if (_timerFollowerPulsed)
+            this->lowerFollower();
+    }
+#endif
+}
+
+/**
+ * Point the compare channel at tick, or a pulse length from now if tick has already gone by.
+ * A compare value behind TCNT1 would only match after the counter wraps, 262mS later.
+ */
+void StepperController::scheduleCompare(uint16_t tick)
+{
+#if defined(__AVR__)
+    uint16_t earliest = TCNT1 + TIMER_PULSE_TICKS;
+    if ((int16_t)(tick - earliest) < 0)
+        tick = earliest;
+    *_timerCompareRegister = tick;
+#else
+    (void)tick;
+#endif
+}
+
+void StepperController::onTimerStep()
+{
+    this->timerStep(this);
+}
+
 
 bool StepperController::getLastMoveCompleted()
 {
@@ -81,50 +395,142 @@ bool StepperController::getLastHomeCompleted()
 void StepperController::setMaxSpeed(int speed)
 {
     _maxSpeed = speed;
+    this->planRamp();
 }
-void StepperController::calcSpeed()
+
+/**
+ * Precompute the step intervals of the acceleration ramp so stepping needs no float math.
+ * Acceleration is the speed gained per step; with S-curve enabled the ramp follows a smoothstep
+ * and is 1.5x longer so the steepest part matches the linear ramp.
+ */
+void StepperController::planRamp()
 {
-    if (!_running)
-        return;
-    //ignore deceleration for now
-    /*
-    if (_stepPosition == _decelStep || _decelerating)
+    long maxSpeed = _maxSpeed > 0 ? _maxSpeed : 1;
+    long accel = _acceleration > 0 ? _acceleration : maxSpeed;
+
+    long rampSteps = (maxSpeed + accel - 1) / accel; //steps from standstill to cruising
+    if (_sCurve)
+        rampSteps = (rampSteps * 3) / 2;
+    if (rampSteps < 1)
+        rampSteps = 1;
+
+    byte entries = rampSteps < RAMP_TABLE_SIZE ? (byte)rampSteps : RAMP_TABLE_SIZE;
+    unsigned long table[RAMP_TABLE_SIZE];
+    for (byte i = 0; i < entries; i++)
     {
-        _decelerating = true;
-        _currentSpeed = _currentSpeed - _acceleration; //linear deceleration
-        if (_currentSpeed <= 0)
-            _currentSpeed = _acceleration;
+        float fraction = (float)(i + 1) / (float)entries; //how far along the ramp this entry is
+        float speed;
+        if (_sCurve)
+            speed = (float)maxSpeed * fraction * fraction * (3.0 - 2.0 * fraction);
+        else
+            speed = (float)maxSpeed * fraction;
+        if (speed < (float)accel)
+            speed = (float)accel; //never slower than the first step
+        table[i] = (unsigned long)(1000000.0 / speed);
+    }
 
-        _stepDelayTime = (long)((1.0/(float)_currentSpeed) * 1000.0 * 1000.0);
-    }*/
-    if (_currentSpeed == _maxSpeed)
+    //the ISR reads these, swap them in together
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
     {
-        //do nothing, speed is set, cruising
-    } else { //accelerating
-        _currentSpeed = _currentSpeed + _acceleration; //linear acceleration
-        if (_currentSpeed > _maxSpeed)
-            _currentSpeed = _maxSpeed;
-        _testSpeed = (float)_currentSpeed;
-        _testDivisor = 1.0/_testSpeed;
-        _floatResult = _testDivisor * 1000.0 * 1000.0;
-        _stepDelayTime = (long)_floatResult;
+        memcpy(_rampTable, table, sizeof(table));
+        _rampSteps = rampSteps;
+        _rampScale = ((unsigned long)entries << 16) / (unsigned long)rampSteps;
+        _cruiseInterval = 1000000ul / (unsigned long)maxSpeed;
     }
+    this->applySpeedLimit();
 }
-void StepperController::setEventLimitHome(void (*eventFunction))
+
+/**
+ * Cap the ramp at the table entry closest to the jog speed, calcSpeed() then accelerates or slows to it.
+ * Jog speeds below max speed land on one of the table's RAMP_TABLE_SIZE steps.
+ */
+void StepperController::applySpeedLimit()
+{
+    long rampLimit = _rampSteps;
+    if (_speedLimit > 0 && _speedLimit < _maxSpeed)
+    {
+        long entries = _rampSteps < RAMP_TABLE_SIZE ? _rampSteps : RAMP_TABLE_SIZE;
+        unsigned long interval = 1000000ul / (unsigned long)_speedLimit;
+        long i = 0;
+        while (i < entries - 1 && _rampTable[i] > interval)
+            i++;
+        rampLimit = (i * _rampSteps + entries - 1) / entries + 1; //first ramp step that reads entry i
+        if (rampLimit > _rampSteps)
+            rampLimit = _rampSteps;
+    }
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _rampLimit = rampLimit;
+    }
+}
+
+/**
+ * Interval in uS until the next step, looked up from the ramp table.
+ * Accelerates from the start of the move and decelerates symmetrically into the target.
+ * Runs inside the timer ISR when timer driven so it must stay integer only.
+ */
+unsigned long StepperController::calcSpeed()
+{
+    if (_rampStep < _rampLimit)
+        _rampStep++;
+    else if (_rampStep > _rampLimit)
+        _rampStep--; //jog speed dropped, slow to it a step at a time
+
+    long rampPosition = _rampStep;
+    _decelerating = false;
+    if (_stepIndexMode && !_holdSpeedAtEnd) //we know where we stop, start slowing down once we're a ramp away
+    {
+        long remaining = stepsWanted - _stepRelativePosition;
+        if (remaining < 0)
+            remaining = -remaining;
+        if (remaining < rampPosition)
+        {
+            rampPosition = remaining > 0 ? remaining : 1;
+            _rampStep = rampPosition; //a retarget further out picks up from the speed we slowed to
+            _decelerating = true;
+        }
+    }
+
+    if (rampPosition >= _rampSteps)
+        _stepDelayTime = _cruiseInterval;
+    else
+        _stepDelayTime = _rampTable[((unsigned long)(rampPosition - 1) * _rampScale) >> 16];
+
+    return _stepDelayTime;
+}
+
+void StepperController::setSCurve(bool enabled)
+{
+    _sCurve = enabled;
+    this->planRamp();
+}
+
+bool StepperController::isSCurve()
+{
+    return _sCurve;
+}
+
+void StepperController::setEventLimitHome(void (*eventFunction)(int stepperId))
 {
     _limitSwitchEventHomeFunction = eventFunction;
 }
 
-void StepperController::setEventLimitEnd(void (*eventFunction))
+void StepperController::setEventLimitEnd(void (*eventFunction)(int stepperId))
 {
     _limitSwitchEventEndFunction = eventFunction;
 }
 
-void StepperController::setEventMoveComplete(void (*eventFunction))
+void StepperController::setEventMoveComplete(void (*eventFunction)(int stepperId))
 {
     _moveCompleteEventFunction = eventFunction;
 }
 
+void StepperController::setEventAutoHomeComplete(void (*eventFunction)(int stepperId))
+{
+    _autoHomingCompleteFunction = eventFunction;
+}
+
 bool StepperController::isRunning()
 {
     return _running;
@@ -146,7 +552,6 @@ void StepperController::autoHome()
 
         //make sure _direction = false, default _direction is the home pin
         this->setDirection(DIRECTION_REVERSE);
-        _decelStep = -1;
         //begin stepping
         this->start();
     }
@@ -161,7 +566,6 @@ void StepperController::runToEnd()
         _runningToEnd = true;
         //make sure _direction = true, default _direction for ending
         this->setDirection(DIRECTION_FORWARD);
-        _decelStep = -1;
         //begin stepping
         this->start();
     }
@@ -170,31 +574,44 @@ void StepperController::runToEnd()
 void StepperController::setHome()
 {
     _homed = true;
-    _stepPosition = 0l;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _stepPosition = 0l;
+    }
 }
 void StepperController::unsetHome()
 {
     _homed = false;
-    _stepPosition = 0l;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _stepPosition = 0l;
+    }
 }
 void StepperController::changeDirection()
 {
     //if this is running already, we need to reset acceleration stuff
     if (_running)
     {
-        _currentSpeed = 0;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            _rampStep = 0;
+        }
     }
     this->setDirection(!_direction);
 }
 
 void StepperController::setDirection(bool dir)
 {
-    _direction = dir;
+    //pin and flag change together so the ISR never counts a step the wrong way
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _direction = dir;
 
-    if (_direction)
-        digitalWrite(_dirPin, DIRECTION_FORWARD?HIGH:LOW); // Move one _direction
-    else
-        digitalWrite(_dirPin, DIRECTION_FORWARD?LOW:HIGH); // Or another
+        if (_direction)
+            digitalWrite(_dirPin, DIRECTION_FORWARD?HIGH:LOW); // Move one _direction
+        else
+            digitalWrite(_dirPin, DIRECTION_FORWARD?LOW:HIGH); // Or another
+    }
 }
 
 void StepperController::setLimits(long high, long low)
@@ -213,37 +630,63 @@ void StepperController::setLimits(long high, long low)
 
 bool StepperController::start()
 {
+    if (_timerDriven)
+        this->disarmTimer(); //restart cleanly if we were already moving
+
     _running = true; //tell the stepping code we're running
     _previousMicros = micros(); //start the time to the first step (hopefully tiny)
     _stepRelativePosition = 0l; //we started stepping
     _cumulativeMicroDiffs = 0l;
     _stepsTaken = 0;
+    _timerStepsSeen = 0;
     _autoHomingRunOut = false;
-    _currentSpeed = 0;
-    _stepDelayTime = 0l;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        _rampStep = 0;
+        _nextMovePending = false;
+    }
+    _retargetPending = false;
+    _followerError = _followerMasterSteps / 2;
+    _stepDelayTime = _firstStepDelay; //first step right away unless we're carrying on from a step just taken
+    _firstStepDelay = 0;
     _decelerating = false;
     _lastMoveCompleteFlag = false;
     //first thing to do is check if we've hit a relay
     int limited = this->checkLimitSwitches();
     if (limited > 0)
     {
-        return this->runLimitedValidations(limited);
+        if (!this->runLimitedValidations(limited))
+            return false;
     } else {
         digitalWrite(_enablePin, LOW);
         _enabled = true;
     }
+
+    if (_timerDriven)
+        this->armTimer();
     return true;
 }
 
 void StepperController::stop()
 {
+    if (_timerDriven)
+        this->disarmTimer();
     _stepIndexMode = false;
     _autoHoming = false;
     _runningToEnd = false;
     _running = false;
     _decelerating = false;
+    _follower = 0;
+    _holdSpeedAtEnd = false;
+    _nextMovePending = false;
+    _retargetPending = false;
+    if (_speedLimit)
+    {
+        _speedLimit = 0;
+        this->applySpeedLimit();
+    }
     _lastMoveCompleteFlag = true;
-    if (_moveCompleteEventFunction)
+    if (_events && _moveCompleteEventFunction)
         (*_moveCompleteEventFunction)(_stepperId);
 }
 
@@ -264,6 +707,7 @@ bool StepperController::isDisableOnLimit()
 void StepperController::setAccel(int accel)
 {
     _acceleration = accel;
+    this->planRamp();
 }
 long StepperController::getLimitUpper()
 {
@@ -275,23 +719,39 @@ long StepperController::getLimitLower()
 }
 long StepperController::getPosition()
 {
-    return _stepPosition;
+    long pos;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pos = _stepPosition;
+    }
+    return pos;
 }
 long StepperController::stepsRelativePosition()
 {
-    return _stepRelativePosition;
+    long pos;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        pos = _stepRelativePosition;
+    }
+    return pos;
 }
 long StepperController::getStepsTaken()
 {
-    return _stepsTaken;
+    long steps;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        steps = _stepsTaken;
+    }
+    return steps;
 }
 long StepperController::getStepDelayTime()
 {
-    return _stepDelayTime;
-}
-long StepperController::getDecelStep()
-{
-    return _decelStep;
+    long delayTime;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        delayTime = _stepDelayTime;
+    }
+    return delayTime;
 }
 int StepperController::getMaxSpeed()
 {
@@ -299,28 +759,20 @@ int StepperController::getMaxSpeed()
 }
 int StepperController::getCurrentSpeed()
 {
-    return _currentSpeed;
+    long delayTime = this->getStepDelayTime();
+    if (!_running || delayTime <= 0)
+        return 0;
+    return (int)(1000000l / delayTime);
 }
 bool StepperController::getIsDecel()
 {
     return _decelerating;
 }
-float StepperController::getTestSpeed()
-{
-    return _testSpeed;
-}
-float StepperController::getDivisor()
-{
-    return _testDivisor;
-}
-float StepperController::getFloatResult()
-{
-    return _floatResult;
-}
 void StepperController::returnHome()
 {
-    if (_stepPosition != 0l)
-        this->moveSteps(_stepPosition * -1l);
+    long pos = this->getPosition();
+    if (pos != 0l)
+        this->moveSteps(pos * -1l);
 }
 bool StepperController::isHomeSwitchActive()
 {
@@ -335,29 +787,105 @@ void StepperController::moveSteps(long steps)
 
     stepsWanted = steps;
     _stepIndexMode = true;
-
-    long stepsToDecel = _maxSpeed / _acceleration;
+    _followerMasterSteps = steps < 0 ? -steps : steps;
 
     if (steps > 0) //positive steps mean moving away from home
-    {
         this->setDirection(DIRECTION_FORWARD);
-        //calculate step to begin deceleration
-        _decelStep = (_stepPosition + stepsWanted) - stepsToDecel;
-    } else {
+    else
         this->setDirection(DIRECTION_REVERSE);
-        _decelStep = (_stepPosition + stepsWanted) + stepsToDecel;
-    }
 
     this->start();
 }
 
 void StepperController::moveTo(long pos)
 {
-    _decelStep = -1;
-    stepsWanted = pos - _stepPosition;
+    stepsWanted = pos - this->getPosition();
     this->moveSteps(stepsWanted);
 }
 
+/**
+ * Change the target of a running move on the fly. A target still ahead of us beyond our stopping distance
+ * just moves the end of the move and the ramp carries on from the current speed. A target behind us, or one
+ * too close to stop for, slows to a stop as soon as it can and the move back starts from there.
+ * Anything other than a plain move, or no move at all, starts a fresh moveTo().
+ */
+void StepperController::retarget(long pos)
+{
+    if (!_running || !_stepIndexMode || _follower || _holdSpeedAtEnd)
+    {
+        this->moveTo(pos);
+        return;
+    }
+
+    bool restart = false;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        long adder = (_direction == DIRECTION_FORWARD) ? 1l : -1l;
+        long ahead = (pos - _stepPosition) * adder; //steps to the target the way we're heading, negative if it's behind us
+        long stopping = _rampStep; //deceleration takes a step per ramp step
+
+        if (_timerHalted)
+            restart = true; //ISR already finished the old move, step() hasn't caught up
+        else if (ahead >= stopping)
+        {
+            stepsWanted = _stepRelativePosition + ahead * adder;
+            _retargetPending = false;
+        } else {
+            long remaining = (stepsWanted - _stepRelativePosition) * adder;
+            if (remaining > stopping)
+                stepsWanted = _stepRelativePosition + stopping * adder;
+            _retargetPosition = pos;
+            _retargetPending = true;
+        }
+    }
+
+    if (restart)
+        this->moveTo(pos);
+}
+
+/**
+ * Velocity mode for live aiming. Each call re-aims the running move at the soft limit in the direction of speed
+ * and caps the ramp at speed, so changing speed or direction never restarts the acceleration from zero.
+ * The cap holds until the stepper stops.
+ */
+void StepperController::jog(int speed)
+{
+    if (speed == 0)
+    {
+        if (!_running || !_stepIndexMode)
+            return;
+
+        long pos;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            pos = _stepPosition + ((_direction == DIRECTION_FORWARD) ? _rampStep : -_rampStep);
+        }
+        this->retarget(pos); //stop where the ramp runs out
+        return;
+    }
+
+    _speedLimit = speed < 0 ? -speed : speed;
+    this->applySpeedLimit();
+
+    long target;
+    if (_disableLimitChecks)
+        target = this->getPosition() + (speed > 0 ? JOG_RUN_STEPS : -JOG_RUN_STEPS);
+    else
+        target = speed > 0 ? _upperLimit : _lowerLimit;
+    this->retarget(target);
+}
+
+bool StepperController::startPendingMove()
+{
+    if (!_retargetPending || !_stepIndexMode || stepsWanted != this->stepsRelativePosition())
+        return false;
+
+    _retargetPending = false;
+    _firstStepDelay = _rampTable[0]; //we just stepped at the slowest ramp speed, keep to it through the turn
+    this->moveTo(_retargetPosition); //ramp has run down to a stop, start() picks it up from zero
+    return true;
+}
+
 bool StepperController::runLimitedValidations(int limited)
 {
     if (_direction == DIRECTION_REVERSE && limited == STEPPER_END_LIMIT) //if we're moving toward HOME and the end switch is enabled, re-enable the motor
@@ -424,13 +952,54 @@ bool StepperController::step()
             this->stop();
 
             //send event stating we homed
-            if (_autoHomingCompleteFunction)
+            if (_events && _autoHomingCompleteFunction)
                 (*_autoHomingCompleteFunction)(_stepperId);
                 
             return false;
         }
     }
 
+    //coordinated move, the follower's switches stop both axes
+    if (this->followerLimited())
+    {
+        this->stop();
+        return false;
+    }
+
+    if (_timerDriven)
+    {
+        //the ISR does the stepping, we plan the next interval and send events
+        long stepsTaken;
+        bool halted;
+        bool limitHit;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            stepsTaken = _stepsTaken;
+            halted = _timerHalted;
+            limitHit = _timerLimitHit;
+        }
+        if (halted && limitHit)
+        {
+            //the switch checks above either stopped us or, homing, turned us round, carry on
+            this->armTimer();
+            return false;
+        }
+        if (halted)
+        {
+            if (_stepIndexMode && stepsWanted == this->stepsRelativePosition() && this->takeNextMove())
+            {
+                this->armTimer(); //ISR stopped before the next move was handed over, carry on after a step interval
+                return false;
+            }
+            if (!this->startPendingMove())
+                this->stop();
+            return false;
+        }
+        if (stepsTaken == _timerStepsSeen)
+            return false;
+        _timerStepsSeen = stepsTaken;
+        return true;
+    }
 
     if (this->checkAutoStop())
         return false; //stop if we reach our destination
@@ -438,9 +1007,8 @@ bool StepperController::step()
     unsigned long currentMicros = micros();
 
     //is it time to step?
-    if ((currentMicros - _previousMicros) >= _stepDelayTime) {
+    if ((currentMicros - _previousMicros) >= (unsigned long)_stepDelayTime) {
 
-        this->calcSpeed();
         _lastMicroDiff = (currentMicros - _previousMicros);
         _cumulativeMicroDiffs += _lastMicroDiff;
         long adder = 0l;
@@ -449,73 +1017,21 @@ bool StepperController::step()
         else
             adder--;
 
-        //check if we're outside our limits
-        if ((!_disableLimitChecks) && ((_stepPosition + adder > _upperLimit && !_runningToEnd) || (_stepPosition + adder < _lowerLimit && !_autoHoming)))
+        //check if we or the follower would leave our limits
+        if (((!_disableLimitChecks) && ((_stepPosition + adder > _upperLimit && !_runningToEnd) || (_stepPosition + adder < _lowerLimit && !_autoHoming)))
+            || this->followerBlocked())
         {
             this->stop();
             return false;
         }
 
         _previousMicros = currentMicros; //update the time we last stepped
-        switch (_stepPin)
-        {
-            case 3:
-                digitalWriteFast(PIN_03, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_03, LOW);
-                break;
-            case 4:
-                digitalWriteFast(PIN_04, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_04, LOW);
-                break;
-            case 5:
-                digitalWriteFast(PIN_05, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_05, LOW);
-                break;
-            case 6:
-                digitalWriteFast(PIN_06, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_06, LOW);
-                break;
-            case 7:
-                digitalWriteFast(PIN_07, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_07, LOW);
-                break;
-            case 8:
-                digitalWriteFast(PIN_08, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_08, LOW);
-                break;
-            case 9:
-                digitalWriteFast(PIN_09, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_09, LOW);
-                break;
-            case 22:
-                digitalWriteFast(PIN_22, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_22, LOW);
-                break;
-            case 23:
-                digitalWriteFast(PIN_23, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_23, LOW);
-                break;
-
-            case 32:
-                digitalWriteFast(PIN_32, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_32, LOW);
-                break;
-            case 33:
-                digitalWriteFast(PIN_33, HIGH); //perform a step
-                delayMicroseconds(15); //we have to hold it high for at least 5us but we do a little longer just in case
-                digitalWriteFast(PIN_33, LOW);
-                break;
-        }
+        this->stepPinHigh(); //perform a step
+        bool followerPulsed = this->raiseFollower();
+        delayMicroseconds(STEP_PULSE_MICROS);
+        this->stepPinLow();
+        if (followerPulsed)
+            this->lowerFollower();
         _stepsTaken++;
 
         if (_direction == DIRECTION_FORWARD) {
@@ -526,12 +1042,38 @@ bool StepperController::step()
             _stepPosition--; //keep track of absolute position
         }
 
+        this->calcSpeed(); //plan the interval to the next step
+
         return true;
     }
     return false;
 }
 
 
+/**
+ * Pin access for the hot paths. Any pin works here through the cached port registers,
+ * FastStepperController overrides these with compile time pins and inlines them into the ISR.
+ */
+void StepperController::stepPinHigh()
+{
+    *_stepPort |= _stepPinMask;
+}
+
+void StepperController::stepPinLow()
+{
+    *_stepPort &= ~_stepPinMask;
+}
+
+int StepperController::readHomeSwitch()
+{
+    return (*_homeInputRegister & _homePinMask) ? HIGH : LOW;
+}
+
+int StepperController::readEndSwitch()
+{
+    return (*_endInputRegister & _endPinMask) ? HIGH : LOW;
+}
+
 void StepperController::setLimitTriggerState(int state)
 {
     _limitSwitchTriggerValue = state;
@@ -549,67 +1091,11 @@ int StepperController::checkLimitSwitches()
     int returnCode = 0;
     //read home pin
     int homeSwitch = _limitSwitchTriggerValue; //safe to triggered default
-    switch (_homePin)
-    {
-        case 10:
-            homeSwitch = digitalReadFast(PIN_10);
-            break;
-        case 14:
-            homeSwitch = digitalReadFast(PIN_14);
-            break;
-        case 15:
-            homeSwitch = digitalReadFast(PIN_15);
-            break;
-        case 16:
-            homeSwitch = digitalReadFast(PIN_16);
-            break;
-        case 28:
-            homeSwitch = digitalReadFast(PIN_28);
-            break;
-        case 29:
-            homeSwitch = digitalReadFast(PIN_29);
-            break;
-        case 38:
-            homeSwitch = digitalReadFast(PIN_38);
-            break;
-        case 39:
-            homeSwitch = digitalReadFast(PIN_39);
-            break;
-        default:
-            //default to triggered
-            break;
-    }
+    if (_homePin > -1)
+        homeSwitch = this->readHomeSwitch();
     int endSwitch = _limitSwitchTriggerValue; //safe to triggered default
-    switch (_endPin)
-    {
-        case 10:
-            endSwitch = digitalReadFast(PIN_10);
-            break;
-        case 14:
-            endSwitch = digitalReadFast(PIN_14);
-            break;
-        case 15:
-            endSwitch = digitalReadFast(PIN_15);
-            break;
-        case 16:
-            endSwitch = digitalReadFast(PIN_16);
-            break;
-        case 30:
-            endSwitch = digitalReadFast(PIN_30);
-            break;
-        case 31:
-            endSwitch = digitalReadFast(PIN_31);
-            break;
-        case 40:
-            endSwitch = digitalReadFast(PIN_40);
-            break;
-        case 41:
-            endSwitch = digitalReadFast(PIN_41);
-            break;
-        default:
-            //default to triggered
-            break;
-    }
+    if (_endPin > -1)
+        endSwitch = this->readEndSwitch();
 
     if (homeSwitch == _limitSwitchTriggerValue || (homeSwitch > 0 && _limitSwitchTriggerValue > 0)) //home pin is activated
     {
@@ -618,7 +1104,7 @@ int StepperController::checkLimitSwitches()
             _homeSwitchThrown = true;
             
             //Don't throw an end limit event if we're in auto home mode
-            if (!_autoHoming && !autoHomingRunOut && _limitSwitchEventHomeFunction)
+            if (!_autoHoming && !_autoHomingRunOut && _limitSwitchEventHomeFunction)
                 (*_limitSwitchEventHomeFunction)(_stepperId);
         }
         returnCode = STEPPER_HOME_LIMIT;
@@ -633,7 +1119,7 @@ int StepperController::checkLimitSwitches()
         if (_runningToEnd)
         {
             _runningToEnd = false;
-            _upperLimit = _stepPosition; //set the upper limit to this
+            _upperLimit = this->getPosition(); //set the upper limit to this
         }
         if (!_endSwitchThrown)
         {
@@ -654,7 +1140,10 @@ bool StepperController::checkAutoStop()
 {
     if (_stepIndexMode && stepsWanted == _stepRelativePosition)
     {
-        this->stop();
+        if (this->takeNextMove())
+            return false; //blended into the next move, keep stepping
+        if (!this->startPendingMove())
+            this->stop();
         return true;
     }
     return false;
@@ -4,6 +4,7 @@
 
 
 #include "Arduino.h"
+#include "Defines.h"
 class StepperController
 {
   public:
@@ -20,9 +21,13 @@ class StepperController
     void setAccel(int accel); //how fast to speed up and slow down
     void setDirection(bool dir);
     void setMaxSpeed(int speed);
+    void setSCurve(bool enabled); //smooth the ends of the accel/decel ramps to limit jerk
+    bool isSCurve();
 
     void moveSteps(long steps); //move a number of steps from current location
     void moveTo(long position); //move to an absolute position
+    void retarget(long position); //aim a running move somewhere else without restarting its ramp, reverses through zero only when it has to
+    void jog(int speed); //run toward the soft limit in the direction of speed at up to speed steps per second, 0 slows to a stop
 
     void autoHome(); //if home pin is set, move toward that pin
     void setHome(); //sets stepPosition to 0
@@ -34,11 +39,6 @@ class StepperController
     long getLimitUpper(); //limiting movement of the machine; NOTE: does not scale if step mode is changed, limits need reset
     long getLimitLower(); //limiting movement of the machine; NOTE: does not scale if step mode is changed, limits need reset
 
-    
-    float getTestSpeed();
-    float getDivisor();
-    float getFloatResult();
-    long getDecelStep();
     int getMaxSpeed();
     int getCurrentSpeed();
     bool getIsDecel();
@@ -57,20 +57,47 @@ class StepperController
     void setDisableOnLimit(bool dis);
     int checkLimitSwitches(); //check for limit switch pins
     void setLimitTriggerState(int state); //sets trigger state of limit switch
-    void setEventLimitHome(void (*eventFunction));
-    void setEventLimitEnd(void (*eventFunction));
-    void setEventMoveComplete(void (*eventFunction));
+    void setEventLimitHome(void (*eventFunction)(int stepperId));
+    void setEventLimitEnd(void (*eventFunction)(int stepperId));
+    void setEventMoveComplete(void (*eventFunction)(int stepperId));
+    void setEventAutoHomeComplete(void (*eventFunction)(int stepperId));
     void disableController(int isDisabled);
     
     void setId(int id); //stepper id used by events
     int getId();
+    void setEventsEnabled(bool enabled); //when false, move complete and auto home complete events are not fired (used by queued moves and home all)
+
+    void setFollower(StepperController *follower, long followerSteps); //step another axis Bresenham style during the next move so both finish together
+    void setNextMove(long steps, StepperController *follower, long followerSteps); //carry straight on with this move once the running one reaches its target
+    bool hasNextMove(); //the move from setNextMove() hasn't been started yet
+    bool isWithinLimits(long position); //position is inside the soft limits, or there are none
+
+    void attachTimer(byte channel); //generate steps from a Timer1 compare channel (0 = A, 1 = B, 2 = C) instead of polling, call from setup()
+    bool isTimerDriven();
+    static void handleTimerInterrupt(byte channel); //called from the Timer1 compare ISRs
+
+  protected:
+    virtual void onTimerStep(); //runs inside the compare ISR, overridden to instantiate timerStep() with compile time pins
+    template <class Pins> void timerStep(Pins *pins); //the ISR's step with pin access resolved at compile time from Pins
+    template <class Pins> bool limitSwitchAhead(Pins *pins); //limit switch closed in the direction of travel, safe from the ISR
+
+    virtual void stepPinHigh(); //raise the step pin
+    virtual void stepPinLow(); //drop the step pin
+    virtual int readHomeSwitch(); //HIGH/LOW of the home switch pin
+    virtual int readEndSwitch(); //HIGH/LOW of the end switch pin
 
   private:
     int _stepperId;
     bool _events;
     bool _homed; //determines if we set the home position
-    long _stepPosition; //current number of steps from 0
+    volatile long _stepPosition; //current number of steps from 0
     int _stepPin;
+    volatile uint8_t *_stepPort; //output register of the step pin, lets the ISR pulse without a pin lookup
+    uint8_t _stepPinMask; //bit of the step pin in _stepPort
+    volatile uint8_t *_homeInputRegister; //input register of the home switch pin
+    uint8_t _homePinMask; //bit of the home switch pin
+    volatile uint8_t *_endInputRegister; //input register of the end switch pin
+    uint8_t _endPinMask; //bit of the end switch pin
     int _dirPin;
     int _homePin; //pin for relay to determine home position
     int _endPin; //pin for far relay to determine end of run
@@ -83,21 +110,30 @@ class StepperController
     bool _autoHoming; //whether we're in auto home mode for this axis
     bool _autoHomingRunOut; //once home limit is hit, this = true until home is no longer activated, then home is set
     bool _runningToEnd; //whether we're in auto home mode for this axis
-    long _stepRelativePosition; //keep track of how many times we stepped
+    volatile long _stepRelativePosition; //keep track of how many times we stepped
     unsigned long _previousMicros; //time we last told the stepper to move
     bool checkAutoStop();
-    void calcSpeed();
+    unsigned long calcSpeed(); //interval to the next step from the ramp table, sets _stepDelayTime
+    void planRamp(); //rebuild the ramp table after accel/speed changes
+    void applySpeedLimit(); //set _rampLimit from _speedLimit
+    bool startPendingMove(); //a retarget reversed us, head for it now that we've stopped
     bool runLimitedValidations(int limited); //performs checks when the value of limited > 0
-    long _stepsTaken; //how many times did we step
-    int _acceleration; //accel value in steps per second
-    bool _decelerating; //flag to tell the stepper to decelerate
-    long _decelStep; //when to start decellerating if we know our path
-    long _stepDelayTime; //how long to delay a step
-    int _currentSpeed; //how many steps per second we're running
+    volatile long _stepsTaken; //how many times did we step
+    int _acceleration; //steps per second gained each step
+    volatile bool _decelerating; //we are ramping down into the target
+    volatile long _stepDelayTime; //how long to delay a step
     int _maxSpeed; //the max steps per second we want to achieve
-    float _testSpeed;
-    float _testDivisor;
-    float _floatResult;
+    bool _sCurve; //ramp follows a smoothstep instead of a straight line
+    unsigned long _rampTable[RAMP_TABLE_SIZE]; //step intervals in uS along the ramp
+    long _rampSteps; //steps from standstill to cruising
+    unsigned long _rampScale; //16.16 fixed point, ramp step to table index
+    unsigned long _cruiseInterval; //step interval in uS at max speed
+    volatile long _rampStep; //how far into the ramp we are since the move started
+    volatile long _rampLimit; //ramp step we cruise at, below _rampSteps while jogging slower than max speed
+    int _speedLimit; //jog speed, 0 for max speed, cleared when the stepper stops
+    bool _retargetPending; //slowing to a stop before heading back to _retargetPosition
+    long _retargetPosition; //where a reversing retarget goes once we've stopped
+    unsigned long _firstStepDelay; //start() waits this long before the first step, set when turning round mid move
     bool _homeSwitchThrown; //if we have thrown the switch, flag to ignore processing multiple times
     bool _endSwitchThrown; //if we have thrown the switch, flag to ignore processing multiple times
     bool _disableOnLimit; //disable stepper when limit switch reached
@@ -107,10 +143,118 @@ class StepperController
     int _limitSwitchTriggerValue; //value HIGH/LOW when switch is in triggered state
     int _limitSwitchBackoffSteps; //Once reaching the limit, how far do we backoff when auto homing?
 
+    bool _timerDriven; //steps are generated by the Timer1 ISR, step() only does the bookkeeping
+    volatile uint16_t *_timerCompareRegister; //OCR1x register for our compare channel
+    uint8_t _timerChannelMask; //OCIE1x/OCF1x bit for our compare channel
+    volatile uint16_t _timerNextStep; //compare value of the next step, set while the current pulse is high
+    volatile bool _timerPulseHigh; //step pin is up, the next compare drops it
+    volatile bool _timerFollowerPulsed; //the follower got a pulse with this step
+    volatile bool _timerHalted; //ISR reached the target or a soft limit, step() finishes the stop
+    volatile bool _timerLimitHit; //ISR halted on a limit switch, step() decides whether to carry on
+    long _timerStepsSeen; //how many ISR steps step() has already planned speed for
+    void armTimer(); //schedule the first step and enable the compare interrupt
+    void disarmTimer(); //disable the compare interrupt
+    void scheduleCompare(uint16_t tick); //next compare at tick, or as soon as possible if tick has passed
+
+    StepperController *_follower; //axis stepped alongside us for coordinated moves
+    long _followerSteps; //how many steps the follower takes over our move
+    long _followerMasterSteps; //how many steps we take over the move
+    long _followerError; //Bresenham error term
+    long _followerAdder; //+1/-1 depending on the follower direction
+    volatile bool _holdSpeedAtEnd; //don't decelerate into the target, another move continues from here
+    volatile bool _nextMovePending; //setNextMove() gave us a move to run on into
+    long _nextSteps; //steps of the next move, same sign as the running one
+    StepperController *_nextFollower; //follower for the next move, 0 for none
+    long _nextFollowerSteps; //follower steps over the next move
+    bool takeNextMove(); //swap the next move in at the target, false if there isn't one
+    bool raiseFollower(); //start a follower pulse if it's due, returns true if we pulsed
+    void lowerFollower(); //finish the follower pulse
+    bool followerLimited(); //follower hit a limit switch in its direction of travel
+    bool followerBlocked(); //follower's next pulse would take it past its soft limits
+    static StepperController *_timerSteppers[3]; //stepper attached to each compare channel
+    static bool _timerStarted; //Timer1 has been configured for stepping
+
     void (*_limitSwitchEventHomeFunction)(int stepperId); //execute when home limit switch is triggerd
     void (*_limitSwitchEventEndFunction)(int stepperId); //execute when end limit switch is triggered
     void (*_moveCompleteEventFunction)(int stepperId); //execute when current move has completed
     void (*_autoHomingCompleteFunction)(int stepperId); //execute when current move has completed
 };
 
+/**
+ * A limit switch in the direction of travel is closed. Checked from the ISR so a stalled loop()
+ * can't drive the axis into the stop, step() sorts out what the switch means.
+ */
+template <class Pins>
+bool StepperController::limitSwitchAhead(Pins *pins)
+{
+    if (_disableLimitChecks)
+        return false;
+    if (_direction == DIRECTION_FORWARD)
+        return _endPin > -1 && pins->Pins::readEndSwitch() == _limitSwitchTriggerValue;
+    return _homePin > -1 && pins->Pins::readHomeSwitch() == _limitSwitchTriggerValue;
+}
+
+/**
+ * Timer ISR, each step takes two compares. The first raises the step pin and plans the next step from
+ * this step's deadline so latency doesn't add up, the second drops the pin a pulse length later and
+ * waits for that deadline. Stops exactly on the target, soft limit or a closed limit switch; events
+ * are left to step() since they print to serial.
+ *
+ * Pins is the class whose pin functions to use. They're called qualified so there is no virtual call:
+ * for FastStepperController they inline to single port instructions. The follower can be any stepper
+ * so its pulse still goes through its virtual stepPinHigh(), as does the polled step() where loop()
+ * latency swamps the call.
+ */
+template <class Pins>
+void StepperController::timerStep(Pins *pins)
+{
+#if defined(__AVR__)
+    if (_timerPulseHigh)
+    {
+        pins->Pins::stepPinLow();
+        if (_timerFollowerPulsed)
+            this->lowerFollower();
+        _timerPulseHigh = false;
+        this->scheduleCompare(_timerNextStep);
+        return;
+    }
+
+    long adder = (_direction == DIRECTION_FORWARD) ? 1l : -1l;
+
+    if (!_running
+        || (_stepIndexMode && stepsWanted == _stepRelativePosition && !this->takeNextMove())
+        || ((!_disableLimitChecks) && ((_stepPosition + adder > _upperLimit && !_runningToEnd) || (_stepPosition + adder < _lowerLimit && !_autoHoming)))
+        || this->followerBlocked())
+    {
+        _timerHalted = true;
+        this->disarmTimer();
+        return;
+    }
+    if (this->limitSwitchAhead(pins))
+    {
+        _timerHalted = true;
+        _timerLimitHit = true;
+        this->disarmTimer();
+        return;
+    }
+
+    pins->Pins::stepPinHigh(); //perform a step
+    _timerFollowerPulsed = this->raiseFollower();
+    _timerPulseHigh = true;
+    _stepsTaken++;
+    _stepRelativePosition += adder;
+    _stepPosition += adder;
+
+    unsigned long ticks = this->calcSpeed() / TIMER_TICK_MICROS;
+    if (ticks < TIMER_MIN_TICKS)
+        ticks = TIMER_MIN_TICKS;
+    else if (ticks > 0xFFFFul)
+        ticks = 0xFFFFul;
+    _timerNextStep = *_timerCompareRegister + (uint16_t)ticks;
+    this->scheduleCompare(TCNT1 + TIMER_PULSE_TICKS);
+#else
+    (void)pins;
+#endif
+}
+
 #endif
\ No newline at end of file